@@ -0,0 +1,344 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+// ReliableChannel between two peers over a simulated link, in virtual time, so every run with the same seed is the same.
+// Each direction is a bottleneck of --rate packets per second with a tail-drop queue of --queue packets, followed
+// by --rtt/2 of propagation. On top of that, packets are dropped (--loss) or held back by up to half the RTT
+// (--reorder) at random, and --blackout drops everything for a while once a third of the messages was delivered.
+// The run fails (exit 1) unless every message arrives once and in order, and unless the recovery under test
+// showed up: retransmissions with loss, retransmission timeouts with a blackout, and a window grown past its start.
+//
+// Usage: msggo_channelsim [--messages=20000] [--size=256] [--rtt=2000] [--rate=20000] [--queue=64] [--loss=0]
+//                         [--reorder=0] [--blackout=0] [--seed=1] [--min-utilization=0] [--json]
+//   --rtt       round trip propagation in microseconds.
+//   --loss      percent of packets dropped at random, both directions.
+//   --reorder   percent of packets delayed by up to half the RTT, so later ones overtake them.
+//   --blackout  milliseconds without any delivery.
+//   --min-utilization  exit 1 if goodput is below this percent of --rate.
+//   --json      print one JSON object instead of the table.
+
+#include "../Escapist/Common/ReliableChannel.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+struct BenchConfig {
+    UInt64 messages = 20000;
+    SizeType size = 256;
+    UInt64 rtt = 2000;
+    UInt64 rate = 20000;
+    UInt32 queue = 64;
+    double loss = 0;
+    double reorder = 0;
+    UInt64 blackout = 0;
+    UInt64 seed = 1;
+    double minUtilization = 0;
+    bool json = false;
+};
+
+static constexpr UInt64 TimeLimit = 120000000; // Virtual microseconds before a stalled run is given up.
+
+/**
+ * xorshift64*, the same stream for the same seed on every platform.
+ */
+class Random {
+private:
+    UInt64 state;
+
+public:
+    explicit Random(UInt64 seed) noexcept: state(seed ? seed : 1) {}
+
+    /**
+     * @return true with a chance of percent in 100.
+     */
+    bool Chance(double percent) noexcept {
+        return percent > 0 && double(Random::Next() % 1000000) < percent * 10000;
+    }
+
+    UInt64 Next() noexcept {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 2685821657736338717ull;
+    }
+};
+
+/**
+ * One direction of the link, packets are held until their arrival time.
+ */
+class SimulatedLink : public ChannelTransport {
+public:
+    static constexpr int Capacity = 8192; // Packets between both ends, beyond that they are dropped.
+
+private:
+    struct Packet {
+        ByteArray datagram;
+        UInt64 arrival = 0;
+        bool used = false;
+    };
+
+    const BenchConfig &config;
+    const UInt64 &now;
+    Random &random;
+    Packet *packets;
+    UInt64 *departures; // Ring of departure times of the queued packets.
+    UInt32 queueHead = 0;
+    UInt32 queueLength = 0;
+    UInt64 busyUntil = 0;
+    UInt64 blackoutUntil = 0;
+    UInt64 dropCount = 0;
+
+public:
+    SimulatedLink(const BenchConfig &config, const UInt64 &now, Random &random)
+            : config(config), now(now), random(random) {
+        packets = new Packet[SimulatedLink::Capacity];
+        departures = new UInt64[config.queue ? config.queue : 1];
+    }
+
+    SimulatedLink(const SimulatedLink &other) = delete;
+
+    ~SimulatedLink() override {
+        delete[] packets;
+        delete[] departures;
+    }
+
+    bool Transmit(const ByteArray &packet) override {
+        while (queueLength && departures[queueHead] <= now) {
+            queueHead = (queueHead + 1) % config.queue;
+            --queueLength;
+        }
+        if (now < blackoutUntil || queueLength >= config.queue || random.Chance(config.loss)) {
+            ++dropCount;
+            return true; // Lost on the way, the sender can't tell.
+        }
+        Packet *free = nullptr;
+        for (int index = 0; index < SimulatedLink::Capacity && !free; ++index) {
+            free = packets[index].used ? nullptr : &packets[index];
+        }
+        if (!free) {
+            ++dropCount;
+            return true;
+        }
+        busyUntil = (busyUntil > now ? busyUntil : now) + 1000000 / config.rate;
+        departures[(queueHead + queueLength++) % config.queue] = busyUntil;
+        free->datagram = packet;
+        free->arrival = busyUntil + config.rtt / 2;
+        if (random.Chance(config.reorder)) {
+            free->arrival += random.Next() % (config.rtt / 2 + 1);
+        }
+        free->used = true;
+        return true;
+    }
+
+    void StartBlackout(UInt64 duration) noexcept {
+        blackoutUntil = now + duration;
+    }
+
+    /**
+     * @return arrival of the next packet, 0 if none is on the way.
+     */
+    UInt64 GetNextArrival() const noexcept {
+        UInt64 next = 0;
+        for (int index = 0; index < SimulatedLink::Capacity; ++index) {
+            if (packets[index].used && (!next || packets[index].arrival < next)) {
+                next = packets[index].arrival;
+            }
+        }
+        return next;
+    }
+
+    /**
+     * Hand every packet arrived by now to channel, earliest first.
+     */
+    void Deliver(ReliableChannel &channel) {
+        for (;;) {
+            Packet *next = nullptr;
+            for (int index = 0; index < SimulatedLink::Capacity; ++index) {
+                if (packets[index].used && packets[index].arrival <= now &&
+                    (!next || packets[index].arrival < next->arrival)) {
+                    next = &packets[index];
+                }
+            }
+            if (!next) {
+                return;
+            }
+            ByteArray datagram = (ByteArray &&) next->datagram;
+            next->used = false;
+            channel.OnDatagram(datagram, now);
+        }
+    }
+
+    UInt64 GetDropCount() const noexcept {
+        return dropCount;
+    }
+};
+
+/**
+ * Checks that message i carries i.
+ */
+class SimReceiver : public ChannelReceiver {
+public:
+    UInt64 expected = 0;
+    UInt64 misordered = 0;
+
+    void OnMessage(ByteArray &message) override {
+        if (message.ReadSimpleValue<UInt64>() != expected) {
+            ++misordered;
+        }
+        ++expected;
+    }
+};
+
+/**
+ * Peer that only sends, acks coming back are not delivered as messages.
+ */
+class IgnoreReceiver : public ChannelReceiver {
+public:
+    void OnMessage(ByteArray &) override {}
+};
+
+static bool ParseArgument(const char *argument, BenchConfig &config) {
+    const char *value = ::strchr(argument, '=');
+    value = value ? value + 1 : "";
+    if (!::strcmp(argument, "--json")) {
+        config.json = true;
+    } else if (!::strncmp(argument, "--messages=", 11)) {
+        config.messages = ::strtoull(value, nullptr, 10);
+    } else if (!::strncmp(argument, "--size=", 7)) {
+        config.size = SizeType(::strtoull(value, nullptr, 10));
+    } else if (!::strncmp(argument, "--rtt=", 6)) {
+        config.rtt = ::strtoull(value, nullptr, 10);
+    } else if (!::strncmp(argument, "--rate=", 7)) {
+        config.rate = ::strtoull(value, nullptr, 10);
+    } else if (!::strncmp(argument, "--queue=", 8)) {
+        config.queue = UInt32(::strtoul(value, nullptr, 10));
+    } else if (!::strncmp(argument, "--loss=", 7)) {
+        config.loss = ::atof(value);
+    } else if (!::strncmp(argument, "--reorder=", 10)) {
+        config.reorder = ::atof(value);
+    } else if (!::strncmp(argument, "--blackout=", 11)) {
+        config.blackout = ::strtoull(value, nullptr, 10) * 1000;
+    } else if (!::strncmp(argument, "--seed=", 7)) {
+        config.seed = ::strtoull(value, nullptr, 10);
+    } else if (!::strncmp(argument, "--min-utilization=", 18)) {
+        config.minUtilization = ::atof(value);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    BenchConfig config;
+    for (int index = 1; index < argc; ++index) {
+        if (!ParseArgument(argv[index], config)) {
+            ::fprintf(stderr, "usage: %s [--messages=N] [--size=BYTES] [--rtt=US] [--rate=PPS] [--queue=N] "
+                              "[--loss=PCT] [--reorder=PCT] [--blackout=MS] [--seed=N] [--min-utilization=PCT] "
+                              "[--json]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!config.messages || config.size < sizeof(UInt64) || !config.rate || config.rate > 1000000 ||
+        !config.queue) {
+        ::fprintf(stderr, "messages and queue must be at least 1, size at least 8, rate within 1..1000000\n");
+        return 2;
+    }
+
+    UInt64 now = 0;
+    Random random(config.seed);
+    SimulatedLink forward(config, now, random), backward(config, now, random);
+    SimReceiver received;
+    IgnoreReceiver ignored;
+    ReliableChannel sender(forward, &ignored), receiver(backward, &received);
+    ByteArray message(config.size, config.size);
+    ::memset(message.GetData(), 0, config.size);
+
+    UInt64 sent = 0;
+    double peakWindow = sender.GetWindow();
+    bool blackedOut = !config.blackout;
+    while (received.expected < config.messages && now < TimeLimit) {
+        for (; sent < config.messages; ++sent) {
+            ::memcpy(message.GetData(), &sent, sizeof(UInt64));
+            if (!sender.Send(message, now)) {
+                break;
+            }
+        }
+        if (!blackedOut && received.expected >= config.messages / 3) {
+            forward.StartBlackout(config.blackout);
+            backward.StartBlackout(config.blackout);
+            blackedOut = true;
+        }
+        UInt64 next = TimeLimit;
+        UInt64 arrivals[] = {forward.GetNextArrival(), backward.GetNextArrival()};
+        for (UInt64 arrival : arrivals) {
+            if (arrival && arrival < next) {
+                next = arrival;
+            }
+        }
+        ReliableChannel *channels[] = {&sender, &receiver};
+        for (ReliableChannel *channel : channels) {
+            int timeout = channel->GetTimeoutMs(now);
+            if (timeout >= 0 && now + UInt64(timeout) * 1000 < next) {
+                next = now + UInt64(timeout) * 1000;
+            }
+        }
+        now = next > now ? next : now + 1;
+        forward.Deliver(receiver);
+        backward.Deliver(sender);
+        receiver.Poll(now);
+        sender.Poll(now);
+        if (sender.GetWindow() > peakWindow) {
+            peakWindow = sender.GetWindow();
+        }
+    }
+
+    double seconds = double(now) / 1e6;
+    double goodput = seconds > 0 ? double(received.expected) / seconds : 0;
+    double utilization = goodput * 100 / double(config.rate);
+    const char *failure = nullptr;
+    if (received.expected != config.messages) {
+        failure = "not every message was delivered";
+    } else if (received.misordered || receiver.GetDeliveredCount() != config.messages) {
+        failure = "messages were delivered out of order or twice";
+    } else if (config.loss > 0 && !sender.GetRetransmitCount()) {
+        failure = "packets were lost but none was retransmitted";
+    } else if (config.blackout && !sender.GetTimeoutCount()) {
+        failure = "the blackout never triggered a retransmission timeout";
+    } else if (peakWindow <= 4) {
+        failure = "the window never grew";
+    } else if (utilization < config.minUtilization) {
+        failure = "goodput is below --min-utilization";
+    }
+
+    if (config.json) {
+        ::printf("{\"messages\":%llu,\"size\":%llu,\"rtt_us\":%llu,\"rate\":%llu,\"queue\":%u,\"loss\":%.2f,"
+                 "\"reorder\":%.2f,\"blackout_ms\":%llu,\"seed\":%llu,\"seconds\":%.6f,\"messages_per_second\":%.0f,"
+                 "\"utilization\":%.2f,\"dropped\":%llu,\"retransmitted\":%llu,\"timeouts\":%llu,"
+                 "\"peak_window\":%.1f,\"srtt_us\":%llu,\"passed\":%s}\n",
+                 (unsigned long long) config.messages, (unsigned long long) config.size,
+                 (unsigned long long) config.rtt, (unsigned long long) config.rate, config.queue, config.loss,
+                 config.reorder, (unsigned long long) (config.blackout / 1000), (unsigned long long) config.seed,
+                 seconds, goodput, utilization,
+                 (unsigned long long) (forward.GetDropCount() + backward.GetDropCount()),
+                 (unsigned long long) sender.GetRetransmitCount(), (unsigned long long) sender.GetTimeoutCount(),
+                 peakWindow, (unsigned long long) sender.GetSmoothedRtt(), failure ? "false" : "true");
+    } else {
+        ::printf("%llu messages of %llu bytes, rtt %llu us, %llu packets/s, queue %u, loss %.2f%%, reorder %.2f%%, "
+                 "blackout %llu ms\n", (unsigned long long) config.messages, (unsigned long long) config.size,
+                 (unsigned long long) config.rtt, (unsigned long long) config.rate, config.queue, config.loss,
+                 config.reorder, (unsigned long long) (config.blackout / 1000));
+        ::printf("%10s %14s %12s %10s %14s %10s %12s %10s\n", "seconds", "messages/s", "utilization", "dropped",
+                 "retransmitted", "timeouts", "peak window", "srtt us");
+        ::printf("%10.3f %14.0f %11.2f%% %10llu %14llu %10llu %12.1f %10llu\n", seconds, goodput, utilization,
+                 (unsigned long long) (forward.GetDropCount() + backward.GetDropCount()),
+                 (unsigned long long) sender.GetRetransmitCount(), (unsigned long long) sender.GetTimeoutCount(),
+                 peakWindow, (unsigned long long) sender.GetSmoothedRtt());
+    }
+    if (failure) {
+        ::fprintf(stderr, "failed: %s\n", failure);
+        return 1;
+    }
+    return 0;
+}
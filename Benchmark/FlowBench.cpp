@@ -0,0 +1,212 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+// CreditSender -> CreditReceiver over loopback, with datagrams dropped at random on arrival as if lost on the
+// wire (both directions, grants and reports included). The receiver consumes everything at once, so the window
+// is the only limit. Lost messages must not eat credits: the run fails (exit 1) if the sender makes no progress
+// for --stall-limit ms (which includes the kernel dropping what credits should have held back), or if the Queue
+// policy didn't send every message.
+//
+// Usage: msggo_flowbench [--messages=20000] [--window=64] [--loss=0] [--policy=queue] [--queue=1024]
+//                        [--refresh=5000] [--port=47420] [--seed=1] [--stall-limit=2000] [--json]
+//   --loss     percent of datagrams dropped on arrival.
+//   --policy   queue|shed, what the sender does out of credits (block would wait on the only thread).
+//   --refresh  microseconds between repeated grants and reports.
+//   --port     the sender binds it, the receiver the next one.
+//   --json     print one JSON object instead of the table.
+
+#include "../Escapist/Common/FlowControl.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+struct BenchConfig {
+    UInt64 messages = 20000;
+    UInt64 window = 64;
+    double loss = 0;
+    bool shed = false;
+    SizeType queue = 1024;
+    UInt64 refreshUs = 5000;
+    int port = 47420;
+    UInt64 seed = 1;
+    UInt64 stallLimitMs = 2000;
+    bool json = false;
+};
+
+static UInt64 NextRandom(UInt64 &state) noexcept {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ull;
+}
+
+/**
+ * @return true with a chance of percent in 100.
+ */
+static bool Chance(UInt64 &state, double percent) noexcept {
+    return percent > 0 && double(NextRandom(state) % 1000000) < percent * 10000;
+}
+
+static bool ParseArgument(const char *argument, BenchConfig &config) {
+    const char *value = ::strchr(argument, '=');
+    value = value ? value + 1 : "";
+    if (!::strcmp(argument, "--json")) {
+        config.json = true;
+    } else if (!::strncmp(argument, "--messages=", 11)) {
+        config.messages = ::strtoull(value, nullptr, 10);
+    } else if (!::strncmp(argument, "--window=", 9)) {
+        config.window = ::strtoull(value, nullptr, 10);
+    } else if (!::strncmp(argument, "--loss=", 7)) {
+        config.loss = ::atof(value);
+    } else if (!::strcmp(argument, "--policy=queue")) {
+        config.shed = false;
+    } else if (!::strcmp(argument, "--policy=shed")) {
+        config.shed = true;
+    } else if (!::strncmp(argument, "--queue=", 8)) {
+        config.queue = SizeType(::strtoull(value, nullptr, 10));
+    } else if (!::strncmp(argument, "--refresh=", 10)) {
+        config.refreshUs = ::strtoull(value, nullptr, 10);
+    } else if (!::strncmp(argument, "--port=", 7)) {
+        config.port = ::atoi(value);
+    } else if (!::strncmp(argument, "--seed=", 7)) {
+        config.seed = ::strtoull(value, nullptr, 10);
+    } else if (!::strncmp(argument, "--stall-limit=", 14)) {
+        config.stallLimitMs = ::strtoull(value, nullptr, 10);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+#ifdef ESCAPIST_OS_LINUX
+
+int main(int argc, char **argv) {
+    BenchConfig config;
+    for (int index = 1; index < argc; ++index) {
+        if (!ParseArgument(argv[index], config)) {
+            ::fprintf(stderr, "usage: %s [--messages=N] [--window=N] [--loss=PCT] [--policy=queue|shed] [--queue=N] "
+                              "[--refresh=US] [--port=N] [--seed=N] [--stall-limit=MS] [--json]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!config.messages || !config.window || !config.queue || config.loss < 0 || config.loss >= 100 ||
+        config.port <= 0 || config.port >= 65535) {
+        ::fprintf(stderr, "messages, window and queue must be at least 1, loss in [0, 100), port in [1, 65535)\n");
+        return 2;
+    }
+
+    DatagramServer senderSocket, receiverSocket;
+    senderSocket.Bind("127.0.0.1", config.port).SetNonBlocking();
+    receiverSocket.Bind("127.0.0.1", config.port + 1).SetNonBlocking();
+    DatagramAddress senderAddress{{127, 0, 0, 1}, (unsigned short) config.port};
+    DatagramAddress receiverAddress{{127, 0, 0, 1}, (unsigned short) (config.port + 1)};
+    CreditSender sender(senderSocket, receiverAddress, config.shed ? CreditPolicy::Shed : CreditPolicy::Queue,
+                        config.queue, 0, config.refreshUs);
+    CreditReceiver receiver(receiverSocket, senderAddress, config.window, config.refreshUs);
+    BufferPool pool(256);
+    UInt64 state = config.seed ? config.seed : 1;
+
+    ByteArray message(sizeof(UInt64), sizeof(UInt64));
+    UInt64 offered = 0, refused = 0, delivered = 0, dropped = 0;
+    UInt64 start = TimerWheel::Now();
+    UInt64 progressAt = start, lastSent = 0, lastDelivered = 0;
+    bool stalled = false;
+    receiver.Advertise(start);
+    DatagramAddress address{};
+    ByteArray datagram;
+    while (true) {
+        UInt64 now = TimerWheel::Now();
+        // Offer while the queue has room, so Queue never sheds and every message is eventually sent.
+        while (offered < config.messages && sender.GetMetrics(now).queueDepth < config.queue) {
+            ::memcpy(message.GetData(), &offered, sizeof(UInt64));
+            refused += !sender.Send(message, now);
+            ++offered;
+            if (!sender.GetAvailableCredits()) {
+                break;
+            }
+        }
+        while (receiverSocket.TryReceive(pool, address, datagram)) {
+            UInt64 reported;
+            if (Chance(state, config.loss)) {
+                dropped += !CreditReport::Parse(datagram, reported);
+            } else if (!receiver.OnDatagram(address, datagram, now)) {
+                ++delivered;
+                receiver.OnConsumed(1, now);
+            }
+            datagram.Empty();
+        }
+        while (senderSocket.TryReceive(pool, address, datagram)) {
+            if (!Chance(state, config.loss)) {
+                sender.OnDatagram(address, datagram, now);
+            }
+            datagram.Empty();
+        }
+        sender.Flush(now);
+        sender.Poll(now);
+        receiver.Poll(now);
+
+        CreditMetrics metrics = sender.GetMetrics(now);
+        if (metrics.sentCount != lastSent || delivered != lastDelivered) {
+            lastSent = metrics.sentCount;
+            lastDelivered = delivered;
+            progressAt = now;
+        }
+        if (offered == config.messages && !metrics.queueDepth && delivered + dropped == metrics.sentCount) {
+            break;
+        }
+        if (now - progressAt > config.stallLimitMs * 1000) {
+            stalled = true;
+            break;
+        }
+    }
+    UInt64 elapsed = TimerWheel::Now() - start;
+    CreditMetrics metrics = sender.GetMetrics();
+    double rate = elapsed ? double(delivered) * 1e6 / double(elapsed) : 0;
+
+    if (config.json) {
+        ::printf("{\"policy\":\"%s\",\"messages\":%llu,\"window\":%llu,\"loss\":%.2f,\"sent\":%llu,\"shed\":%llu,"
+                 "\"delivered\":%llu,\"dropped\":%llu,\"lost\":%llu,\"stalls\":%llu,\"stall_ms\":%.1f,"
+                 "\"max_queue\":%llu,\"msg_per_sec\":%.0f,\"stalled\":%s}\n",
+                 config.shed ? "shed" : "queue", (unsigned long long) config.messages,
+                 (unsigned long long) config.window, config.loss, (unsigned long long) metrics.sentCount,
+                 (unsigned long long) metrics.shedCount, (unsigned long long) delivered,
+                 (unsigned long long) dropped, (unsigned long long) receiver.GetLostCount(),
+                 (unsigned long long) metrics.stallCount, double(metrics.stallUs) / 1000,
+                 (unsigned long long) metrics.maximumQueueDepth, rate, stalled ? "true" : "false");
+    } else {
+        ::printf("%s policy, window %llu, %.1f%% loss\n", config.shed ? "shed" : "queue",
+                 (unsigned long long) config.window, config.loss);
+        ::printf("sent %llu, shed %llu, delivered %llu, dropped %llu, lost by the receiver's count %llu\n",
+                 (unsigned long long) metrics.sentCount, (unsigned long long) metrics.shedCount,
+                 (unsigned long long) delivered, (unsigned long long) dropped,
+                 (unsigned long long) receiver.GetLostCount());
+        ::printf("%llu stalls, %.1f ms waiting for credits, queue depth %llu at most, %.0f msg/s\n",
+                 (unsigned long long) metrics.stallCount, double(metrics.stallUs) / 1000,
+                 (unsigned long long) metrics.maximumQueueDepth, rate);
+    }
+
+    bool failed = false;
+    if (stalled) {
+        ::fprintf(stderr, "no progress for %llu ms with %llu of %llu messages sent, credits were lost\n",
+                  (unsigned long long) config.stallLimitMs, (unsigned long long) metrics.sentCount,
+                  (unsigned long long) config.messages);
+        failed = true;
+    }
+    if (!config.shed && (refused || metrics.sentCount != config.messages)) {
+        ::fprintf(stderr, "queue policy sent %llu of %llu messages\n", (unsigned long long) metrics.sentCount,
+                  (unsigned long long) config.messages);
+        failed = true;
+    }
+    return failed ? 1 : 0;
+}
+
+#else
+
+int main() {
+    ::fprintf(stderr, "msggo_flowbench needs Linux\n");
+    return 1;
+}
+
+#endif
@@ -0,0 +1,713 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+// Loopback throughput and one-way latency of DatagramClient -> DatagramServer, of StreamClient over TCP, or of
+// SharedMemoryClient -> SharedMemoryServer.
+// UDP: every sender owns a connected client, every receiver a SO_REUSEPORT server on the same port, so the kernel
+// spreads senders among receivers. TCP: every sender owns a connection, spread among receivers round robin,
+// messages are framed by MessageHeader and a batch goes out by one writev. Shared memory: every receiver owns an
+// anonymous ring, senders are spread among the rings round robin and a full ring refuses like a full socket.
+// Each message carries the send time of its batch, receivers record now - that time into their own
+// LatencyHistogram, merged at the end.
+//
+// Usage: msggo_netbench [--transport=udp|tcp|shm] [--size=64] [--batch=32] [--senders=1] [--receivers=1] [--rate=0]
+//                       [--duration=3000] [--port=47400] [--loop] [--single] [--gso] [--sharded]
+//                       [--breakdown] [--min-rate=0] [--json]
+//   --size      payload bytes of a message, the MessageHeader of TCP comes on top.
+//   --rate      messages per second of each sender, 0 sends as fast as possible.
+//   --duration  milliseconds of sending, receivers drain for another 200 ms.
+//   --loop      UDP receivers wait on an EventLoop (edge-triggered epoll) instead of poll.
+//   --single    UDP without batching: one send() per datagram and one recvfrom() per datagram, the baseline
+//               of sendmmsg/recvmmsg (--batch only sets how many go out back to back).
+//   --gso       UDP batches sent as one buffer by SendSegmented (UDP_SEGMENT), the kernel splits it into --batch
+//               datagrams of --size, against the per-datagram sendmmsg of the default run.
+//   --breakdown UDP receivers take kernel software timestamps (SO_TIMESTAMPING) and report a LatencyBreakdown:
+//               send call to kernel receive, kernel to the return of recvmsg, and that to the handler. Messages
+//               are stamped with CLOCK_REALTIME then, and received one recvmsg at a time.
+//   --sharded   UDP received by a ShardedDatagramServer, one row per shard count from 1 up to --receivers.
+//               Use at least as many senders as shards, steering keeps each sender on one shard.
+//   --min-rate  exit with status 1 if fewer messages per second were received, a loopback check for CTest.
+//   --json      print one JSON object instead of the table, to be kept and compared between releases.
+
+#include "../Escapist/Common/Socket.h"
+#include "../Escapist/Common/Latency.h"
+#include "../Escapist/Common/Stream.h"
+#include "../Escapist/Common/ShardedDatagramServer.h"
+#include "../Escapist/Common/SharedMemory.h"
+
+#ifdef ESCAPIST_OS_LINUX
+
+#include <pthread.h>
+#include <poll.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+struct BenchConfig {
+    int size = 64;
+    int batch = 32;
+    int senders = 1;
+    int receivers = 1;
+    UInt64 rate = 0;
+    UInt64 durationMs = 3000;
+    int port = 47400;
+    UInt64 minimumRate = 0;
+    bool json = false;
+    bool tcp = false;
+    bool shm = false;
+    bool loop = false;
+    bool single = false;
+    bool gso = false;
+    bool breakdown = false;
+    bool sharded = false;
+};
+
+static constexpr SizeType SharedRingCapacity = 4 << 20;
+
+struct BenchSender {
+    const BenchConfig *config = nullptr;
+    int hMemory = -1; // Ring of the receiver this sender writes to, with --transport=shm.
+    pthread_t thread{};
+    UInt64 sent = 0;
+    UInt64 failed = 0;
+};
+
+struct BenchReceiver {
+    const BenchConfig *config = nullptr;
+    DatagramServer server;
+    SharedMemoryServer ring;
+    ArrayList<StreamClient *> connections;
+    pthread_t thread{};
+    UInt64 received = 0;
+    UInt64 bytes = 0;
+    LatencyHistogram latency;
+    LatencyBreakdown breakdown;
+    DatagramTimestamps stamps[DatagramServer::MaximumBatchSize]; // Of the latest receive, with --breakdown.
+    UInt64 returnedNs[DatagramServer::MaximumBatchSize]; // When the receive of each datagram returned.
+};
+
+static const char *TransportName(const BenchConfig &config) noexcept {
+    return config.tcp ? "tcp" : config.shm ? "shm" : "udp";
+}
+
+static std::atomic<bool> sending(true);
+static std::atomic<bool> receiving(true);
+
+static UInt64 MonotonicNs() noexcept {
+    timespec now{};
+    ::clock_gettime(CLOCK_MONOTONIC, &now);
+    return UInt64(now.tv_sec) * 1000000000ull + UInt64(now.tv_nsec);
+}
+
+/**
+ * @return time a message is stamped with, CLOCK_REALTIME with --breakdown to compare with kernel timestamps.
+ */
+static UInt64 StampNs(const BenchConfig &config) noexcept {
+    return config.breakdown ? OS::RealtimeNs() : MonotonicNs();
+}
+
+/**
+ * @return true if sender may send its next batch, after sleeping most of the wait if it may not yet.
+ */
+static bool IsDue(const BenchConfig &config, UInt64 start, UInt64 sent) {
+    if (!config.rate) {
+        return true;
+    }
+    UInt64 due = start + sent * 1000000000ull / config.rate;
+    UInt64 now = MonotonicNs();
+    if (now >= due) {
+        return true;
+    }
+    UInt64 wait = due - now;
+    if (wait > 50000) { // Sleep the coarse part, spin the rest for an even pace.
+        timespec sleep{0, long(wait - 50000)};
+        ::nanosleep(&sleep, nullptr);
+    }
+    return false;
+}
+
+static void RunDatagramSender(BenchSender *sender) {
+    const BenchConfig &config = *sender->config;
+    DatagramClient client("127.0.0.1", config.port);
+    if (!client.IsConnected()) {
+        ::fprintf(stderr, "connect: %s\n", ::strerror(errno));
+        return;
+    }
+    ByteArray *batch = new ByteArray[config.batch];
+    for (int index = 0; index < config.batch; ++index) {
+        batch[index].Append(byte(0), SizeType(config.size));
+    }
+    ByteArray segmented;
+    if (config.gso) {
+        segmented.Append(byte(0), SizeType(config.size) * SizeType(config.batch));
+    }
+    UInt64 start = MonotonicNs();
+    while (sending.load(std::memory_order_relaxed)) {
+        if (!IsDue(config, start, sender->sent)) {
+            continue;
+        }
+        UInt64 stamp = StampNs(config);
+        for (int index = 0; index < config.batch; ++index) {
+            ::memcpy(config.gso ? segmented.GetData() + index * config.size : batch[index].GetData(), &stamp,
+                     sizeof(UInt64));
+        }
+        int accepted = 0;
+        if (config.gso) { // One sendmsg for the whole batch.
+            accepted = client.SendSegmented(segmented, UInt16(config.size)) ? config.batch : 0;
+        } else if (config.single) { // One send per datagram.
+            while (accepted < config.batch && client.Send(batch[accepted])) {
+                ++accepted;
+            }
+        } else {
+            accepted = client.Send(batch, config.batch);
+            if (accepted < 0) {
+                accepted = 0;
+            }
+        }
+        sender->sent += UInt64(accepted);
+        sender->failed += UInt64(config.batch - accepted);
+    }
+    delete[] batch;
+}
+
+static void RunStreamSender(BenchSender *sender) {
+    const BenchConfig &config = *sender->config;
+    StreamClient client;
+    if (!client.Connect("127.0.0.1", config.port)) {
+        ::fprintf(stderr, "connect: %s\n", ::strerror(errno));
+        return;
+    }
+    client.SetNoDelay();
+    ByteArray payload;
+    payload.Append(byte(0), SizeType(config.size));
+    ByteArray *batch = new ByteArray[config.batch];
+    for (int index = 0; index < config.batch; ++index) {
+        MessageHeader::Encode(batch[index], 1, Flag<MessageFlag>(), payload);
+    }
+    UInt64 start = MonotonicNs();
+    while (sending.load(std::memory_order_relaxed)) {
+        if (!IsDue(config, start, sender->sent)) {
+            continue;
+        }
+        UInt64 stamp = MonotonicNs(); // The checksum goes stale, StreamClient doesn't verify it.
+        for (int index = 0; index < config.batch; ++index) {
+            ::memcpy(batch[index].GetData() + MessageHeader::Size, &stamp, sizeof(UInt64));
+        }
+        if (!client.Send(batch, config.batch)) {
+            sender->failed += UInt64(config.batch);
+            break;
+        }
+        sender->sent += UInt64(config.batch);
+    }
+    delete[] batch;
+}
+
+static void RunSharedMemorySender(BenchSender *sender) {
+    const BenchConfig &config = *sender->config;
+    SharedMemoryClient client;
+    if (!client.Connect(sender->hMemory)) {
+        ::fprintf(stderr, "attach: %s\n", ::strerror(errno));
+        return;
+    }
+    ByteArray *batch = new ByteArray[config.batch];
+    for (int index = 0; index < config.batch; ++index) {
+        batch[index].Append(byte(0), SizeType(config.size));
+    }
+    UInt64 start = MonotonicNs();
+    while (sending.load(std::memory_order_relaxed)) {
+        if (!IsDue(config, start, sender->sent)) {
+            continue;
+        }
+        UInt64 stamp = MonotonicNs();
+        for (int index = 0; index < config.batch; ++index) {
+            ::memcpy(batch[index].GetData(), &stamp, sizeof(UInt64));
+        }
+        int accepted = client.Send(batch, config.batch);
+        sender->sent += UInt64(accepted);
+        sender->failed += UInt64(config.batch - accepted);
+    }
+    delete[] batch;
+}
+
+static void *RunSender(void *argv) {
+    BenchSender *sender = (BenchSender *) argv;
+    if (sender->config->tcp) {
+        RunStreamSender(sender);
+    } else if (sender->config->shm) {
+        RunSharedMemorySender(sender);
+    } else {
+        RunDatagramSender(sender);
+    }
+    return nullptr;
+}
+
+/**
+ * Record latency and size of count received datagrams, then hand their slots back to the pool.
+ * With --breakdown, this is the handler of the LatencyBreakdown and the stamp of the sender is its wire time.
+ */
+static void CountDatagrams(BenchReceiver *receiver, ByteArray *data, int count) {
+    bool breakdown = receiver->config->breakdown;
+    UInt64 now = StampNs(*receiver->config);
+    for (int index = 0; index < count; ++index) {
+        UInt64 stamp = 0;
+        if (data[index].GetSize() >= sizeof(UInt64)) {
+            ::memcpy(&stamp, data[index].GetConstData(), sizeof(UInt64));
+            receiver->latency.Record(now > stamp ? now - stamp : 0);
+        }
+        if (breakdown) {
+            receiver->breakdown.Record(receiver->stamps[index], receiver->returnedNs[index], now, stamp);
+        }
+        receiver->bytes += data[index].GetSize();
+        data[index].Empty(); // Hand the slot back to the pool.
+    }
+    receiver->received += UInt64(count);
+}
+
+/**
+ * Receive what is available, up to MaximumBatchSize datagrams: by one recvmmsg into slots of pool, by one
+ * recvfrom per datagram copied into data with --single, or by one recvmsg per datagram with its timestamps
+ * with --breakdown.
+ */
+static int ReceiveDatagrams(BenchReceiver *receiver, BufferPool &pool, ByteArray *data) {
+    if (receiver->config->breakdown) {
+        DatagramAddress address;
+        int count = 0;
+        while (count < DatagramServer::MaximumBatchSize &&
+               receiver->server.TryReceive(pool, address, data[count], receiver->stamps[count])) {
+            receiver->returnedNs[count++] = OS::RealtimeNs();
+        }
+        return count;
+    }
+    if (!receiver->config->single) {
+        return receiver->server.ReceiveBatch(pool, data, nullptr, DatagramServer::MaximumBatchSize);
+    }
+    unsigned char ipAddress[4];
+    unsigned short port;
+    int count = 0;
+    while (count < DatagramServer::MaximumBatchSize && receiver->server.TryReceive(ipAddress, port, data[count])) {
+        ++count;
+    }
+    return count;
+}
+
+/**
+ * Drains the socket of a receiver on every (edge-triggered) readiness of its EventLoop.
+ */
+class BenchLoopHandler : public EventHandler {
+private:
+    BenchReceiver *receiver;
+    BufferPool &pool;
+    ByteArray *data;
+
+public:
+    BenchLoopHandler(BenchReceiver *receiver, BufferPool &pool, ByteArray *data) noexcept
+            : receiver(receiver), pool(pool), data(data) {}
+
+    void OnReadable() override {
+        int count;
+        while ((count = ReceiveDatagrams(receiver, pool, data)) > 0) {
+            CountDatagrams(receiver, data, count);
+        }
+    }
+};
+
+static void RunDatagramReceiver(BenchReceiver *receiver) {
+    const BenchConfig &config = *receiver->config;
+    SizeType slotSize = (SizeType(config.size) + ByteArray::HeaderSize + 63) & ~SizeType(63);
+    BufferPool pool(4096, slotSize < BufferPool::DefaultSlotSize ? BufferPool::DefaultSlotSize : slotSize);
+    ByteArray data[DatagramServer::MaximumBatchSize];
+    if (config.loop) {
+        EventLoop loop;
+        BenchLoopHandler handler(receiver, pool, data);
+        receiver->server.Attach(loop, &handler);
+        handler.OnReadable(); // Datagrams which arrived before Attach raise no edge.
+        while (receiving.load(std::memory_order_relaxed)) {
+            loop.RunOnce(10);
+        }
+        receiver->server.Detach(loop);
+        return;
+    }
+    pollfd descriptor{receiver->server.GetHandle(), POLLIN, 0};
+    while (receiving.load(std::memory_order_relaxed)) {
+        int count = ReceiveDatagrams(receiver, pool, data);
+        if (count <= 0) {
+            ::poll(&descriptor, 1, 10);
+            continue;
+        }
+        CountDatagrams(receiver, data, count);
+    }
+}
+
+static void RunStreamReceiver(BenchReceiver *receiver) {
+    constexpr int BatchSize = 64;
+    MessageHeader headers[BatchSize];
+    ByteArray messages[BatchSize];
+    ArrayList<pollfd> descriptors;
+    for (SizeType index = 0; index < receiver->connections.GetSize(); ++index) {
+        StreamClient *connection = receiver->connections.GetConstAt(index);
+        connection->SetNonBlocking();
+        descriptors.Append(pollfd{connection->GetHandle(), POLLIN, 0});
+    }
+    while (receiving.load(std::memory_order_relaxed)) {
+        bool idle = true;
+        for (SizeType index = 0; index < receiver->connections.GetSize(); ++index) {
+            int count = receiver->connections.GetConstAt(index)->Receive(headers, messages, BatchSize);
+            if (count <= 0) {
+                continue;
+            }
+            idle = false;
+            UInt64 now = MonotonicNs();
+            for (int message = 0; message < count; ++message) {
+                if (headers[message].payloadLength >= sizeof(UInt64)) {
+                    UInt64 stamp = messages[message].ReadUnsignedLongLong();
+                    receiver->latency.Record(now > stamp ? now - stamp : 0);
+                }
+                receiver->bytes += headers[message].payloadLength;
+            }
+            receiver->received += UInt64(count);
+        }
+        if (idle) {
+            ::poll(descriptors.GetData(), nfds_t(descriptors.GetSize()), 10);
+        }
+    }
+}
+
+static void RunSharedMemoryReceiver(BenchReceiver *receiver) {
+    ByteArray data[DatagramServer::MaximumBatchSize];
+    while (receiving.load(std::memory_order_relaxed)) {
+        int count = receiver->ring.ReceiveBatch(data, DatagramServer::MaximumBatchSize);
+        if (!count) { // Sleep on the futex of the ring until a sender commits.
+            count = receiver->ring.Receive(data[0], 10) ? 1 : 0;
+        }
+        CountDatagrams(receiver, data, count);
+    }
+}
+
+static void *RunReceiver(void *argv) {
+    BenchReceiver *receiver = (BenchReceiver *) argv;
+    if (receiver->config->tcp) {
+        RunStreamReceiver(receiver);
+    } else if (receiver->config->shm) {
+        RunSharedMemoryReceiver(receiver);
+    } else {
+        RunDatagramReceiver(receiver);
+    }
+    return nullptr;
+}
+
+/**
+ * Counts what one shard of a ShardedDatagramServer receives, only called by the worker of that shard.
+ */
+class BenchShardReceiver : public DatagramReceiver {
+public:
+    UInt64 received = 0;
+    UInt64 bytes = 0;
+    LatencyHistogram latency;
+
+    void OnDatagram(const DatagramAddress &, ByteArray &data) override {
+        if (data.GetSize() >= sizeof(UInt64)) {
+            UInt64 stamp, now = MonotonicNs();
+            ::memcpy(&stamp, data.GetConstData(), sizeof(UInt64));
+            latency.Record(now > stamp ? now - stamp : 0);
+        }
+        bytes += data.GetSize();
+        ++received;
+    }
+};
+
+/**
+ * Receive by a ShardedDatagramServer (one pinned worker and engine per shard, steered by peer), the shard count
+ * doubling from 1 up to --receivers, and print one row per shard count.
+ */
+static void RunSharded(const BenchConfig &config) {
+    if (!config.json) {
+        ::printf("udp sharded, size %d B, batch %d, %d sender(s), rate %llu/s per sender, %llu ms per shard count\n",
+                 config.size, config.batch, config.senders, (unsigned long long) config.rate,
+                 (unsigned long long) config.durationMs);
+        ::printf("%8s %14s %10s %10s %12s %12s\n", "shards", "msg/s", "MB/s", "loss %", "p50 us", "p99 us");
+    }
+    for (int shards = 1;; shards = shards * 2 < config.receivers ? shards * 2 : config.receivers) {
+        ShardedDatagramServer server(shards);
+        for (int index = 0; index < shards; ++index) {
+            int bufferSize = 8 << 20;
+            ::setsockopt(server.GetServer(index).GetHandle(), SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+        }
+        bool steered = server.Bind("127.0.0.1", config.port);
+        BenchShardReceiver *receivers = new BenchShardReceiver[shards];
+        DatagramReceiver **handlers = new DatagramReceiver *[shards];
+        for (int index = 0; index < shards; ++index) {
+            handlers[index] = &receivers[index];
+        }
+        server.Start(handlers);
+
+        sending.store(true, std::memory_order_relaxed);
+        BenchSender *senders = new BenchSender[config.senders];
+        UInt64 start = MonotonicNs();
+        for (int index = 0; index < config.senders; ++index) {
+            senders[index].config = &config;
+            ::pthread_create(&senders[index].thread, nullptr, RunSender, &senders[index]);
+        }
+        timespec duration{time_t(config.durationMs / 1000), long(config.durationMs % 1000 * 1000000)};
+        ::nanosleep(&duration, nullptr);
+        sending.store(false, std::memory_order_relaxed);
+        UInt64 sent = 0, received = 0, bytes = 0;
+        for (int index = 0; index < config.senders; ++index) {
+            ::pthread_join(senders[index].thread, nullptr);
+            sent += senders[index].sent;
+        }
+        double elapsed = double(MonotonicNs() - start) / 1e9;
+        timespec drain{0, 200000000};
+        ::nanosleep(&drain, nullptr);
+        server.Stop();
+
+        LatencyHistogram latency;
+        for (int index = 0; index < shards; ++index) {
+            received += receivers[index].received;
+            bytes += receivers[index].bytes;
+            latency.Merge(receivers[index].latency);
+        }
+        double loss = sent ? double(sent - (received < sent ? received : sent)) / double(sent) : 0;
+        if (config.json) {
+            ::printf("{\"transport\":\"udp\",\"sharded\":true,\"shards\":%d,\"steered\":%s,\"size\":%d,"
+                     "\"batch\":%d,\"senders\":%d,\"rate\":%llu,\"duration_ms\":%llu,\"sent\":%llu,"
+                     "\"received\":%llu,\"loss\":%.6f,\"messages_per_second\":%.0f,\"bytes_per_second\":%.0f,"
+                     "\"latency_ns\":{\"p50\":%llu,\"p99\":%llu}}\n", shards, steered ? "true" : "false",
+                     config.size, config.batch, config.senders, (unsigned long long) config.rate,
+                     (unsigned long long) config.durationMs, (unsigned long long) sent,
+                     (unsigned long long) received, loss, double(received) / elapsed, double(bytes) / elapsed,
+                     (unsigned long long) latency.GetPercentile(50), (unsigned long long) latency.GetPercentile(99));
+        } else {
+            ::printf("%8d %14.0f %10.1f %10.3f %12.1f %12.1f\n", shards, double(received) / elapsed,
+                     double(bytes) / elapsed / 1e6, loss * 100, double(latency.GetPercentile(50)) / 1e3,
+                     double(latency.GetPercentile(99)) / 1e3);
+        }
+        delete[] senders;
+        delete[] handlers;
+        delete[] receivers;
+        if (shards == config.receivers) {
+            break;
+        }
+    }
+}
+
+static bool ParseArgument(const char *argument, BenchConfig &config) {
+    const char *value = ::strchr(argument, '=');
+    value = value ? value + 1 : "";
+    if (!::strcmp(argument, "--json")) {
+        config.json = true;
+    } else if (!::strcmp(argument, "--loop")) {
+        config.loop = true;
+    } else if (!::strcmp(argument, "--single")) {
+        config.single = true;
+    } else if (!::strcmp(argument, "--gso")) {
+        config.gso = true;
+    } else if (!::strcmp(argument, "--breakdown")) {
+        config.breakdown = true;
+    } else if (!::strcmp(argument, "--sharded")) {
+        config.sharded = true;
+    } else if (!::strncmp(argument, "--transport=", 12)) {
+        if (::strcmp(value, "udp") && ::strcmp(value, "tcp") && ::strcmp(value, "shm")) {
+            return false;
+        }
+        config.tcp = !::strcmp(value, "tcp");
+        config.shm = !::strcmp(value, "shm");
+    } else if (!::strncmp(argument, "--size=", 7)) {
+        config.size = ::atoi(value);
+    } else if (!::strncmp(argument, "--batch=", 8)) {
+        config.batch = ::atoi(value);
+    } else if (!::strncmp(argument, "--senders=", 10)) {
+        config.senders = ::atoi(value);
+    } else if (!::strncmp(argument, "--receivers=", 12)) {
+        config.receivers = ::atoi(value);
+    } else if (!::strncmp(argument, "--rate=", 7)) {
+        config.rate = ::strtoull(value, nullptr, 10);
+    } else if (!::strncmp(argument, "--duration=", 11)) {
+        config.durationMs = ::strtoull(value, nullptr, 10);
+    } else if (!::strncmp(argument, "--port=", 7)) {
+        config.port = ::atoi(value);
+    } else if (!::strncmp(argument, "--min-rate=", 11)) {
+        config.minimumRate = ::strtoull(value, nullptr, 10);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    BenchConfig config;
+    for (int index = 1; index < argc; ++index) {
+        if (!ParseArgument(argv[index], config)) {
+            ::fprintf(stderr, "usage: %s [--transport=udp|tcp|shm] [--size=N] [--batch=N] [--senders=N] "
+                              "[--receivers=N] [--rate=N] [--duration=MS] [--port=N] [--loop] [--single] "
+                              "[--gso] [--sharded] [--breakdown] [--min-rate=N] [--json]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (config.size < int(sizeof(UInt64)) || config.size > 65507 || config.batch < 1 ||
+        config.batch > int(DatagramServer::MaximumBatchSize) || config.senders < 1 || config.receivers < 1) {
+        ::fprintf(stderr, "size must be in [8, 65507], batch in [1, %d], senders and receivers at least 1\n",
+                  int(DatagramServer::MaximumBatchSize));
+        return 2;
+    }
+    if (config.breakdown && (config.tcp || config.shm || config.single || config.sharded)) {
+        ::fprintf(stderr, "--breakdown is UDP only, without --single and --sharded\n");
+        return 2;
+    }
+    if (config.shm && (config.single || config.gso || config.loop || config.sharded)) {
+        ::fprintf(stderr, "--single, --gso, --loop and --sharded are UDP only\n");
+        return 2;
+    }
+    if (config.gso && (config.tcp || config.single || config.batch > DatagramServer::MaximumSegmentCount ||
+                       config.size * config.batch > 65507)) {
+        ::fprintf(stderr, "--gso is UDP only, without --single, with batch at most %d and size * batch at most "
+                          "65507\n", DatagramServer::MaximumSegmentCount);
+        return 2;
+    }
+    if (config.sharded) {
+        if (config.tcp) {
+            ::fprintf(stderr, "--sharded is UDP only\n");
+            return 2;
+        }
+        RunSharded(config);
+        return 0;
+    }
+
+    BenchReceiver *receivers = new BenchReceiver[config.receivers];
+    StreamServer listener;
+    for (int index = 0; index < config.receivers; ++index) {
+        BenchReceiver &receiver = receivers[index];
+        receiver.config = &config;
+        if (config.shm) {
+            if (!receiver.ring.BindAnonymous(SharedRingCapacity)) {
+                ::fprintf(stderr, "memfd: %s\n", ::strerror(errno));
+                return 1;
+            }
+            ::pthread_create(&receiver.thread, nullptr, RunReceiver, &receiver);
+        } else if (!config.tcp) {
+            int bufferSize = 8 << 20;
+            ::setsockopt(receiver.server.GetHandle(), SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+            receiver.server.SetReusePort().Bind("127.0.0.1", config.port).SetNonBlocking();
+            if (config.breakdown && !receiver.server.EnableTimestamping()) {
+                ::fprintf(stderr, "SO_TIMESTAMPING: %s\n", ::strerror(errno));
+                return 1;
+            }
+            ::pthread_create(&receiver.thread, nullptr, RunReceiver, &receiver);
+        }
+    }
+    if (config.tcp) {
+        listener.Bind("127.0.0.1", config.port).Listen();
+    }
+    BenchSender *senders = new BenchSender[config.senders];
+    UInt64 start = MonotonicNs();
+    for (int index = 0; index < config.senders; ++index) {
+        senders[index].config = &config;
+        if (config.shm) { // The client owns its duplicate.
+            senders[index].hMemory = ::dup(receivers[index % config.receivers].ring.GetHandle());
+        }
+        ::pthread_create(&senders[index].thread, nullptr, RunSender, &senders[index]);
+    }
+    if (config.tcp) { // Connections are dealt to receivers before they start, so none of them needs a lock.
+        for (int index = 0; index < config.senders; ++index) {
+            int accepted = listener.Accept();
+            assert(accepted != SOCKET_ERROR);
+            receivers[index % config.receivers].connections.Append(new StreamClient(accepted, 1 << 20));
+        }
+        for (int index = 0; index < config.receivers; ++index) {
+            ::pthread_create(&receivers[index].thread, nullptr, RunReceiver, &receivers[index]);
+        }
+    }
+    timespec duration{time_t(config.durationMs / 1000), long(config.durationMs % 1000 * 1000000)};
+    ::nanosleep(&duration, nullptr);
+    sending.store(false, std::memory_order_relaxed);
+    for (int index = 0; index < config.senders; ++index) {
+        ::pthread_join(senders[index].thread, nullptr);
+    }
+    double elapsed = double(MonotonicNs() - start) / 1e9;
+    timespec drain{0, 200000000};
+    ::nanosleep(&drain, nullptr);
+    receiving.store(false, std::memory_order_relaxed);
+
+    UInt64 sent = 0, failed = 0, received = 0, bytes = 0;
+    LatencyHistogram latency;
+    LatencyBreakdown breakdown;
+    for (int index = 0; index < config.senders; ++index) {
+        sent += senders[index].sent;
+        failed += senders[index].failed;
+    }
+    for (int index = 0; index < config.receivers; ++index) {
+        ::pthread_join(receivers[index].thread, nullptr);
+        received += receivers[index].received;
+        bytes += receivers[index].bytes;
+        latency.Merge(receivers[index].latency);
+        breakdown.Merge(receivers[index].breakdown);
+    }
+    const char *stageNames[] = {"wire_to_kernel", "kernel_to_user", "user_to_handler"};
+    double loss = sent ? double(sent - (received < sent ? received : sent)) / double(sent) : 0;
+    if (config.json) {
+        ::printf("{\"transport\":\"%s\",\"size\":%d,\"batch\":%d,\"senders\":%d,\"receivers\":%d,\"loop\":%s,"
+                 "\"single\":%s,\"gso\":%s,\"rate\":%llu,\"duration_ms\":%llu,"
+                 "\"sent\":%llu,\"send_failed\":%llu,\"received\":%llu,\"loss\":%.6f,"
+                 "\"messages_per_second\":%.0f,\"bytes_per_second\":%.0f,"
+                 "\"latency_ns\":{\"mean\":%llu,\"p50\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}",
+                 TransportName(config), config.size, config.batch, config.senders, config.receivers,
+                 config.loop ? "true" : "false", config.single ? "true" : "false",
+                 config.gso ? "true" : "false", (unsigned long long) config.rate,
+                 (unsigned long long) config.durationMs, (unsigned long long) sent, (unsigned long long) failed,
+                 (unsigned long long) received, loss, double(received) / elapsed, double(bytes) / elapsed,
+                 (unsigned long long) latency.GetMean(), (unsigned long long) latency.GetPercentile(50),
+                 (unsigned long long) latency.GetPercentile(99), (unsigned long long) latency.GetPercentile(99.9),
+                 (unsigned long long) latency.GetMaximum());
+        for (int stage = 0; config.breakdown && stage < 3; ++stage) {
+            const LatencyHistogram &each = breakdown.GetStage(LatencyStage(stage));
+            ::printf("%s\"%s_ns\":{\"p50\":%llu,\"p99\":%llu}", stage ? "," : ",\"breakdown\":{",
+                     stageNames[stage], (unsigned long long) each.GetPercentile(50),
+                     (unsigned long long) each.GetPercentile(99));
+        }
+        ::printf(config.breakdown ? "}}\n" : "}\n");
+    } else {
+        ::printf("%s%s%s%s, size %d B, batch %d, %d sender(s), %d receiver(s), rate %llu/s per sender, %.2f s\n",
+                 TransportName(config), config.single ? " single-shot" : "", config.gso ? " gso" : "",
+                 config.loop ? " (event loop)" : "", config.size, config.batch, config.senders, config.receivers,
+                 (unsigned long long) config.rate, elapsed);
+        ::printf("sent      %llu (%llu refused), received %llu, loss %.3f%%\n", (unsigned long long) sent,
+                 (unsigned long long) failed, (unsigned long long) received, loss * 100);
+        ::printf("rate      %.0f msg/s, %.1f MB/s\n", double(received) / elapsed, double(bytes) / elapsed / 1e6);
+        ::printf("latency   mean %.1f us, p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+                 double(latency.GetMean()) / 1e3, double(latency.GetPercentile(50)) / 1e3,
+                 double(latency.GetPercentile(99)) / 1e3, double(latency.GetPercentile(99.9)) / 1e3,
+                 double(latency.GetMaximum()) / 1e3);
+        for (int stage = 0; config.breakdown && stage < 3; ++stage) {
+            const LatencyHistogram &each = breakdown.GetStage(LatencyStage(stage));
+            ::printf("%-15s p50 %.1f us, p99 %.1f us (%llu datagrams)\n", stageNames[stage],
+                     double(each.GetPercentile(50)) / 1e3, double(each.GetPercentile(99)) / 1e3,
+                     (unsigned long long) each.GetCount());
+        }
+    }
+    for (int index = 0; index < config.receivers; ++index) {
+        for (SizeType connection = 0; connection < receivers[index].connections.GetSize(); ++connection) {
+            delete receivers[index].connections.GetConstAt(connection);
+        }
+    }
+    delete[] senders;
+    delete[] receivers;
+    if (double(received) / elapsed < double(config.minimumRate)) {
+        ::fprintf(stderr, "received %.0f msg/s, below --min-rate=%llu\n", double(received) / elapsed,
+                  (unsigned long long) config.minimumRate);
+        return 1;
+    }
+    return 0;
+}
+
+#else
+
+#include <cstdio>
+
+int main() {
+    ::fprintf(stderr, "msggo_netbench needs Linux (recvmmsg/sendmmsg).\n");
+    return 1;
+}
+
+#endif
@@ -0,0 +1,179 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+// Task throughput of ThreadPool against its worker count.
+// inject: one outside thread submits every task by the injection queue, in batches as a receive loop would.
+// fork:   every task of a binary tree submits its two children to its own deque, idle workers steal them.
+// Each task spins --work rounds of a tiny loop, so 0 measures the bare scheduling cost.
+//
+// Usage: msggo_poolbench [--workload=inject|fork] [--threads=N] [--tasks=1000000] [--work=0] [--json]
+//   --threads  largest worker count, it is doubled from 1 up to that (default: the cores).
+//   --tasks    tasks of a run, the fork tree is rounded up to full levels.
+//   --json     print one JSON object per worker count instead of the table.
+
+#include "../Escapist/Common/ThreadPool.h"
+
+#ifdef ESCAPIST_OS_LINUX
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+struct BenchConfig {
+    bool fork = false;
+    int threads = OS::GetCoreCount();
+    UInt64 tasks = 1000000;
+    UInt32 work = 0;
+    bool json = false;
+};
+
+static UInt64 MonotonicNs() noexcept {
+    timespec now{};
+    ::clock_gettime(CLOCK_MONOTONIC, &now);
+    return UInt64(now.tv_sec) * 1000000000ull + UInt64(now.tv_nsec);
+}
+
+static UInt64 Spin(UInt32 rounds) noexcept {
+    volatile UInt64 sink = 0;
+    for (UInt32 round = 0; round < rounds; ++round) {
+        sink = sink + round;
+    }
+    return sink;
+}
+
+/**
+ * Leaf work of both workloads, a fork task submits its children first (context is its depth).
+ */
+class BenchTask : public TaskHandler {
+private:
+    ThreadPool &pool;
+    UInt32 work;
+    bool fork;
+
+public:
+    BenchTask(ThreadPool &pool, UInt32 work, bool fork) : pool(pool), work(work), fork(fork) {}
+
+    void OnTask(UInt64 context) override {
+        if (fork && context) {
+            for (int child = 0; child < 2; ++child) {
+                if (!pool.Submit(this, context - 1)) {
+                    BenchTask::OnTask(context - 1); // No room, run it here.
+                }
+            }
+        }
+        Spin(work);
+    }
+};
+
+static bool ParseArgument(const char *argument, BenchConfig &config) {
+    const char *value = ::strchr(argument, '=');
+    value = value ? value + 1 : "";
+    if (!::strcmp(argument, "--json")) {
+        config.json = true;
+    } else if (!::strncmp(argument, "--workload=", 11)) {
+        if (::strcmp(value, "inject") && ::strcmp(value, "fork")) {
+            return false;
+        }
+        config.fork = !::strcmp(value, "fork");
+    } else if (!::strncmp(argument, "--threads=", 10)) {
+        config.threads = ::atoi(value);
+    } else if (!::strncmp(argument, "--tasks=", 8)) {
+        config.tasks = ::strtoull(value, nullptr, 10);
+    } else if (!::strncmp(argument, "--work=", 7)) {
+        config.work = UInt32(::strtoul(value, nullptr, 10));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @return seconds taken by tasks on a pool of threads workers, stolen tasks into stolen.
+ */
+static double RunOnce(const BenchConfig &config, int threads, UInt64 &tasks, UInt64 &stolen) {
+    ThreadPool pool(threads);
+    BenchTask task(pool, config.work, config.fork);
+    pool.Start();
+    UInt64 start = MonotonicNs();
+    if (config.fork) {
+        UInt64 depth = 0;
+        while ((2ull << depth) - 1 < config.tasks) {
+            ++depth;
+        }
+        tasks = (2ull << depth) - 1;
+        while (!pool.Submit(&task, depth)) {
+            OS::CpuRelax();
+        }
+    } else {
+        tasks = config.tasks;
+        Task batch[32];
+        for (SizeType index = 0; index < 32; ++index) {
+            batch[index] = Task{&task, 0};
+        }
+        for (UInt64 submitted = 0; submitted < tasks;) {
+            SizeType count = tasks - submitted < 32 ? SizeType(tasks - submitted) : 32;
+            SizeType accepted = pool.Submit(batch, count);
+            if (!accepted) {
+                OS::CpuRelax();
+            }
+            submitted += accepted;
+        }
+    }
+    while (pool.GetExecutedCount() < tasks) {
+        timespec sleep{0, 100000};
+        ::nanosleep(&sleep, nullptr);
+    }
+    double elapsed = double(MonotonicNs() - start) / 1e9;
+    stolen = pool.GetStolenCount();
+    pool.Stop();
+    return elapsed;
+}
+
+int main(int argc, char **argv) {
+    BenchConfig config;
+    for (int index = 1; index < argc; ++index) {
+        if (!ParseArgument(argv[index], config)) {
+            ::fprintf(stderr, "usage: %s [--workload=inject|fork] [--threads=N] [--tasks=N] [--work=N] [--json]\n",
+                      argv[0]);
+            return 2;
+        }
+    }
+    if (config.threads < 1 || !config.tasks) {
+        ::fprintf(stderr, "threads and tasks must be at least 1\n");
+        return 2;
+    }
+    if (!config.json) {
+        ::printf("%s, %llu tasks, work %u\n", config.fork ? "fork" : "inject", (unsigned long long) config.tasks,
+                 config.work);
+        ::printf("%8s %14s %10s\n", "threads", "tasks/s", "stolen");
+    }
+    for (int threads = 1;; threads = threads * 2 < config.threads ? threads * 2 : config.threads) {
+        UInt64 tasks = 0, stolen = 0;
+        double elapsed = RunOnce(config, threads, tasks, stolen);
+        double stolenShare = tasks ? double(stolen) / double(tasks) : 0;
+        if (config.json) {
+            ::printf("{\"workload\":\"%s\",\"threads\":%d,\"tasks\":%llu,\"work\":%u,\"seconds\":%.6f,"
+                     "\"tasks_per_second\":%.0f,\"stolen\":%.6f}\n", config.fork ? "fork" : "inject", threads,
+                     (unsigned long long) tasks, config.work, elapsed, double(tasks) / elapsed, stolenShare);
+        } else {
+            ::printf("%8d %14.0f %9.2f%%\n", threads, double(tasks) / elapsed, stolenShare * 100);
+        }
+        if (threads == config.threads) {
+            break;
+        }
+    }
+    return 0;
+}
+
+#else
+
+#include <cstdio>
+
+int main() {
+    ::fprintf(stderr, "msggo_poolbench needs Linux (futex).\n");
+    return 1;
+}
+
+#endif
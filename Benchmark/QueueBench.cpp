@@ -0,0 +1,203 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+// Contention of MpmcQueue: as many producers as consumers pass elements through one queue, the thread count
+// doubling from 1 up to --threads. Elements are UInt64, or ByteArray handles sharing one payload (moved in and
+// out, so their reference count is not touched).
+//
+// Usage: msggo_queuebench [--element=int|bytes] [--threads=64] [--capacity=1024] [--operations=2000000]
+//                         [--blocking] [--json]
+//   --threads     largest count of producers (and of consumers).
+//   --operations  elements passed per run, split among producers.
+//   --blocking    Push/Pop sleeping on the futex instead of TryPush/TryPop spinning.
+//   --json        print one JSON object per thread count instead of the table.
+
+#include "../Escapist/Common/MpmcQueue.h"
+#include "../Escapist/Common/ByteArray.h"
+
+#ifdef ESCAPIST_OS_LINUX
+
+#include <pthread.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+struct BenchConfig {
+    bool bytes = false;
+    int threads = 64;
+    SizeType capacity = 1024;
+    UInt64 operations = 2000000;
+    bool blocking = false;
+    bool json = false;
+};
+
+template<typename T>
+struct BenchShared {
+    const BenchConfig *config;
+    MpmcQueue<T> *queue;
+    UInt64 perProducer;
+    UInt64 perConsumer;
+    ByteArray payload;
+};
+
+template<typename T>
+struct BenchWorker {
+    BenchShared<T> *shared = nullptr;
+    pthread_t thread{};
+    UInt64 retries = 0; // Times TryPush found the queue full, or TryPop empty.
+};
+
+static UInt64 MonotonicNs() noexcept {
+    timespec now{};
+    ::clock_gettime(CLOCK_MONOTONIC, &now);
+    return UInt64(now.tv_sec) * 1000000000ull + UInt64(now.tv_nsec);
+}
+
+static void MakeElement(BenchShared<UInt64> &, UInt64 index, UInt64 &element) {
+    element = index;
+}
+
+static void MakeElement(BenchShared<ByteArray> &shared, UInt64, ByteArray &element) {
+    element = shared.payload;
+}
+
+template<typename T>
+static void *RunProducer(void *argument) {
+    BenchWorker<T> &worker = *(BenchWorker<T> *) argument;
+    BenchShared<T> &shared = *worker.shared;
+    T element{};
+    for (UInt64 index = 0; index < shared.perProducer; ++index) {
+        MakeElement(shared, index, element);
+        if (shared.config->blocking) {
+            shared.queue->Push(std::move(element));
+            continue;
+        }
+        while (!shared.queue->TryPush(std::move(element))) {
+            ++worker.retries;
+            OS::CpuRelax();
+        }
+    }
+    return nullptr;
+}
+
+template<typename T>
+static void *RunConsumer(void *argument) {
+    BenchWorker<T> &worker = *(BenchWorker<T> *) argument;
+    BenchShared<T> &shared = *worker.shared;
+    T element{};
+    for (UInt64 index = 0; index < shared.perConsumer; ++index) {
+        if (shared.config->blocking) {
+            shared.queue->Pop(element);
+            continue;
+        }
+        while (!shared.queue->TryPop(element)) {
+            ++worker.retries;
+            OS::CpuRelax();
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @return seconds taken to pass the operations with threads producers and as many consumers.
+ */
+template<typename T>
+static double RunOnce(const BenchConfig &config, int threads, UInt64 &operations, UInt64 &retries) {
+    MpmcQueue<T> queue(config.capacity);
+    BenchShared<T> shared{&config, &queue, config.operations / UInt64(threads), config.operations / UInt64(threads),
+                          ByteArray()};
+    shared.payload.Append(byte(0), 64);
+    operations = shared.perProducer * UInt64(threads);
+    BenchWorker<T> *workers = new BenchWorker<T>[threads * 2];
+    UInt64 start = MonotonicNs();
+    for (int index = 0; index < threads * 2; ++index) {
+        workers[index].shared = &shared;
+        ::pthread_create(&workers[index].thread, nullptr, index < threads ? RunProducer<T> : RunConsumer<T>,
+                         &workers[index]);
+    }
+    retries = 0;
+    for (int index = 0; index < threads * 2; ++index) {
+        ::pthread_join(workers[index].thread, nullptr);
+        retries += workers[index].retries;
+    }
+    double elapsed = double(MonotonicNs() - start) / 1e9;
+    delete[] workers;
+    return elapsed;
+}
+
+static bool ParseArgument(const char *argument, BenchConfig &config) {
+    const char *value = ::strchr(argument, '=');
+    value = value ? value + 1 : "";
+    if (!::strcmp(argument, "--json")) {
+        config.json = true;
+    } else if (!::strcmp(argument, "--blocking")) {
+        config.blocking = true;
+    } else if (!::strncmp(argument, "--element=", 10)) {
+        if (::strcmp(value, "int") && ::strcmp(value, "bytes")) {
+            return false;
+        }
+        config.bytes = !::strcmp(value, "bytes");
+    } else if (!::strncmp(argument, "--threads=", 10)) {
+        config.threads = ::atoi(value);
+    } else if (!::strncmp(argument, "--capacity=", 11)) {
+        config.capacity = SizeType(::strtoull(value, nullptr, 10));
+    } else if (!::strncmp(argument, "--operations=", 13)) {
+        config.operations = ::strtoull(value, nullptr, 10);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    BenchConfig config;
+    for (int index = 1; index < argc; ++index) {
+        if (!ParseArgument(argv[index], config)) {
+            ::fprintf(stderr, "usage: %s [--element=int|bytes] [--threads=N] [--capacity=N] [--operations=N] "
+                              "[--blocking] [--json]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (config.threads < 1 || !config.capacity || (config.capacity & (config.capacity - 1)) ||
+        config.operations < UInt64(config.threads)) {
+        ::fprintf(stderr, "threads must be at least 1, capacity a power of 2, operations at least threads\n");
+        return 2;
+    }
+    const char *element = config.bytes ? "bytes" : "int";
+    if (!config.json) {
+        ::printf("%s, capacity %zu, %llu operations, %s\n", element, config.capacity,
+                 (unsigned long long) config.operations, config.blocking ? "blocking" : "spinning");
+        ::printf("%8s %14s %12s\n", "threads", "ops/s", "retries/op");
+    }
+    for (int threads = 1;; threads = threads * 2 < config.threads ? threads * 2 : config.threads) {
+        UInt64 operations = 0, retries = 0;
+        double elapsed = config.bytes ? RunOnce<ByteArray>(config, threads, operations, retries)
+                                      : RunOnce<UInt64>(config, threads, operations, retries);
+        double retriesPerOperation = double(retries) / double(operations);
+        if (config.json) {
+            ::printf("{\"element\":\"%s\",\"threads\":%d,\"capacity\":%zu,\"operations\":%llu,\"blocking\":%s,"
+                     "\"seconds\":%.6f,\"operations_per_second\":%.0f,\"retries_per_operation\":%.4f}\n", element,
+                     threads, config.capacity, (unsigned long long) operations, config.blocking ? "true" : "false",
+                     elapsed, double(operations) / elapsed, retriesPerOperation);
+        } else {
+            ::printf("%8d %14.0f %12.3f\n", threads, double(operations) / elapsed, retriesPerOperation);
+        }
+        if (threads == config.threads) {
+            break;
+        }
+    }
+    return 0;
+}
+
+#else
+
+#include <cstdio>
+
+int main() {
+    ::fprintf(stderr, "msggo_queuebench needs Linux (futex).\n");
+    return 1;
+}
+
+#endif
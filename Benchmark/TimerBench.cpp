@@ -0,0 +1,240 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+// Cost of TimerWheel against a binary heap (std::priority_queue, cancelled entries skipped when they surface),
+// in virtual time so the clock costs nothing. Each run schedules --timers timers spread over --span ms, cancels
+// --cancel percent of them in random order, then advances the clock tick by tick until every timer fired.
+// The run fails (exit 1) if a structure fires a timer early, twice, or a cancelled one.
+//
+// Usage: msggo_timerbench [--timers=1000000] [--span=10000] [--cancel=50] [--tick=1000] [--seed=1] [--json]
+//   --span    largest delay in milliseconds, delays are uniform in [0, span].
+//   --cancel  percent of timers cancelled before the clock moves.
+//   --tick    resolution of the wheel in microseconds, also the step of the clock.
+//   --json    print one JSON object per structure instead of the table.
+
+#include "../Escapist/Common/TimerWheel.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+#include <vector>
+
+struct BenchConfig {
+    UInt64 timers = 1000000;
+    UInt64 spanMs = 10000;
+    double cancel = 50;
+    UInt64 tickUs = 1000;
+    UInt64 seed = 1;
+    bool json = false;
+};
+
+struct BenchResult {
+    double scheduleNs = 0; // Per timer.
+    double cancelNs = 0; // Per cancelled timer.
+    double advanceNs = 0; // Per fired timer, empty ticks included.
+    UInt64 fired = 0;
+    UInt64 errors = 0; // Early, repeated, or cancelled timers that fired.
+};
+
+static UInt64 MonotonicNs() noexcept {
+    return (UInt64) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static UInt64 NextRandom(UInt64 &state) noexcept {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ull;
+}
+
+/**
+ * The same deadlines and cancellations for both structures.
+ */
+struct BenchPlan {
+    std::vector<UInt64> deadlines;
+    std::vector<UInt64> cancelled; // Indexes of timers, in the order they are cancelled.
+    std::vector<bool> isCancelled;
+};
+
+/**
+ * Checks every firing against the plan, context is the index of the timer.
+ */
+class BenchTimerHandler : public TimerHandler {
+private:
+    const BenchPlan &plan;
+    std::vector<bool> fired;
+    const UInt64 &now;
+
+public:
+    UInt64 firedCount = 0;
+    UInt64 errorCount = 0;
+
+    BenchTimerHandler(const BenchPlan &plan, const UInt64 &now) : plan(plan), fired(plan.deadlines.size()), now(now) {}
+
+    void OnTimer(TimerId, UInt64 context) override {
+        BenchTimerHandler::Fire(context);
+    }
+
+    void Fire(UInt64 index) {
+        if (fired[index] || plan.isCancelled[index] || now < plan.deadlines[index]) {
+            ++errorCount;
+        }
+        fired[index] = true;
+        ++firedCount;
+    }
+};
+
+static BenchResult RunWheel(const BenchConfig &config, const BenchPlan &plan) {
+    BenchResult result;
+    UInt64 now = 0;
+    BenchTimerHandler handler(plan, now);
+    TimerWheel wheel(config.tickUs, SizeType(config.timers), now);
+    std::vector<TimerId> ids(config.timers);
+    UInt64 start = MonotonicNs();
+    for (UInt64 index = 0; index < config.timers; ++index) {
+        ids[index] = wheel.ScheduleAt(plan.deadlines[index], &handler, index);
+    }
+    UInt64 scheduled = MonotonicNs();
+    for (UInt64 index : plan.cancelled) {
+        if (!wheel.Cancel(ids[index])) {
+            ++result.errors;
+        }
+    }
+    UInt64 cancelled = MonotonicNs();
+    while (wheel.GetPendingCount()) {
+        now += config.tickUs;
+        wheel.Advance(now);
+    }
+    UInt64 advanced = MonotonicNs();
+    result.scheduleNs = double(scheduled - start) / double(config.timers);
+    result.cancelNs = plan.cancelled.empty() ? 0 : double(cancelled - scheduled) / double(plan.cancelled.size());
+    result.fired = handler.firedCount;
+    result.advanceNs = result.fired ? double(advanced - cancelled) / double(result.fired) : 0;
+    result.errors += handler.errorCount;
+    return result;
+}
+
+static BenchResult RunHeap(const BenchConfig &config, const BenchPlan &plan) {
+    typedef std::pair<UInt64, UInt64> Entry; // Deadline rounded up to a tick, index.
+    BenchResult result;
+    UInt64 now = 0;
+    BenchTimerHandler handler(plan, now);
+    std::vector<Entry> storage;
+    storage.reserve(config.timers);
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap(std::greater<Entry>(),
+                                                                                std::move(storage));
+    std::vector<bool> alive(config.timers);
+    UInt64 start = MonotonicNs();
+    for (UInt64 index = 0; index < config.timers; ++index) {
+        heap.push(Entry((plan.deadlines[index] + config.tickUs - 1) / config.tickUs * config.tickUs, index));
+        alive[index] = true;
+    }
+    UInt64 scheduled = MonotonicNs();
+    for (UInt64 index : plan.cancelled) {
+        alive[index] = false; // Lazily, the entry is skipped when it reaches the top.
+    }
+    UInt64 cancelled = MonotonicNs();
+    while (!heap.empty()) {
+        now += config.tickUs;
+        while (!heap.empty() && heap.top().first <= now) {
+            UInt64 index = heap.top().second;
+            heap.pop();
+            if (alive[index]) {
+                alive[index] = false;
+                handler.Fire(index);
+            }
+        }
+    }
+    UInt64 advanced = MonotonicNs();
+    result.scheduleNs = double(scheduled - start) / double(config.timers);
+    result.cancelNs = plan.cancelled.empty() ? 0 : double(cancelled - scheduled) / double(plan.cancelled.size());
+    result.fired = handler.firedCount;
+    result.advanceNs = result.fired ? double(advanced - cancelled) / double(result.fired) : 0;
+    result.errors += handler.errorCount;
+    return result;
+}
+
+static bool ParseArgument(const char *argument, BenchConfig &config) {
+    const char *value = ::strchr(argument, '=');
+    value = value ? value + 1 : "";
+    if (!::strcmp(argument, "--json")) {
+        config.json = true;
+    } else if (!::strncmp(argument, "--timers=", 9)) {
+        config.timers = ::strtoull(value, nullptr, 10);
+    } else if (!::strncmp(argument, "--span=", 7)) {
+        config.spanMs = ::strtoull(value, nullptr, 10);
+    } else if (!::strncmp(argument, "--cancel=", 9)) {
+        config.cancel = ::atof(value);
+    } else if (!::strncmp(argument, "--tick=", 7)) {
+        config.tickUs = ::strtoull(value, nullptr, 10);
+    } else if (!::strncmp(argument, "--seed=", 7)) {
+        config.seed = ::strtoull(value, nullptr, 10);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    BenchConfig config;
+    for (int index = 1; index < argc; ++index) {
+        if (!ParseArgument(argv[index], config)) {
+            ::fprintf(stderr, "usage: %s [--timers=N] [--span=MS] [--cancel=PCT] [--tick=US] [--seed=N] [--json]\n",
+                      argv[0]);
+            return 2;
+        }
+    }
+    if (!config.timers || config.timers >= 0xFFFFFFFFull || !config.tickUs || config.cancel < 0 ||
+        config.cancel > 100) {
+        ::fprintf(stderr, "timers must be in [1, 2^32 - 1), tick at least 1, cancel in [0, 100]\n");
+        return 2;
+    }
+
+    BenchPlan plan;
+    UInt64 state = config.seed ? config.seed : 1;
+    plan.deadlines.resize(config.timers);
+    plan.isCancelled.resize(config.timers);
+    for (UInt64 index = 0; index < config.timers; ++index) {
+        plan.deadlines[index] = NextRandom(state) % (config.spanMs * 1000 + 1);
+        if (double(NextRandom(state) % 10000) < config.cancel * 100) {
+            plan.cancelled.push_back(index);
+            plan.isCancelled[index] = true;
+        }
+    }
+    for (SizeType index = plan.cancelled.size(); index > 1; --index) { // Shuffle, cancels hit random slots.
+        std::swap(plan.cancelled[index - 1], plan.cancelled[NextRandom(state) % index]);
+    }
+    UInt64 expected = config.timers - plan.cancelled.size();
+
+    if (!config.json) {
+        ::printf("%llu timers over %llu ms, %.0f%% cancelled, tick %llu us\n", (unsigned long long) config.timers,
+                 (unsigned long long) config.spanMs, config.cancel, (unsigned long long) config.tickUs);
+        ::printf("%6s %14s %14s %14s %10s\n", "", "schedule ns", "cancel ns", "fire ns", "fired");
+    }
+    bool failed = false;
+    const char *names[] = {"wheel", "heap"};
+    for (int run = 0; run < 2; ++run) {
+        BenchResult result = run ? RunHeap(config, plan) : RunWheel(config, plan);
+        failed = failed || result.errors || result.fired != expected;
+        if (config.json) {
+            ::printf("{\"structure\":\"%s\",\"timers\":%llu,\"span_ms\":%llu,\"cancel\":%.2f,\"tick_us\":%llu,"
+                     "\"schedule_ns\":%.1f,\"cancel_ns\":%.1f,\"fire_ns\":%.1f,\"fired\":%llu,\"errors\":%llu}\n",
+                     names[run], (unsigned long long) config.timers, (unsigned long long) config.spanMs,
+                     config.cancel, (unsigned long long) config.tickUs, result.scheduleNs, result.cancelNs,
+                     result.advanceNs, (unsigned long long) result.fired, (unsigned long long) result.errors);
+        } else {
+            ::printf("%6s %14.1f %14.1f %14.1f %10llu\n", names[run], result.scheduleNs, result.cancelNs,
+                     result.advanceNs, (unsigned long long) result.fired);
+        }
+        if (result.errors || result.fired != expected) {
+            ::fprintf(stderr, "%s fired %llu of %llu timers, %llu early, twice or cancelled\n", names[run],
+                      (unsigned long long) result.fired, (unsigned long long) expected,
+                      (unsigned long long) result.errors);
+        }
+    }
+    return failed ? 1 : 0;
+}
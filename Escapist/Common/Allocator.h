@@ -0,0 +1,382 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_ALLOCATOR_H
+#define ESCAPIST_ALLOCATOR_H
+
+#include "../General.h"
+#include "Internal/Allocator.h"
+#include <new>
+
+struct AllocatorStatistics {
+    UInt64 bytesInUse; // Bytes requested by buffers not released yet.
+    UInt64 peakBytesInUse;
+    UInt64 bytesReserved; // Bytes taken from the heap, in use or kept for reuse.
+    UInt64 allocationCount;
+};
+
+namespace EscapistPrivate {
+    /**
+     * Buffers of allocators are aligned like those of ::malloc, behind a header of the same size.
+     */
+    constexpr SizeType AllocationAlignment = 16;
+
+    constexpr SizeType AlignAllocation(SizeType size) noexcept {
+        return (size + AllocationAlignment - 1) & ~(AllocationAlignment - 1);
+    }
+
+    inline void CountAllocation(AllocatorStatistics &statistics, SizeType size) noexcept {
+        statistics.bytesInUse += size;
+        ++statistics.allocationCount;
+        if (statistics.bytesInUse > statistics.peakBytesInUse) {
+            statistics.peakBytesInUse = statistics.bytesInUse;
+        }
+    }
+
+    inline void CountRelease(AllocatorStatistics &statistics, SizeType size) noexcept {
+        statistics.bytesInUse = statistics.bytesInUse > size ? statistics.bytesInUse - size : 0;
+    }
+}
+
+/**
+ * Install an allocator for the containers (ArrayList, ByteArray, BasicString) of the calling thread while in
+ * scope, the one installed before comes back at its end.\n
+ * Only fresh buffers are taken from it: a buffer is resized and released by the allocator it came from.
+ */
+class AllocatorScope {
+private:
+    EscapistPrivate::Allocator *previous;
+
+public:
+    explicit AllocatorScope(EscapistPrivate::Allocator &allocator) noexcept
+            : previous(EscapistPrivate::Allocator::Current()) {
+        EscapistPrivate::Allocator::Current() = &allocator;
+    }
+
+    AllocatorScope(const AllocatorScope &other) = delete;
+
+    ~AllocatorScope() {
+        EscapistPrivate::Allocator::Current() = previous;
+    }
+};
+
+/**
+ * Bump-pointer allocator for the temporaries of one request or batch: an allocation moves a cursor through a
+ * chunk, a release gives nothing back (but the latest buffer, which may also grow in place), and Reset rewinds
+ * everything at once, keeping the chunks for the next round.\n
+ * Not thread-safe: containers taking buffers from an arena must be released by the thread using it, before Reset.
+ */
+class Arena : public EscapistPrivate::Allocator {
+public:
+    static constexpr SizeType DefaultChunkSize = 64 * 1024;
+
+private:
+    struct Chunk {
+        Chunk *next;
+        SizeType capacity;
+    };
+
+    struct Header {
+        SizeType size;
+        SizeType padding;
+    };
+
+    static_assert(sizeof(Chunk) % EscapistPrivate::AllocationAlignment == 0, "Chunk breaks the alignment!");
+    static_assert(sizeof(Header) == EscapistPrivate::AllocationAlignment, "Header breaks the alignment!");
+
+    SizeType chunkSize;
+    Chunk *first = nullptr;
+    Chunk *current = nullptr;
+    UInt8 *cursor = nullptr;
+    UInt8 *end = nullptr;
+    UInt8 *last = nullptr; // The latest buffer, which can grow or be given back in place.
+    SizeType liveCount = 0;
+    AllocatorStatistics statistics{};
+
+    /**
+     * Move to the next chunk holding size bytes, reused since Reset or taken from the heap.
+     */
+    bool NextChunk(SizeType size) noexcept {
+        Chunk *chunk = current ? current->next : first;
+        while (chunk && chunk->capacity < size) {
+            chunk = chunk->next;
+        }
+        if (!chunk) {
+            SizeType capacity = size > chunkSize ? size : chunkSize;
+            chunk = (Chunk *) ::malloc(sizeof(Chunk) + capacity);
+            if (!chunk) {
+                return false;
+            }
+            chunk->capacity = capacity;
+            Chunk *&link = current ? current->next : first;
+            chunk->next = link;
+            link = chunk;
+            statistics.bytesReserved += capacity;
+        }
+        current = chunk;
+        cursor = (UInt8 *) (chunk + 1);
+        end = cursor + chunk->capacity;
+        return true;
+    }
+
+public:
+    explicit Arena(SizeType chunkSize = Arena::DefaultChunkSize) noexcept: chunkSize(chunkSize) {}
+
+    Arena(const Arena &other) = delete;
+
+    ~Arena() override {
+        assert(!liveCount);
+        while (first) {
+            Chunk *next = first->next;
+            ::free(first);
+            first = next;
+        }
+    }
+
+    void *Allocate(SizeType size) noexcept override {
+        SizeType total = sizeof(Header) + EscapistPrivate::AlignAllocation(size);
+        if (SizeType(end - cursor) < total && !Arena::NextChunk(total)) {
+            return nullptr;
+        }
+        Header *header = (Header *) cursor;
+        header->size = size;
+        cursor += total;
+        last = (UInt8 *) (header + 1);
+        ++liveCount;
+        EscapistPrivate::CountAllocation(statistics, size);
+        return last;
+    }
+
+    void *Reallocate(void *buffer, SizeType size) noexcept override {
+        Header *header = (Header *) buffer - 1;
+        if (buffer == last && EscapistPrivate::AlignAllocation(size) <= SizeType(end - last)) {
+            EscapistPrivate::CountRelease(statistics, header->size);
+            EscapistPrivate::CountAllocation(statistics, size);
+            --statistics.allocationCount; // Grown in place, not a new one.
+            header->size = size;
+            cursor = last + EscapistPrivate::AlignAllocation(size);
+            return buffer;
+        }
+        void *moved = Arena::Allocate(size);
+        if (moved) {
+            ::memcpy(moved, buffer, header->size < size ? header->size : size);
+            Arena::Release(buffer);
+        }
+        return moved;
+    }
+
+    void Release(void *buffer) noexcept override {
+        Header *header = (Header *) buffer - 1;
+        EscapistPrivate::CountRelease(statistics, header->size);
+        --liveCount;
+        if (buffer == last) {
+            cursor = (UInt8 *) header;
+            last = nullptr;
+        }
+    }
+
+    /**
+     * Rewind to the first chunk, every buffer must have been released.
+     */
+    void Reset() noexcept {
+        assert(!liveCount);
+        current = nullptr;
+        cursor = end = last = nullptr;
+        statistics.bytesInUse = 0;
+    }
+
+    /**
+     * @return count of buffers not released yet.
+     */
+    SizeType GetLiveCount() const noexcept {
+        return liveCount;
+    }
+
+    AllocatorStatistics GetStatistics() const noexcept {
+        return statistics;
+    }
+};
+
+/**
+ * Size-class pool: buffers up to 64 KB are rounded up to a power of 2, and released ones are kept on free lists
+ * of the releasing thread for its next allocation of that class, so steady traffic doesn't reach ::malloc.
+ * Larger buffers are left to the heap.\n
+ * The lists are thread-local, so it takes no lock and a buffer may be released by any thread. Use the one
+ * instance, e.g. AllocatorScope scope(SizeClassPool::GetInstance()) at the top of a worker.\n
+ * Statistics cover every thread, by relaxed atomics: a buffer is often released by another thread than the one
+ * allocating it, so counts kept per thread would never balance.
+ */
+class SizeClassPool : public EscapistPrivate::Allocator {
+public:
+    static constexpr SizeType SmallestClass = 64;
+    static constexpr int ClassCount = 11; // Up to 64 KB, header included.
+    static constexpr UInt32 CacheLimit = 256; // Free blocks a thread keeps per class.
+
+private:
+    struct Header {
+        UInt32 sizeClass;
+        UInt32 padding;
+        SizeType size;
+    };
+
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    struct Cache {
+        FreeBlock *lists[SizeClassPool::ClassCount];
+        UInt32 lengths[SizeClassPool::ClassCount];
+    };
+
+    AllocatorStatistics statistics{};
+
+    static_assert(sizeof(Header) == EscapistPrivate::AllocationAlignment, "Header breaks the alignment!");
+
+    static Cache *&CacheSlot() noexcept {
+        static thread_local Cache *cache = nullptr;
+        return cache;
+    }
+
+    /**
+     * Gives the free blocks of a thread back to the heap when it exits.
+     */
+    struct CacheGuard {
+        ~CacheGuard() {
+            Cache *&cache = SizeClassPool::CacheSlot();
+            for (int sizeClass = 0; cache && sizeClass < SizeClassPool::ClassCount; ++sizeClass) {
+                while (FreeBlock *block = cache->lists[sizeClass]) {
+                    cache->lists[sizeClass] = block->next;
+                    SizeClassPool::GetInstance().CountReserved(-(SizeClassPool::SmallestClass << sizeClass));
+                    ::free(block);
+                }
+            }
+            delete cache;
+            cache = nullptr;
+            SizeClassPool::IsExiting() = true;
+        }
+    };
+
+    static bool &IsExiting() noexcept {
+        static thread_local bool exiting = false;
+        return exiting;
+    }
+
+    /**
+     * @return lists of the calling thread, nullptr while it exits (everything goes to the heap then).
+     */
+    static Cache *GetCache() noexcept {
+        Cache *&cache = SizeClassPool::CacheSlot();
+        if (!cache && !SizeClassPool::IsExiting()) {
+            static thread_local CacheGuard guard;
+            (void) guard;
+            cache = new(std::nothrow) Cache{};
+        }
+        return cache;
+    }
+
+    static int GetSizeClass(SizeType total) noexcept {
+        int sizeClass = 0;
+        while (sizeClass < SizeClassPool::ClassCount && (SizeClassPool::SmallestClass << sizeClass) < total) {
+            ++sizeClass;
+        }
+        return sizeClass;
+    }
+
+    /**
+     * @param delta bytes, wrapping around for a negative one.
+     */
+    void CountInUse(SizeType delta, bool fresh) noexcept {
+        UInt64 inUse = __atomic_add_fetch(&statistics.bytesInUse, UInt64(delta), __ATOMIC_RELAXED);
+        if (fresh) {
+            __atomic_add_fetch(&statistics.allocationCount, 1, __ATOMIC_RELAXED);
+        }
+        UInt64 peak = __atomic_load_n(&statistics.peakBytesInUse, __ATOMIC_RELAXED);
+        while (inUse > peak && !__atomic_compare_exchange_n(&statistics.peakBytesInUse, &peak, inUse, true,
+                                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+    }
+
+    void CountReserved(SizeType delta) noexcept {
+        __atomic_add_fetch(&statistics.bytesReserved, UInt64(delta), __ATOMIC_RELAXED);
+    }
+
+    SizeClassPool() noexcept = default;
+
+public:
+    SizeClassPool(const SizeClassPool &other) = delete;
+
+    /**
+     * Never destroyed, so buffers may be released during static destruction.
+     */
+    static SizeClassPool &GetInstance() noexcept {
+        static SizeClassPool *instance = new SizeClassPool();
+        return *instance;
+    }
+
+    void *Allocate(SizeType size) noexcept override {
+        int sizeClass = SizeClassPool::GetSizeClass(sizeof(Header) + size);
+        if (sizeClass == SizeClassPool::ClassCount) {
+            return nullptr;
+        }
+        Cache *cache = SizeClassPool::GetCache();
+        FreeBlock *block = cache ? cache->lists[sizeClass] : nullptr;
+        if (block) {
+            cache->lists[sizeClass] = block->next;
+            --cache->lengths[sizeClass];
+        } else {
+            block = (FreeBlock *) ::malloc(SizeClassPool::SmallestClass << sizeClass);
+            if (!block) {
+                return nullptr;
+            }
+            SizeClassPool::CountReserved(SizeClassPool::SmallestClass << sizeClass);
+        }
+        Header *header = (Header *) block;
+        header->sizeClass = UInt32(sizeClass);
+        header->size = size;
+        SizeClassPool::CountInUse(size, true);
+        return header + 1;
+    }
+
+    void *Reallocate(void *buffer, SizeType size) noexcept override {
+        Header *header = (Header *) buffer - 1;
+        if (sizeof(Header) + size <= SizeClassPool::SmallestClass << header->sizeClass) {
+            SizeClassPool::CountInUse(size - header->size, false); // Grown in place, not a new one.
+            header->size = size;
+            return buffer;
+        }
+        void *moved = SizeClassPool::Allocate(size);
+        if (moved) {
+            ::memcpy(moved, buffer, header->size);
+            SizeClassPool::Release(buffer);
+        }
+        return moved;
+    }
+
+    void Release(void *buffer) noexcept override {
+        Header *header = (Header *) buffer - 1;
+        UInt32 sizeClass = header->sizeClass;
+        SizeClassPool::CountInUse(-header->size, false);
+        Cache *cache = SizeClassPool::GetCache();
+        if (cache && cache->lengths[sizeClass] < SizeClassPool::CacheLimit) {
+            FreeBlock *block = (FreeBlock *) header;
+            block->next = cache->lists[sizeClass];
+            cache->lists[sizeClass] = block;
+            ++cache->lengths[sizeClass];
+        } else {
+            SizeClassPool::CountReserved(-(SizeClassPool::SmallestClass << sizeClass));
+            ::free(header);
+        }
+    }
+
+    /**
+     * @return statistics of every thread, each field read on its own while other threads may be counting.
+     */
+    AllocatorStatistics GetStatistics() const noexcept {
+        return AllocatorStatistics{__atomic_load_n(&statistics.bytesInUse, __ATOMIC_RELAXED),
+                                   __atomic_load_n(&statistics.peakBytesInUse, __ATOMIC_RELAXED),
+                                   __atomic_load_n(&statistics.bytesReserved, __ATOMIC_RELAXED),
+                                   __atomic_load_n(&statistics.allocationCount, __ATOMIC_RELAXED)};
+    }
+};
+
+#endif //ESCAPIST_ALLOCATOR_H
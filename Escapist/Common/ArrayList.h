@@ -10,6 +10,8 @@
 #define ESCAPIST_ARRAYLIST_H
 
 #include "../General.h"
+#include "Internal/Allocator.h"
+#include "Internal/BufferOwner.h"
 #include "Internal/ReferenceCount.h"
 #include "Internal/TypeTrait.h"
 
@@ -22,6 +24,7 @@ class ArrayList {
     static_assert(std::is_trivially_copy_constructible<T>::value, "T must be copy constructible!");
 
     using ReferenceCount = EscapistPrivate::ReferenceCount;
+    using BufferOwner = EscapistPrivate::BufferOwner;
     using TypeTrait = typename EscapistPrivate::TypeTraitPatternSelector<T>::TypeTrait;
 
     /**
@@ -46,6 +49,13 @@ class ArrayList {
      */
     SizeType capacity_;
 
+    /**
+     * Null if buf_ is allocated from heap, otherwise buf_ is borrowed (or taken from an allocator, see
+     * AllocatorScope) and must be given back to it.\n
+     * A borrowed buffer can be read, written and shared, but only resized by its owner.
+     */
+    BufferOwner *owner_;
+
     static constexpr SizeType MinimumCapacity = (8 * sizeof(T *)) / sizeof(T);
     static constexpr bool EnableMinimumCapacity = ArrayList<T>::MinimumCapacity;
 
@@ -105,21 +115,60 @@ class ArrayList {
      * @param ref initial reference count pointer, only applied when we're enlarging buffer.
      */
     void SimpleAllocate(ReferenceCount *const &ref) {
-        assert(buf_ = (ReferenceCount **) ::malloc(ArrayList<T>::TotalCapacity(capacity_)));
+        buf_ = (ReferenceCount **) EscapistPrivate::AllocateBuffer(ArrayList<T>::TotalCapacity(capacity_), owner_);
+        assert(buf_);
         // TODO: Why sometimes malloc fails and return nullptr? UIUC CS 233 / CS 340 / CS 341!
         data_ = (T *) (buf_ + 1); // Point the data to one pointer behind the head.
         *buf_ = ref;
     }
 
     /**
-     * 1. Reallocate the data by current capacity.\n
+     * Give a buffer back to where it comes from.
+     */
+    static void ReleaseBuffer(ReferenceCount **buf, BufferOwner *owner) noexcept {
+        EscapistPrivate::ReleaseBuffer((void *) buf, owner);
+    }
+
+    /**
+     * @return true if this object views part of a buffer (see ArrayList::Slice), rather than the whole of it.
+     */
+    bool IsSlice() const noexcept {
+        return data_ != (T *) (buf_ + 1);
+    }
+
+    /**
+     * @return true if writing must copy the data out first: the buffer is shared, or this object is a slice.
+     */
+    bool MustDetach() const noexcept {
+        return buf_ && ((*buf_ && (**buf_).GetValue() > 1) || ArrayList<T>::IsSlice());
+    }
+
+    /**
+     * Drop the reference to a buffer that was detached from, give it back if nobody else refers to it.\n
+     * Called after copying, a slice may hold the last reference of its buffer.
+     */
+    static void LeaveBuffer(ReferenceCount **buf, BufferOwner *owner) noexcept {
+        if (*buf && (**buf).GetValue() > 1) {
+            (**buf).DecrementRef();
+        } else {
+            ::free((void *) (*buf));
+            ArrayList<T>::ReleaseBuffer(buf, owner);
+        }
+    }
+
+    /**
+     * 1. Reallocate the data by current capacity, by the owner of a borrowed buffer (which may move it to
+     * another owner, or the heap).\n
      * 2. Reassign the reference count pointer and data pointer.
+     * @param keep count of elements to keep, only applied if the buffer moves.
      */
-    void SimpleReallocate() {
+    void SimpleReallocate(SizeType keep) {
         assert(buf_);
         ReferenceCount **oldBuf = buf_;
         ReferenceCount *oldRef = *buf_;
-        assert(buf_ = (ReferenceCount **) ::realloc(buf_, ArrayList<T>::TotalCapacity(capacity_)));
+        buf_ = (ReferenceCount **) EscapistPrivate::ReallocateBuffer(buf_, ArrayList<T>::TotalCapacity(keep),
+                                                                    ArrayList<T>::TotalCapacity(capacity_), owner_);
+        assert(buf_);
         if (oldBuf != buf_) { // If buffer changed its address, the data pointer still points to old reference count.
             data_ = (T *) (buf_ + 1);
             *buf_ = oldRef;
@@ -136,18 +185,20 @@ class ArrayList {
             if (data_) { // Check if we have data before.
                 SizeType oldSize = size_; // We might change the value of this member variable, so store it at first!
                 size_ += growthSize; // Move out because all 3 cases need to change the size.
-                if (*buf_ && (**buf_).GetValue() > 1) { // Case 1: this object is sharing with another object.
+                if (ArrayList<T>::MustDetach()) { // Case 1: this object is sharing with another object.
+                    ReferenceCount **oldBuf = buf_;
+                    BufferOwner *oldOwner = owner_;
                     T *const oldData = data_; // Store old data and detach from old memory.
-                    (**buf_).DecrementRef();
                     capacity_ = ArrayList<T>::CalcCapacity(size_);
                     ArrayList<T>::SimpleAllocate(nullptr);
                     TypeTrait::Copy(data_, oldData, oldSize); // Copy from old data finally.
+                    ArrayList<T>::LeaveBuffer(oldBuf, oldOwner);
                     // Now, current objects is irrelevant to old shared memory.
                 } else {
                     // directly operate in buffer
                     if (size_ > capacity_) { // Case 2: is not sharing, but the capacity is not large enough to
                         capacity_ = ArrayList<T>::CalcCapacity(size_);
-                        ArrayList<T>::SimpleReallocate();
+                        ArrayList<T>::SimpleReallocate(oldSize);
                     }
                     // Case 3: the capacity is large enough, we just need to reset the size.
                 }
@@ -170,12 +221,14 @@ class ArrayList {
             if (data_) { // Check if we have data before.
                 SizeType oldSize = size_;
                 size_ += growthSize;
-                if (*buf_ && (**buf_).GetValue() > 1) { // Case 1: this object is sharing with another object.
+                if (ArrayList<T>::MustDetach()) { // Case 1: this object is sharing with another object.
+                    ReferenceCount **oldBuf = buf_;
+                    BufferOwner *oldOwner = owner_;
                     T *const oldData = data_; // Store old data and detach from old memory.
-                    (**buf_).DecrementRef();
                     capacity_ = ArrayList<T>::CalcCapacity(size_);
                     ArrayList<T>::SimpleAllocate(nullptr);
                     TypeTrait::Copy(data_ + growthSize, oldData, oldSize); // Copy from old data finally.
+                    ArrayList<T>::LeaveBuffer(oldBuf, oldOwner);
                     // For Prepend, we have to reserve spaces for new data.
                 } else {
                     // directly operate in buffer
@@ -187,15 +240,17 @@ class ArrayList {
                         if (capacity_ - oldCapacity > oldCapacity * 2) {
                             // If we grow too large, leftover space might not large enough.
                             // At this time, we simply reallocate and copy it to right place.
+                            ReferenceCount **oldBuf = buf_;
+                            BufferOwner *oldOwner = owner_;
                             T *oldData = data_;
                             ArrayList<T>::SimpleAllocate(*buf_);
                             EscapistPrivate::PodTypeTrait<T>::Copy(data_ + growthSize, oldData, oldSize);
-                            ::free((void *) buf_);
+                            ArrayList<T>::ReleaseBuffer(oldBuf, oldOwner);
                             // Because in this case, this object doesn't share with any other objects, we don't need to run the constructor.
                             // But remember to free the old data.
                             // We don't need to free RC pointer because it was assigned to new position in SimpleAllocate
                         } else {
-                            ArrayList<T>::SimpleReallocate();
+                            ArrayList<T>::SimpleReallocate(oldSize);
                             TypeTrait::Move(data_ + growthSize, data_, oldSize);
                         }
                     } else {
@@ -221,14 +276,16 @@ class ArrayList {
             if (data_) {
                 SizeType oldSize = size_;
                 size_ += growthSize;
-                if (*buf_ && (**buf_).GetValue() > 1) { // Case 1: this object is sharing with another object.
+                if (ArrayList<T>::MustDetach()) { // Case 1: this object is sharing with another object.
+                    ReferenceCount **oldBuf = buf_;
+                    BufferOwner *oldOwner = owner_;
                     T *const oldData = data_; // Store old data and detach from old memory.
-                    (**buf_).DecrementRef();
                     capacity_ = ArrayList<T>::CalcCapacity(size_);
                     ArrayList<T>::SimpleAllocate(nullptr);
                     TypeTrait::Copy(data_, oldData, growthIndex);
                     TypeTrait::Copy(data_ + growthIndex + growthSize, oldData + growthIndex,
                                     oldSize - growthIndex);
+                    ArrayList<T>::LeaveBuffer(oldBuf, oldOwner);
                     // For Insert, we have to reserve spaces in middle of data.
                     // Therefore, we need to copy separately.
                 } else {
@@ -238,17 +295,19 @@ class ArrayList {
                         SizeType oldCapacity = capacity_;
                         capacity_ = ArrayList<T>::CalcCapacity(size_);
                         if (capacity_ - oldCapacity > oldCapacity * 2) {
+                            ReferenceCount **oldBuf = buf_;
+                            BufferOwner *oldOwner = owner_;
                             T *oldData = data_;
                             ArrayList<T>::SimpleAllocate(*buf_);
                             EscapistPrivate::PodTypeTrait<T>::Copy(data_, oldData, growthIndex);
                             EscapistPrivate::PodTypeTrait<T>::Copy(data_ + growthIndex + growthSize,
                                                                    oldData + growthIndex, oldSize - growthIndex);
-                            ::free((void *) buf_);
+                            ArrayList<T>::ReleaseBuffer(oldBuf, oldOwner);
                             // Because in this case, this object doesn't share with any other objects, we don't need to run the constructor.
                             // But remember to free the old data.
                             // We don't need to free RC pointer because it was assigned to new position in SimpleAllocate
                         } else {
-                            ArrayList<T>::SimpleReallocate();
+                            ArrayList<T>::SimpleReallocate(oldSize);
                             TypeTrait::Move(data_ + growthIndex + growthSize, data_ + growthIndex,
                                             oldSize - growthIndex);
                             // Data before the index stayed static, but after the index should be moved.
@@ -268,24 +327,24 @@ class ArrayList {
 
     void AssignReset(SizeType newSize) {
         if (newSize) {
-            if (data_ && size_) {
-                if (*buf_ && (**buf_).GetValue() > 1) {
-                    (**buf_).DecrementRef();
+            if (data_) {
+                if (ArrayList<T>::MustDetach()) {
+                    ReferenceCount **oldBuf = buf_;
+                    BufferOwner *oldOwner = owner_;
                     size_ = newSize;
                     capacity_ = ArrayList<T>::CalcCapacity(size_);
                     ArrayList<T>::SimpleAllocate(nullptr);
+                    ArrayList<T>::LeaveBuffer(oldBuf, oldOwner);
                 } else {
-                    SizeType oldSize = size_;
+                    TypeTrait::Destroy(data_, size_);
                     size_ = newSize;
                     if (size_ > capacity_) {
-                        SizeType oldCapacity = capacity_;
+                        // Old data will be overwritten, so there is nothing to keep by realloc.
+                        ReferenceCount **oldBuf = buf_;
+                        BufferOwner *oldOwner = owner_;
                         capacity_ = ArrayList<T>::CalcCapacity(size_);
-                        if (capacity_ - oldCapacity > oldCapacity * 2) {
-                            T *oldData = data_;
-                            ArrayList<T>::SimpleAllocate(*buf_);
-                        } else {
-                            ArrayList<T>::SimpleReallocate();
-                        }
+                        ArrayList<T>::SimpleAllocate(*buf_);
+                        ArrayList<T>::ReleaseBuffer(oldBuf, oldOwner);
                     }
                 }
             } else {
@@ -305,19 +364,33 @@ class ArrayList {
     }
 
 public:
-    ArrayList() noexcept: buf_(nullptr), data_(nullptr), size_(0), capacity_(0) {}
+    ArrayList() noexcept: buf_(nullptr), data_(nullptr), size_(0), capacity_(0), owner_(nullptr) {}
 
     /**
      * Initialize by indicated size and capacity. capacity cannot smaller than size!
      */
     ArrayList(SizeType size, SizeType capacity)
-            : size_(size), capacity_(capacity) {
+            : buf_(nullptr), data_(nullptr), size_(size), capacity_(capacity), owner_(nullptr) {
         assert(size <= capacity);
         if (capacity_) {
             ArrayList<T>::SimpleAllocate(nullptr);
         }
     }
 
+    /**
+     * Borrow a buffer instead of allocating, the buffer is given back to its owner on destruction.
+     * @param buffer head of buffer, whose first sizeof(void *) bytes are reserved (see ArrayList::HeaderSize).
+     * @param size count of valid elements behind the reserved bytes.
+     * @param capacity count of elements the buffer is able to hold.
+     * @param owner where the buffer will be given back, cannot be null.
+     */
+    ArrayList(void *buffer, SizeType size, SizeType capacity, BufferOwner *owner) noexcept
+            : buf_((ReferenceCount **) buffer), data_((T *) (buf_ + 1)), size_(size), capacity_(capacity),
+              owner_(owner) {
+        assert(buffer && owner && size <= capacity);
+        *buf_ = nullptr;
+    }
+
     /**
      * Initialize by an indicated value.
      * @param value indicated value
@@ -355,7 +428,8 @@ public:
      * @param other another object
      */
     ArrayList(const ArrayList<T> &other) noexcept
-            : buf_(other.buf_), data_(other.data_), size_(other.size_), capacity_(other.capacity_) {
+            : buf_(other.buf_), data_(other.data_), size_(other.size_), capacity_(other.capacity_),
+              owner_(other.owner_) {
         if (buf_ && data_ && size_) {
             ArrayList<T>::IncrementRef();
         } else {
@@ -363,6 +437,16 @@ public:
         }
     }
 
+    /**
+     * Take over the buffer of another object, without touching reference count.
+     * @param other another object, it'll be null.
+     */
+    ArrayList(ArrayList<T> &&other) noexcept
+            : buf_(other.buf_), data_(other.data_), size_(other.size_), capacity_(other.capacity_),
+              owner_(other.owner_) {
+        new(&other)ArrayList<T>();
+    }
+
     ArrayList(const ArrayList<T> &other, SizeType size, SizeType offset) noexcept {
         if (other.buf_ && other.data_) {
             if (size && size >= other.size_) {
@@ -398,10 +482,38 @@ public:
                 }
             }
             TypeTrait::Destroy(data_, size_);
-            ::free((void *) buf_);
+            ArrayList<T>::ReleaseBuffer(buf_, owner_);
         }
     }
 
+    ArrayList<T> &operator=(const ArrayList<T> &other) noexcept {
+        return ArrayList<T>::Assign(other);
+    }
+
+    ArrayList<T> &operator=(ArrayList<T> &&other) noexcept {
+        if (this != &other) {
+            this->~ArrayList<T>();
+            new(this)ArrayList<T>((ArrayList<T> &&) other);
+        }
+        return *this;
+    }
+
+    /**
+     * Count of bytes reserved in front of data, a borrowed buffer must reserve them as well.
+     */
+    static constexpr SizeType HeaderSize = sizeof(ReferenceCount *);
+
+    bool IsBorrowed() const noexcept {
+        return owner_ != nullptr;
+    }
+
+    /**
+     * @return true if another object refers to the same buffer, so writing would copy it first.
+     */
+    bool IsShared() const noexcept {
+        return data_ && buf_ && *buf_ && (**buf_).GetValue() > 1;
+    }
+
     SizeType GetSize() const noexcept {
         return data_ ? size_ : 0;
     }
@@ -412,12 +524,14 @@ public:
 
     T *GetData() noexcept {
         if (data_) {
-            if (buf_ && *buf_ && (**buf_).GetValue() > 1) { // This object is sharing, detach at first.
+            if (ArrayList<T>::MustDetach()) { // This object is sharing, detach at first.
+                ReferenceCount **oldBuf = buf_;
+                BufferOwner *oldOwner = owner_;
                 T *oldData = data_;
-                (**buf_).DecrementRef();
                 capacity_ = ArrayList<T>::CalcCapacity(size_);
-                ArrayList<T>::SimpleAllocate(*buf_);
+                ArrayList<T>::SimpleAllocate(nullptr);
                 TypeTrait::Copy(data_, oldData, size_);
+                ArrayList<T>::LeaveBuffer(oldBuf, oldOwner);
             }
             return data_;
         }
@@ -430,12 +544,14 @@ public:
 
     T &GetAt(SizeType index) {
         assert(data_ && index < size_);
-        if (buf_ && *buf_ && (**buf_).GetValue() > 1) { // This object is sharing, detach at first.
+        if (ArrayList<T>::MustDetach()) { // This object is sharing, detach at first.
+            ReferenceCount **oldBuf = buf_;
+            BufferOwner *oldOwner = owner_;
             T *oldData = data_;
-            (**buf_).DecrementRef();
             capacity_ = ArrayList<T>::CalcCapacity(size_);
-            ArrayList<T>::SimpleAllocate(*buf_);
+            ArrayList<T>::SimpleAllocate(nullptr);
             TypeTrait::Copy(data_, oldData, size_);
+            ArrayList<T>::LeaveBuffer(oldBuf, oldOwner);
         }
         return data_[index];
     }
@@ -447,27 +563,30 @@ public:
 
     ArrayList<T> &SetAt(SizeType index, const T &value) {
         assert(data_ && index < size_);
-        if (buf_ && *buf_ && (**buf_).GetValue() > 1) { // This object is sharing, detach at first.
+        if (ArrayList<T>::MustDetach()) { // This object is sharing, detach at first.
+            ReferenceCount **oldBuf = buf_;
+            BufferOwner *oldOwner = owner_;
             T *oldData = data_;
-            (**buf_).DecrementRef();
             capacity_ = ArrayList<T>::CalcCapacity(size_);
-            ArrayList<T>::SimpleAllocate(*buf_);
+            ArrayList<T>::SimpleAllocate(nullptr);
             TypeTrait::Copy(data_, oldData, index);
-            TypeTrait::Copy(data_ + index + 1, oldData - index, size_ - index);
+            TypeTrait::Copy(data_ + index + 1, oldData + index + 1, size_ - index - 1);
+            ArrayList<T>::LeaveBuffer(oldBuf, oldOwner);
         }
         new(data_ + index)T(value);
+        return *this;
     }
 
     bool IsEmpty() const noexcept {
-        return data_ && size_;
+        return !data_ || !size_;
     }
 
     bool IsNull() const noexcept {
-        return buf_ && capacity_;
+        return !buf_ || !capacity_;
     }
 
     bool IsEmptyOrNull() const noexcept {
-        return buf_ && data_ && size_ && capacity_;
+        return ArrayList<T>::IsEmpty() || ArrayList<T>::IsNull();
     }
 
     ArrayList<T> &Empty() noexcept {
@@ -485,15 +604,21 @@ public:
 
     ArrayList<T> &EnsureCapacity(SizeType capacity) noexcept {
         if (capacity > capacity_) {
-            if (buf_ && *buf_ && (**buf_).GetValue() > 1) { // This object is sharing, detach at first.
+            if (ArrayList<T>::MustDetach()) { // This object is sharing, detach at first.
+                ReferenceCount **oldBuf = buf_;
+                BufferOwner *oldOwner = owner_;
                 T *oldData = data_;
-                (**buf_).DecrementRef();
                 capacity_ = capacity;
-                ArrayList<T>::SimpleAllocate(*buf_);
+                ArrayList<T>::SimpleAllocate(nullptr);
                 TypeTrait::Copy(data_, oldData, size_);
+                ArrayList<T>::LeaveBuffer(oldBuf, oldOwner);
+            } else if (!buf_) { // Nothing to keep, just allocate.
+                size_ = 0;
+                capacity_ = capacity;
+                ArrayList<T>::SimpleAllocate(nullptr);
             } else {
                 capacity_ = capacity;
-                ArrayList<T>::SimpleReallocate();
+                ArrayList<T>::SimpleReallocate(size_);
             }
         }
         return *this;
@@ -614,13 +739,15 @@ public:
 
     ArrayList<T> &Delete(SizeType index, SizeType count, bool copyTo = false) noexcept {
         if (index < size_ && count) {
-            if (buf_ && *buf_ && (**buf_).GetValue() > 1) {
+            if (ArrayList<T>::MustDetach()) {
+                ReferenceCount **oldBuf = buf_;
+                BufferOwner *oldOwner = owner_;
                 T *oldData = data_;
-                (**buf_).DecrementRef();
                 capacity_ = ArrayList<T>::CalcCapacity(size_);
-                ArrayList<T>::SimpleAllocate(*buf_);
+                ArrayList<T>::SimpleAllocate(nullptr);
                 TypeTrait::Copy(data_, oldData, index);
                 TypeTrait::Copy(data_ + index, oldData + index + count, size_ - index - count);
+                ArrayList<T>::LeaveBuffer(oldBuf, oldOwner);
             } else {
                 TypeTrait::Move(data_ + index, data_ + index + count, size_ - index - count);
             }
@@ -646,11 +773,13 @@ public:
     }
 
     ArrayList<T> &Assign(const ArrayList<T> &other) noexcept {
-        ArrayList<T>::Empty();
-        if (other.data_ && other.size_) {
-            new(this)ArrayList<T>(other);
-        } else {
-            new(this)ArrayList<T>();
+        if (this != &other) {
+            this->~ArrayList<T>(); // Leave current buffer at first, otherwise it'll never be freed.
+            if (other.data_ && other.size_) {
+                new(this)ArrayList<T>(other);
+            } else {
+                new(this)ArrayList<T>();
+            }
         }
         return *this;
     }
@@ -668,6 +797,24 @@ public:
         }
     }
 
+    /**
+     * Refer to count elements from index without copying, unlike Middle.\n
+     * The slice shares the whole buffer, which stays alive until the slice is gone or detaches by its first write.
+     */
+    ArrayList<T> Slice(SizeType index, SizeType count) const noexcept {
+        assert(index <= size_ && count <= size_ - index);
+        ArrayList<T> slice;
+        if (data_ && count) {
+            slice.buf_ = buf_;
+            slice.data_ = data_ + index;
+            slice.size_ = count;
+            slice.capacity_ = count;
+            slice.owner_ = owner_;
+            slice.IncrementRef();
+        }
+        return slice;
+    }
+
     ArrayList<T> Left(SizeType count) const noexcept {
         if (count >= size_) {
             return *this;
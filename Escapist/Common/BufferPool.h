@@ -0,0 +1,401 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_BUFFERPOOL_H
+#define ESCAPIST_BUFFERPOOL_H
+
+#include "../General.h"
+#include "ByteArray.h"
+#include "Internal/BufferOwner.h"
+#include <atomic>
+
+namespace EscapistPrivate {
+    constexpr int MaximumPoolThreads = 64;
+
+    /**
+     * Keeps something per thread index (e.g. a cache), told when the thread holding an index exits so that it can
+     * give back what that thread kept before the index goes to another thread.
+     */
+    class ThreadIndexUser {
+    public:
+        ThreadIndexUser *previousUser = nullptr;
+        ThreadIndexUser *nextUser = nullptr;
+
+        /**
+         * Called by the exiting thread itself.
+         */
+        virtual void OnThreadExit(int index) noexcept = 0;
+
+    protected:
+        ~ThreadIndexUser() = default;
+    };
+
+    /**
+     * Hands out the small thread indices, the lowest free one first, and takes them back when threads exit.
+     */
+    class ThreadIndexRegistry {
+    private:
+        std::atomic_flag lock = ATOMIC_FLAG_INIT;
+        UInt64 used = 0; // Bit i is set while index i belongs to a thread.
+        ThreadIndexUser *users = nullptr;
+
+        static_assert(EscapistPrivate::MaximumPoolThreads <= 64, "Indices don't fit in the bit set!");
+
+        void Lock() noexcept {
+            while (lock.test_and_set(std::memory_order_acquire));
+        }
+
+        void Unlock() noexcept {
+            lock.clear(std::memory_order_release);
+        }
+
+        ThreadIndexRegistry() noexcept = default;
+
+    public:
+        ThreadIndexRegistry(const ThreadIndexRegistry &other) = delete;
+
+        /**
+         * Never destroyed, so threads may still exit during static destruction.
+         */
+        static ThreadIndexRegistry &GetInstance() noexcept {
+            static ThreadIndexRegistry *instance = new ThreadIndexRegistry();
+            return *instance;
+        }
+
+        /**
+         * @return the lowest free index, MaximumPoolThreads if all are taken.
+         */
+        int Claim() noexcept {
+            ThreadIndexRegistry::Lock();
+            int index = 0;
+            while (index < EscapistPrivate::MaximumPoolThreads && (used >> index & 1)) {
+                ++index;
+            }
+            if (index < EscapistPrivate::MaximumPoolThreads) {
+                used |= UInt64(1) << index;
+            }
+            ThreadIndexRegistry::Unlock();
+            return index;
+        }
+
+        /**
+         * Tell every user that the thread of index exits, then free the index.
+         */
+        void Release(int index) noexcept {
+            if (index >= EscapistPrivate::MaximumPoolThreads) {
+                return;
+            }
+            ThreadIndexRegistry::Lock();
+            for (ThreadIndexUser *user = users; user; user = user->nextUser) {
+                user->OnThreadExit(index);
+            }
+            used &= ~(UInt64(1) << index);
+            ThreadIndexRegistry::Unlock();
+        }
+
+        void Register(ThreadIndexUser *user) noexcept {
+            ThreadIndexRegistry::Lock();
+            user->previousUser = nullptr;
+            user->nextUser = users;
+            if (users) {
+                users->previousUser = user;
+            }
+            users = user;
+            ThreadIndexRegistry::Unlock();
+        }
+
+        void Unregister(ThreadIndexUser *user) noexcept {
+            ThreadIndexRegistry::Lock();
+            (user->previousUser ? user->previousUser->nextUser : users) = user->nextUser;
+            if (user->nextUser) {
+                user->nextUser->previousUser = user->previousUser;
+            }
+            ThreadIndexRegistry::Unlock();
+        }
+    };
+
+    inline int &ThreadIndexSlot() noexcept {
+        static thread_local int index = -1;
+        return index;
+    }
+
+    /**
+     * Gives the index back when its thread exits.
+     */
+    struct ThreadIndexGuard {
+        ~ThreadIndexGuard() {
+            int &index = EscapistPrivate::ThreadIndexSlot();
+            EscapistPrivate::ThreadIndexRegistry::GetInstance().Release(index);
+            index = EscapistPrivate::MaximumPoolThreads; // Whatever runs later in this thread goes without an index.
+        }
+    };
+
+    /**
+     * Small index of the calling thread, assigned on first use and reused by a later thread once it exits.
+     * @return MaximumPoolThreads if more threads than that hold one.
+     */
+    inline int GetThreadIndex() noexcept {
+        int &index = EscapistPrivate::ThreadIndexSlot();
+        if (index < 0) {
+            static thread_local ThreadIndexGuard guard;
+            (void) guard;
+            index = EscapistPrivate::ThreadIndexRegistry::GetInstance().Claim();
+        }
+        return index;
+    }
+}
+
+/**
+ * Slab of fixed-size slots that ByteArray can adopt without allocating.\n
+ * Every thread keeps a small free list of its own, only when it runs empty (or full) slots are moved in batch
+ * from (or to) the shared list, so the steady state neither allocates nor contends.
+ * When the slab is exhausted, slots come from heap and count as misses. The cache of a thread goes back to the
+ * shared list when it exits.\n
+ * Slot layout: [ByteArray::HeaderSize][data...], data is GetSlotCapacity() bytes.
+ * A free slot links to the next free slot by its first pointer.
+ */
+class BufferPool : private EscapistPrivate::BufferOwner, private EscapistPrivate::ThreadIndexUser {
+public:
+    static constexpr SizeType DefaultSlotSize = 2048; // Ethernet MTU and the header fit.
+
+    static constexpr int CacheCapacity = 256; // Holds a full receive batch of acquired slots.
+
+private:
+    struct alignas(64) Cache {
+        void *slots[BufferPool::CacheCapacity];
+        int count = 0;
+        std::atomic<UInt64> hits{0};
+        std::atomic<UInt64> misses{0};
+    };
+
+    byte *slab;
+    SizeType slotCount;
+    SizeType slotSize;
+    void *shared; // Head of shared free list.
+    std::atomic_flag sharedLock = ATOMIC_FLAG_INIT;
+    Cache caches[EscapistPrivate::MaximumPoolThreads];
+    std::atomic<UInt64> sharedHits{0}; // Threads beyond MaximumPoolThreads have no cache.
+    std::atomic<UInt64> sharedMisses{0};
+
+    static void *&NextOf(void *slot) noexcept {
+        return *(void **) slot;
+    }
+
+    bool IsInSlab(const void *slot) const noexcept {
+        return (const byte *) slot >= slab && (const byte *) slot < slab + slotCount * slotSize;
+    }
+
+    static void Count(std::atomic<UInt64> &counter, UInt64 count = 1) noexcept {
+        // Only the owning thread writes, so no read-modify-write is needed.
+        counter.store(counter.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+    }
+
+    void LockShared() noexcept {
+        while (sharedLock.test_and_set(std::memory_order_acquire));
+    }
+
+    void UnlockShared() noexcept {
+        sharedLock.clear(std::memory_order_release);
+    }
+
+    /**
+     * Move up to count slots from shared list to cache.
+     */
+    void Refill(Cache &cache, int count) noexcept {
+        LockShared();
+        for (; count > 0 && shared; --count) {
+            void *slot = shared;
+            shared = BufferPool::NextOf(slot);
+            cache.slots[cache.count++] = slot;
+        }
+        UnlockShared();
+    }
+
+    /**
+     * Move count slots from the bottom of cache to shared list.
+     */
+    void Flush(Cache &cache, int count) noexcept {
+        LockShared();
+        for (int index = 0; index < count; ++index) {
+            BufferPool::NextOf(cache.slots[index]) = shared;
+            shared = cache.slots[index];
+        }
+        UnlockShared();
+        cache.count -= count;
+        ::memmove(cache.slots, cache.slots + count, cache.count * sizeof(void *));
+    }
+
+    void Release(void *slot) noexcept override {
+        BufferPool::Free(slot);
+    }
+
+    void OnThreadExit(int index) noexcept override {
+        Cache &cache = caches[index];
+        if (cache.count) {
+            BufferPool::Flush(cache, cache.count);
+        }
+    }
+
+public:
+    /**
+     * @param count count of slots in slab.
+     * @param size size of each slot, including ByteArray::HeaderSize.
+     */
+    explicit BufferPool(SizeType count = 4096, SizeType size = BufferPool::DefaultSlotSize)
+            : slotCount(count), slotSize(size), shared(nullptr) {
+        assert(slotSize > ByteArray::HeaderSize && slotSize % sizeof(void *) == 0);
+        slab = (byte *) ::malloc(slotCount * slotSize);
+        assert(slab);
+        for (SizeType index = slotCount; index > 0; --index) {
+            void *slot = slab + (index - 1) * slotSize;
+            BufferPool::NextOf(slot) = shared;
+            shared = slot;
+        }
+        EscapistPrivate::ThreadIndexRegistry::GetInstance().Register(this);
+    }
+
+    BufferPool(const BufferPool &other) = delete;
+
+    /**
+     * Every ByteArray adopting a slot must be gone before the pool.
+     */
+    ~BufferPool() override {
+        EscapistPrivate::ThreadIndexRegistry::GetInstance().Unregister(this);
+        ::free((void *) slab);
+    }
+
+    SizeType GetSlotCapacity() const noexcept {
+        return slotSize - ByteArray::HeaderSize;
+    }
+
+    /**
+     * @return head of a free slot, never null.
+     */
+    void *Acquire() noexcept {
+        int thread = EscapistPrivate::GetThreadIndex();
+        if (thread < EscapistPrivate::MaximumPoolThreads) {
+            Cache &cache = caches[thread];
+            if (!cache.count) {
+                BufferPool::Refill(cache, BufferPool::CacheCapacity / 2);
+            }
+            if (cache.count) {
+                BufferPool::Count(cache.hits);
+                return cache.slots[--cache.count];
+            }
+            BufferPool::Count(cache.misses);
+        } else {
+            void *slot = nullptr;
+            LockShared();
+            if (shared) {
+                slot = shared;
+                shared = BufferPool::NextOf(slot);
+            }
+            UnlockShared();
+            if (slot) {
+                sharedHits.fetch_add(1, std::memory_order_relaxed);
+                return slot;
+            }
+            sharedMisses.fetch_add(1, std::memory_order_relaxed);
+        }
+        void *slot = ::malloc(slotSize);
+        assert(slot);
+        return slot;
+    }
+
+    /**
+     * Lend count free slots of the calling thread's cache without taking them, e.g. as the buffers of one recvmmsg
+     * of which only some get filled. Take the filled ones (slots[0] on) before anything else acquires from this
+     * pool on this thread, the others just stay in the cache.
+     * @return count, or 0 if the thread has no cache or the slab runs low (Acquire one by one then).
+     */
+    int Lend(void **slots, int count) noexcept {
+        int thread = EscapistPrivate::GetThreadIndex();
+        if (thread >= EscapistPrivate::MaximumPoolThreads || count > BufferPool::CacheCapacity / 2) {
+            return 0;
+        }
+        Cache &cache = caches[thread];
+        if (cache.count < count) {
+            BufferPool::Refill(cache, BufferPool::CacheCapacity / 2);
+            if (cache.count < count) {
+                return 0;
+            }
+        }
+        for (int index = 0; index < count; ++index) {
+            slots[index] = cache.slots[cache.count - 1 - index];
+        }
+        return count;
+    }
+
+    /**
+     * Take slots[0, count) of the last Lend for good, as if acquired.
+     */
+    void Take(int count) noexcept {
+        if (!count) {
+            return;
+        }
+        Cache &cache = caches[EscapistPrivate::GetThreadIndex()];
+        assert(count <= cache.count);
+        cache.count -= count;
+        BufferPool::Count(cache.hits, UInt64(count));
+    }
+
+    /**
+     * Give a slot back without adopting it, ByteArray does it by itself.
+     */
+    void Free(void *slot) noexcept {
+        if (!BufferPool::IsInSlab(slot)) {
+            ::free(slot);
+            return;
+        }
+        int thread = EscapistPrivate::GetThreadIndex();
+        if (thread < EscapistPrivate::MaximumPoolThreads) {
+            Cache &cache = caches[thread];
+            if (cache.count == BufferPool::CacheCapacity) {
+                BufferPool::Flush(cache, BufferPool::CacheCapacity / 2);
+            }
+            cache.slots[cache.count++] = slot;
+        } else {
+            LockShared();
+            BufferPool::NextOf(slot) = shared;
+            shared = slot;
+            UnlockShared();
+        }
+    }
+
+    static byte *GetData(void *slot) noexcept {
+        return (byte *) slot + ByteArray::HeaderSize;
+    }
+
+    /**
+     * Let data adopt the slot, the slot returns to this pool when data (and all its copies) is gone.
+     * @param size count of valid bytes already written to GetData(slot).
+     */
+    void Adopt(ByteArray &data, void *slot, SizeType size) noexcept {
+        data = ByteArray(slot, size, BufferPool::GetSlotCapacity(), this);
+    }
+
+    /**
+     * @return count of Acquire served by slab.
+     */
+    UInt64 GetHitCount() const noexcept {
+        UInt64 count = sharedHits.load(std::memory_order_relaxed);
+        for (int index = 0; index < EscapistPrivate::MaximumPoolThreads; ++index) {
+            count += caches[index].hits.load(std::memory_order_relaxed);
+        }
+        return count;
+    }
+
+    /**
+     * @return count of Acquire that fell back to heap.
+     */
+    UInt64 GetMissCount() const noexcept {
+        UInt64 count = sharedMisses.load(std::memory_order_relaxed);
+        for (int index = 0; index < EscapistPrivate::MaximumPoolThreads; ++index) {
+            count += caches[index].misses.load(std::memory_order_relaxed);
+        }
+        return count;
+    }
+};
+
+#endif //ESCAPIST_BUFFERPOOL_H
@@ -8,7 +8,10 @@
 #include "../General.h"
 #include "ArrayList.h"
 #include "String.h"
+#include <cstdio>
+#ifdef ESCAPIST_OS_WINDOWS
 #include <tchar.h>
+#endif
 
 using byte = unsigned char;
 
@@ -16,24 +19,67 @@ class ByteArray : public ArrayList<byte> {
 private:
     SizeType mark;
 
+    explicit ByteArray(ArrayList<byte> &&other) noexcept: ArrayList<byte>((ArrayList<byte> &&) other), mark(0) {}
+
 public:
     ByteArray() noexcept: ArrayList<byte>(), mark(0) {}
 
     ByteArray(const byte *data, SizeType size, SizeType offset = 0) noexcept:
             ArrayList<byte>(data, size, offset), mark(0) {}
 
+    /**
+     * Allocate capacity bytes at once, the first size bytes are left uninitialized for the caller to fill.
+     */
+    ByteArray(SizeType size, SizeType capacity) : ArrayList<byte>(size, capacity), mark(0) {}
+
     ByteArray(const ByteArray &other) noexcept:
             ArrayList<byte>(other), mark(0) {}
 
+    ByteArray(ByteArray &&other) noexcept:
+            ArrayList<byte>((ArrayList<byte> &&) other), mark(other.mark) {
+        other.mark = 0;
+    }
+
     ByteArray(const ByteArray &other, SizeType size, SizeType otherOffset, SizeType currentOffset) noexcept:
             ArrayList<byte>(other, size, otherOffset, currentOffset), mark(0) {}
 
+    /**
+     * Wrap a buffer of owner without copying, see ArrayList::HeaderSize for the layout.
+     */
+    ByteArray(void *buffer, SizeType size, SizeType capacity, EscapistPrivate::BufferOwner *owner) noexcept:
+            ArrayList<byte>(buffer, size, capacity, owner), mark(0) {}
+
+    ByteArray &operator=(const ByteArray &other) noexcept {
+        ArrayList<byte>::Assign(other);
+        mark = 0;
+        return *this;
+    }
+
+    ByteArray &operator=(ByteArray &&other) noexcept {
+        if (this != &other) {
+            ArrayList<byte>::operator=((ArrayList<byte> &&) other);
+            mark = other.mark;
+            other.mark = 0;
+        }
+        return *this;
+    }
+
+    /**
+     * Refer to count bytes from index without copying, see ArrayList::Slice. The mark of the slice is 0.
+     */
+    ByteArray Slice(SizeType index, SizeType count) const noexcept {
+        return ByteArray(ArrayList<byte>::Slice(index, count));
+    }
+
     ByteArray &ResetMark() noexcept {
         mark = 0;
+        return *this;
     }
 
     ByteArray &IgnoreBytes(const SizeType &count) noexcept {
-        ++mark;
+        assert(GetSize() - mark >= count);
+        mark += count;
+        return *this;
     }
 
     template<typename T>
@@ -174,7 +220,11 @@ public:
         String result;
         Char each[4] = {0};
         for (SizeType index = 0; index < GetSize(); ++index) {
+#ifdef ESCAPIST_OS_WINDOWS
             wsprintf(each, L"%d", GetConstAt(index));
+#else
+            ::snprintf(each, sizeof(each), "%d", GetConstAt(index));
+#endif
             result.Append(each);
             if (index < GetSize() - 1) {
                 result.Append(L',');
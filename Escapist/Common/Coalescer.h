@@ -0,0 +1,258 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_COALESCER_H
+#define ESCAPIST_COALESCER_H
+
+#include "../General.h"
+#include "ByteArray.h"
+#include "Message.h"
+#include "Socket.h"
+#include "TimerWheel.h"
+
+/**
+ * Packs small messages of one channel (a DatagramServer and a peer) into as few datagrams as possible.
+ * Messages keep their MessageHeader, so a datagram is just framed messages back to back and MessageUnpacker
+ * splits it by the payload lengths. The pending datagram is sent when the next message would not fit into mtu,
+ * when the deadline of its first message has passed, or on Flush.\n
+ * The deadline is per coalescer, deadline 0 sends every message at once, for latency-sensitive channels.
+ * With a TimerWheel the deadline is kept by a timer, otherwise the owner calls Poll (e.g. after each
+ * EventLoop::RunOnce, with GetTimeoutMs as an upper bound of the wait).\n
+ * Not thread-safe, like the TimerWheel it may use.
+ */
+class MessageCoalescer : public TimerHandler {
+public:
+    static constexpr SizeType DefaultMtu = 1472; // Ethernet MTU minus IPv4 and UDP headers.
+
+private:
+    DatagramServer &server;
+    DatagramAddress peer;
+    TimerWheel *timers;
+    ByteArray pending;
+    SizeType mtu;
+    UInt64 deadlineUs;
+    UInt64 dueTime = 0; // Microseconds of TimerWheel::Now(), meaningless while nothing is pending.
+    TimerId timer = TimerWheel::InvalidId;
+    SizeType pendingCount = 0;
+    UInt64 datagramCount = 0;
+    UInt64 messageCount = 0;
+
+    /**
+     * Start the deadline of a datagram which is about to receive its first message.
+     */
+    void Open(UInt64 now) {
+        dueTime = now + deadlineUs;
+        if (timers && deadlineUs) {
+            timer = timers->ScheduleAt(dueTime, this);
+        }
+    }
+
+    /**
+     * Send the pending datagram once its size or deadline says so.
+     */
+    bool Close(UInt64 now) {
+        if (!deadlineUs || pending.GetSize() + MessageHeader::Size > mtu || now >= dueTime) {
+            return MessageCoalescer::Flush();
+        }
+        return true;
+    }
+
+public:
+    /**
+     * @param server socket to send by, must outlive the coalescer.
+     * @param deadlineUs longest time a message waits for company, 0 disables coalescing.
+     * @param mtu largest datagram to build, a single message larger than that is sent alone.
+     * @param timers wheel to keep the deadline by, must outlive the coalescer, can be null (see Poll then).
+     */
+    MessageCoalescer(DatagramServer &server, const DatagramAddress &peer, UInt64 deadlineUs = 200,
+                     SizeType mtu = MessageCoalescer::DefaultMtu, TimerWheel *timers = nullptr)
+            : server(server), peer(peer), timers(timers), mtu(mtu), deadlineUs(deadlineUs) {
+        assert(mtu > MessageHeader::Size);
+        pending.EnsureCapacity(mtu);
+    }
+
+    MessageCoalescer(const MessageCoalescer &other) = delete;
+
+    /**
+     * Whatever is still pending is sent.
+     */
+    ~MessageCoalescer() override {
+        MessageCoalescer::Flush();
+    }
+
+    /**
+     * Applies from the next datagram on. Lowering the deadline to 0 sends the pending one now.
+     */
+    MessageCoalescer &SetDeadline(UInt64 deadline) {
+        deadlineUs = deadline;
+        if (!deadlineUs) {
+            MessageCoalescer::Flush();
+        }
+        return *this;
+    }
+
+    UInt64 GetDeadline() const noexcept {
+        return deadlineUs;
+    }
+
+    /**
+     * Frame payload by a MessageHeader right into the pending datagram, no intermediate message.
+     * @return false if a datagram sent on the way was refused by the kernel, it is dropped then.
+     */
+    bool Append(UInt16 type, const Flag<MessageFlag> &flags, const byte *payload, SizeType size,
+                UInt64 now = TimerWheel::Now()) {
+        bool succeeded = true;
+        if (pendingCount && pending.GetSize() + MessageHeader::Size + size > mtu) {
+            succeeded = MessageCoalescer::Flush();
+        }
+        if (!pendingCount) {
+            MessageCoalescer::Open(now);
+        }
+        MessageHeader::Append(pending, type, flags, payload, size);
+        ++pendingCount;
+        return MessageCoalescer::Close(now) && succeeded;
+    }
+
+    bool Append(UInt16 type, const Flag<MessageFlag> &flags, const ByteArray &payload,
+                UInt64 now = TimerWheel::Now()) {
+        return MessageCoalescer::Append(type, flags, payload.GetConstData(), payload.GetSize(), now);
+    }
+
+    /**
+     * Append an already framed message (see MessageHeader::Encode) as it is.
+     */
+    bool Append(const ByteArray &message, UInt64 now = TimerWheel::Now()) {
+        assert(message.GetSize() >= MessageHeader::Size);
+        bool succeeded = true;
+        if (pendingCount && pending.GetSize() + message.GetSize() > mtu) {
+            succeeded = MessageCoalescer::Flush();
+        }
+        if (!pendingCount) {
+            if (message.GetSize() > mtu) {
+                ++messageCount; // Nothing to share a datagram with, no need to copy it.
+                ++datagramCount;
+                return server.SendBatch(&message, &peer, 1) == 1 && succeeded;
+            }
+            MessageCoalescer::Open(now);
+        }
+        pending.Append(message);
+        ++pendingCount;
+        return MessageCoalescer::Close(now) && succeeded;
+    }
+
+    /**
+     * Send the pending datagram now, if any.
+     * @return false if the kernel refused it, it is dropped anyway.
+     */
+    bool Flush() {
+        if (timer != TimerWheel::InvalidId) {
+            timers->Cancel(timer);
+            timer = TimerWheel::InvalidId;
+        }
+        if (!pendingCount) {
+            return true;
+        }
+        bool succeeded = server.SendBatch(&pending, &peer, 1) == 1;
+        messageCount += pendingCount;
+        ++datagramCount;
+        pendingCount = 0;
+        pending.Empty();
+        return succeeded;
+    }
+
+    /**
+     * Flush if the deadline has passed, for coalescers without a TimerWheel.
+     */
+    bool Poll(UInt64 now = TimerWheel::Now()) {
+        return pendingCount && now >= dueTime ? MessageCoalescer::Flush() : true;
+    }
+
+    /**
+     * @return milliseconds until Poll has something to do, -1 if nothing is pending.
+     */
+    int GetTimeoutMs(UInt64 now = TimerWheel::Now()) const noexcept {
+        if (!pendingCount) {
+            return -1;
+        }
+        return dueTime <= now ? 0 : int((dueTime - now + 999) / 1000);
+    }
+
+    void OnTimer(TimerId, UInt64) override {
+        timer = TimerWheel::InvalidId;
+        MessageCoalescer::Flush();
+    }
+
+    SizeType GetPendingCount() const noexcept {
+        return pendingCount;
+    }
+
+    /**
+     * @return count of sent datagrams and of messages in them, their ratio is the coalescing gain.
+     */
+    UInt64 GetDatagramCount() const noexcept {
+        return datagramCount;
+    }
+
+    UInt64 GetMessageCount() const noexcept {
+        return messageCount;
+    }
+};
+
+/**
+ * Walks the messages packed into one datagram by MessageCoalescer, without copying: each Next moves the mark of
+ * the datagram to the payload of the next message, so Read* of the datagram reads that payload in place.
+ * A datagram holding a single message works the same.
+ */
+class MessageUnpacker {
+private:
+    ByteArray &datagram;
+    SizeType offset = 0; // Of the next message.
+    SizeType payload = 0; // Of the current message.
+    bool verifyChecksum;
+    bool malformed = false;
+
+public:
+    /**
+     * @param datagram must stay unchanged while unpacking.
+     * @param verifyChecksum false to skip the checksum, e.g. when the transport already has one.
+     */
+    explicit MessageUnpacker(ByteArray &datagram, bool verifyChecksum = true) noexcept
+            : datagram(datagram), verifyChecksum(verifyChecksum) {}
+
+    /**
+     * @param header of the next message, its payload is the header.payloadLength bytes from the mark.
+     * @return false at the end of the datagram, or at a malformed message, which ends unpacking (see IsMalformed).
+     */
+    bool Next(MessageHeader &header) noexcept {
+        SizeType rest = datagram.GetSize() - offset;
+        if (malformed || !rest) {
+            return false;
+        }
+        const byte *data = datagram.GetConstData() + offset;
+        if (!MessageHeader::Parse(data, rest, header) || header.magic != MessageHeader::Magic ||
+            header.version != MessageHeader::CurrentVersion || header.payloadLength > rest - MessageHeader::Size ||
+            (verifyChecksum &&
+             header.checksum != MessageHeader::Checksum(data + MessageHeader::Size, header.payloadLength))) {
+            malformed = true;
+            return false;
+        }
+        payload = offset + MessageHeader::Size;
+        datagram.ResetMark().IgnoreBytes(payload);
+        offset = payload + header.payloadLength;
+        return true;
+    }
+
+    /**
+     * @return first byte of the payload of the message returned by the last Next.
+     */
+    const byte *GetPayload() const noexcept {
+        return datagram.GetConstData() + payload;
+    }
+
+    bool IsMalformed() const noexcept {
+        return malformed;
+    }
+};
+
+#endif //ESCAPIST_COALESCER_H
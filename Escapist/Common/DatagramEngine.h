@@ -0,0 +1,740 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_DATAGRAMENGINE_H
+#define ESCAPIST_DATAGRAMENGINE_H
+
+#include "../General.h"
+#include "ArrayList.h"
+#include "ByteArray.h"
+#include "BufferPool.h"
+#include "EventLoop.h"
+#include "Socket.h"
+#include "Thread.h"
+#include "Internal/BufferOwner.h"
+#include <atomic>
+#include <new>
+
+#ifdef ESCAPIST_OS_LINUX
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <csignal>
+#include <poll.h>
+
+enum class DatagramBackend {
+    Epoll,
+    IoUring
+};
+
+/**
+ * Receives datagrams dispatched by a DatagramEngine.
+ */
+class DatagramReceiver {
+public:
+    virtual ~DatagramReceiver() = default;
+
+    /**
+     * @param data might borrow a buffer of the engine. Copying the ByteArray shares the buffer without copying
+     * bytes, but the buffer is only given back to the engine after every copy is gone, so don't keep it for long.
+     */
+    virtual void OnDatagram(const DatagramAddress &address, ByteArray &data) = 0;
+};
+
+/**
+ * Receive path of datagram sockets, the backend is chosen at runtime by Create().\n
+ * Sockets are added once and must stay open while the engine is running.
+ * An engine is driven by a single thread, only Stop() can be called from another one.
+ * Datagrams larger than a buffer of the engine are dropped and counted, see GetTruncatedCount.
+ */
+class DatagramEngine {
+protected:
+    UInt64 truncatedCount = 0;
+
+public:
+    virtual ~DatagramEngine() = default;
+
+    /**
+     * Engines hold cache-line aligned members (e.g. the caches of BufferPool), which the plain operator new of
+     * C++11 doesn't honor.
+     */
+    static void *operator new(std::size_t size) {
+        void *memory = nullptr;
+        if (::posix_memalign(&memory, EscapistPrivate::CacheLineSize, size)) {
+            throw std::bad_alloc();
+        }
+        return memory;
+    }
+
+    static void operator delete(void *memory) noexcept {
+        ::free(memory);
+    }
+
+    virtual DatagramBackend GetBackend() const noexcept = 0;
+
+    virtual bool Add(int hSock, DatagramReceiver *receiver) = 0;
+
+    bool Add(DatagramServer &server, DatagramReceiver *receiver) {
+        return Add(server.GetHandle(), receiver);
+    }
+
+    bool Add(DatagramClient &client, DatagramReceiver *receiver) {
+        return Add(client.GetHandle(), receiver);
+    }
+
+    /**
+     * Wait once and dispatch received datagrams.
+     * @param timeoutMs -1 blocks until something arrives.
+     * @return count of dispatched datagrams, -1 if the engine failed.
+     */
+    virtual int RunOnce(int timeoutMs) = 0;
+
+    /**
+     * Dispatch until Stop() is called.
+     */
+    virtual void Run() = 0;
+
+    virtual void Stop() = 0;
+
+    /**
+     * @return count of datagrams dropped so far for being larger than a buffer.
+     */
+    UInt64 GetTruncatedCount() const noexcept {
+        return truncatedCount;
+    }
+
+    /**
+     * @param preferred IoUring falls back to Epoll if the kernel doesn't support it (or it's disabled).
+     * @return a new engine, deleted by caller.
+     */
+    static DatagramEngine *Create(DatagramBackend preferred = DatagramBackend::IoUring);
+};
+
+/**
+ * EventLoop and recvmmsg, works on every Linux kernel. Datagrams are received into slots of a BufferPool.
+ */
+class EpollDatagramEngine : public DatagramEngine {
+private:
+    class Handler : public EventHandler {
+    private:
+        int hSock;
+        DatagramReceiver *receiver;
+        BufferPool &pool;
+        UInt64 &truncated;
+        ByteArray slots[EscapistPrivate::MaximumBatchSize];
+        DatagramAddress addresses[EscapistPrivate::MaximumBatchSize];
+
+    public:
+        int dispatched = 0;
+
+        Handler(int hSock, DatagramReceiver *receiver, BufferPool &pool, UInt64 &truncated)
+                : hSock(hSock), receiver(receiver), pool(pool), truncated(truncated) {}
+
+        Handler(const Handler &other) = delete;
+
+        void OnReadable() override {
+            int count;
+            while ((count = EscapistPrivate::ReceiveBatch(hSock, pool, slots, addresses,
+                                                          EscapistPrivate::MaximumBatchSize, &truncated)) > 0) {
+                for (int index = 0; index < count; ++index) {
+                    receiver->OnDatagram(addresses[index], slots[index]);
+                    slots[index] = ByteArray(); // Give the slot back now rather than on next batch.
+                }
+                dispatched += count;
+            }
+        }
+    };
+
+    BufferPool pool; // Declared first, so it outlives every handler.
+    EventLoop loop;
+    ArrayList<Handler *> handlers;
+
+public:
+    EpollDatagramEngine() = default;
+
+    EpollDatagramEngine(const EpollDatagramEngine &other) = delete;
+
+    ~EpollDatagramEngine() override {
+        for (SizeType index = 0; index < handlers.GetSize(); ++index) {
+            delete handlers.GetConstAt(index);
+        }
+    }
+
+    using DatagramEngine::Add;
+
+    DatagramBackend GetBackend() const noexcept override {
+        return DatagramBackend::Epoll;
+    }
+
+    bool Add(int hSock, DatagramReceiver *receiver) override {
+        assert(receiver);
+        if (!OS::SetNonBlocking(hSock, true)) {
+            return false;
+        }
+        Handler *handler = new Handler(hSock, receiver, pool, truncatedCount);
+        if (!loop.Add(hSock, Flag<EventType>(EventType::Readable), handler)) {
+            delete handler;
+            return false;
+        }
+        handlers.Append(handler);
+        return true;
+    }
+
+    BufferPool &GetPool() noexcept {
+        return pool;
+    }
+
+    int RunOnce(int timeoutMs) override {
+        for (SizeType index = 0; index < handlers.GetSize(); ++index) {
+            handlers.GetConstAt(index)->dispatched = 0;
+        }
+        if (loop.RunOnce(timeoutMs) < 0) {
+            return -1;
+        }
+        int dispatched = 0;
+        for (SizeType index = 0; index < handlers.GetSize(); ++index) {
+            dispatched += handlers.GetConstAt(index)->dispatched;
+        }
+        return dispatched;
+    }
+
+    void Run() override {
+        loop.Run();
+    }
+
+    void Stop() override {
+        loop.Stop();
+    }
+};
+
+namespace EscapistPrivate {
+    inline int IoUringSetup(unsigned entries, io_uring_params *params) noexcept {
+        return (int) ::syscall(__NR_io_uring_setup, entries, params);
+    }
+
+    inline int IoUringEnter(int hRing, unsigned toSubmit, unsigned minComplete, unsigned flags,
+                            const void *arg, SizeType argSize) noexcept {
+        return (int) ::syscall(__NR_io_uring_enter, hRing, toSubmit, minComplete, flags, arg, argSize);
+    }
+
+    inline int IoUringRegister(int hRing, unsigned opcode, const void *arg, unsigned count) noexcept {
+        return (int) ::syscall(__NR_io_uring_register, hRing, opcode, arg, count);
+    }
+}
+
+/**
+ * io_uring with one multishot recvmsg posted per socket, datagrams land in a provided buffer ring.\n
+ * Each buffer is handed to the receiver as a borrowed ByteArray, and goes back to the ring when released,
+ * so there is neither a syscall nor a copy per datagram. Requires Linux 6.0 or later, Setup arms one multishot
+ * recvmsg on a throwaway socket to tell (5.19 has buffer rings, but rejects multishot recvmsg).\n
+ * Buffer layout, as written by the kernel:
+ * [io_uring_recvmsg_out][sockaddr_in][payload...]
+ * The ByteArray header (ArrayList::HeaderSize bytes) overlaps the tail of sockaddr_in (sin_zero),
+ * which is only done after the address has been read out.\n
+ * Every ByteArray borrowing a buffer must be gone before the engine is destroyed.
+ */
+class IoUringDatagramEngine : public DatagramEngine, private EscapistPrivate::BufferOwner {
+public:
+    static constexpr unsigned RingEntries = 256;
+
+    /**
+     * Count of provided buffers, must be a power of two.
+     */
+    static constexpr unsigned BufferCount = 1024;
+
+    static constexpr unsigned BufferSize = 2048;
+
+private:
+    static constexpr UInt16 BufferGroup = 0;
+    static constexpr UInt64 WakeUpData = 0; // user_data of the eventfd poll, registrations are never null.
+    static constexpr UInt64 CancelData = 1; // user_data of the cancel ending the probe of Setup.
+    static constexpr SizeType PayloadOffset = sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_in);
+    static constexpr SizeType PayloadCapacity = IoUringDatagramEngine::BufferSize - IoUringDatagramEngine::PayloadOffset;
+
+    struct Registration {
+        int hSock;
+        DatagramReceiver *receiver;
+        msghdr header; // Read by the kernel for every shot, so it lives as long as the registration.
+        bool armed;
+        bool starved; // Ended by ENOBUFS, re-armed once a buffer comes back.
+        bool failed; // Ended by another error, never re-armed.
+    };
+
+    int hRing;
+    int hWakeUp;
+    bool usable;
+    bool wakeUpArmed;
+    std::atomic<bool> stopping;
+    int failure; // errno of a registration failed since the last RunOnce, 0 if none.
+
+    void *sqRing;
+    SizeType sqRingSize;
+    void *cqRing;
+    SizeType cqRingSize;
+    io_uring_sqe *sqes;
+    SizeType sqesSize;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqArray;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned toSubmit;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned cqMask;
+    io_uring_cqe *cqes;
+
+    io_uring_buf_ring *bufRing;
+    byte *buffers;
+    UInt16 bufTail;
+    std::atomic_flag bufLock = ATOMIC_FLAG_INIT; // Buffers might be released by another thread.
+    std::atomic<unsigned> heldCount; // Buffers handed to receivers and not given back yet.
+
+    ArrayList<Registration *> registrations;
+
+    bool Setup() noexcept {
+        io_uring_params params{};
+        hRing = EscapistPrivate::IoUringSetup(IoUringDatagramEngine::RingEntries, &params);
+        if (hRing < 0) {
+            return false;
+        }
+        if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+            return false;
+        }
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (cqRingSize > sqRingSize) {
+            sqRingSize = cqRingSize;
+        }
+        sqRing = ::mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        hRing, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) {
+            sqRing = nullptr;
+            return false;
+        }
+        cqRing = sqRing; // IORING_FEAT_SINGLE_MMAP
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = (io_uring_sqe *) ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                       hRing, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            sqes = nullptr;
+            return false;
+        }
+        byte *sq = (byte *) sqRing;
+        sqHead = (unsigned *) (sq + params.sq_off.head);
+        sqTail = (unsigned *) (sq + params.sq_off.tail);
+        sqArray = (unsigned *) (sq + params.sq_off.array);
+        sqMask = *(unsigned *) (sq + params.sq_off.ring_mask);
+        sqEntries = params.sq_entries;
+        byte *cq = (byte *) cqRing;
+        cqHead = (unsigned *) (cq + params.cq_off.head);
+        cqTail = (unsigned *) (cq + params.cq_off.tail);
+        cqMask = *(unsigned *) (cq + params.cq_off.ring_mask);
+        cqes = (io_uring_cqe *) (cq + params.cq_off.cqes);
+
+        // Buffers are populated up front, so the kernel never faults on the receive path.
+        buffers = (byte *) ::mmap(nullptr, IoUringDatagramEngine::BufferCount * IoUringDatagramEngine::BufferSize,
+                                  PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (buffers == MAP_FAILED) {
+            buffers = nullptr;
+            return false;
+        }
+        bufRing = (io_uring_buf_ring *) ::mmap(nullptr, IoUringDatagramEngine::BufferCount * sizeof(io_uring_buf),
+                                               PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,
+                                               -1, 0);
+        if (bufRing == MAP_FAILED) {
+            bufRing = nullptr;
+            return false;
+        }
+        io_uring_buf_reg reg{};
+        reg.ring_addr = (UInt64) bufRing;
+        reg.ring_entries = IoUringDatagramEngine::BufferCount;
+        reg.bgid = IoUringDatagramEngine::BufferGroup;
+        if (EscapistPrivate::IoUringRegister(hRing, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+            return false;
+        }
+        bufTail = 0;
+        for (unsigned index = 0; index < IoUringDatagramEngine::BufferCount; ++index) {
+            IoUringDatagramEngine::ProvideBuffer(index);
+        }
+        IoUringDatagramEngine::PublishBuffers();
+        if (!IoUringDatagramEngine::ProbeMultishot()) {
+            return false;
+        }
+        hWakeUp = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        return hWakeUp != -1;
+    }
+
+    /**
+     * Take the next completion, waiting up to timeoutMs for one. Only used before any socket is added.
+     */
+    bool PopCqe(io_uring_cqe &cqe, int timeoutMs) noexcept {
+        if (*cqHead == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            IoUringDatagramEngine::Submit(1, timeoutMs);
+        }
+        unsigned head = *cqHead;
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        cqe = cqes[head & cqMask];
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    /**
+     * Arm a multishot recvmsg on a socket of our own holding one datagram: it must complete with the datagram
+     * and IORING_CQE_F_MORE. A kernel without multishot recvmsg completes it with -EINVAL instead.
+     * The probe is cancelled afterwards, and its buffer given back.
+     */
+    bool ProbeMultishot() noexcept {
+        int hProbe = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
+        if (hProbe < 0) {
+            return false;
+        }
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(addr);
+        byte probe = 0;
+        if (::bind(hProbe, (const sockaddr *) &addr, sizeof(addr)) != 0 ||
+            ::getsockname(hProbe, (sockaddr *) &addr, &length) != 0 ||
+            ::sendto(hProbe, &probe, 1, 0, (const sockaddr *) &addr, sizeof(addr)) != 1) {
+            ::close(hProbe);
+            return false;
+        }
+        Registration registration{};
+        registration.hSock = hProbe;
+        registration.header.msg_namelen = sizeof(sockaddr_in);
+        bool supported = false;
+        bool pending = false; // The probe is still armed, it has to be cancelled.
+        io_uring_cqe cqe{};
+        if (IoUringDatagramEngine::Arm(&registration) && IoUringDatagramEngine::PopCqe(cqe, 1000)) {
+            supported = cqe.res >= 0 && (cqe.flags & IORING_CQE_F_MORE) && (cqe.flags & IORING_CQE_F_BUFFER);
+            pending = cqe.flags & IORING_CQE_F_MORE;
+            if (cqe.flags & IORING_CQE_F_BUFFER) {
+                IoUringDatagramEngine::ReturnBuffer(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            }
+        } else {
+            pending = registration.armed; // No answer in time, assume nothing.
+        }
+        if (pending) {
+            io_uring_sqe *sqe = IoUringDatagramEngine::NextSqe();
+            if (sqe) {
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->addr = (UInt64) &registration;
+                sqe->user_data = IoUringDatagramEngine::CancelData;
+                IoUringDatagramEngine::CommitSqe();
+            }
+            // Wait for the cancel and the last completion of the probe, the registration lives on the stack.
+            bool cancelled = !sqe, ended = false;
+            while ((!cancelled || !ended) && IoUringDatagramEngine::PopCqe(cqe, 1000)) {
+                if (cqe.user_data == IoUringDatagramEngine::CancelData) {
+                    cancelled = true;
+                } else {
+                    ended = ended || !(cqe.flags & IORING_CQE_F_MORE);
+                    if (cqe.flags & IORING_CQE_F_BUFFER) {
+                        IoUringDatagramEngine::ReturnBuffer(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                    }
+                }
+            }
+            supported = supported && ended;
+            if (!ended) { // Still armed on a stack address, the ring must not be used at all.
+                ::close(hRing);
+                hRing = -1;
+            }
+        }
+        ::close(hProbe);
+        return supported;
+    }
+
+    void ProvideBuffer(unsigned index) noexcept {
+        // Not bufRing->bufs: in C++ the empty member in front of that flexible array shifts it by 8 bytes.
+        io_uring_buf &buf = ((io_uring_buf *) bufRing)[bufTail & (IoUringDatagramEngine::BufferCount - 1)];
+        buf.addr = (UInt64) (buffers + index * IoUringDatagramEngine::BufferSize);
+        buf.len = IoUringDatagramEngine::BufferSize;
+        buf.bid = (UInt16) index;
+        ++bufTail;
+    }
+
+    void PublishBuffers() noexcept {
+        __atomic_store_n(&bufRing->tail, bufTail, __ATOMIC_RELEASE);
+    }
+
+    void ReturnBuffer(unsigned index) noexcept {
+        while (bufLock.test_and_set(std::memory_order_acquire));
+        IoUringDatagramEngine::ProvideBuffer(index);
+        IoUringDatagramEngine::PublishBuffers();
+        bufLock.clear(std::memory_order_release);
+    }
+
+    /**
+     * Give a buffer back to the ring once the last ByteArray borrowing it is gone.
+     * The first one back after all were held wakes the loop, a socket starved by ENOBUFS may be re-armed.
+     */
+    void Release(void *buffer) noexcept override {
+        SizeType index = ((byte *) buffer - buffers - (IoUringDatagramEngine::PayloadOffset -
+                                                         ByteArray::HeaderSize)) / IoUringDatagramEngine::BufferSize;
+        assert(index < IoUringDatagramEngine::BufferCount);
+        IoUringDatagramEngine::ReturnBuffer((unsigned) index);
+        if (heldCount.fetch_sub(1, std::memory_order_acq_rel) == IoUringDatagramEngine::BufferCount) {
+            UInt64 value = 1;
+            ::write(hWakeUp, &value, sizeof(value));
+        }
+    }
+
+    io_uring_sqe *NextSqe() noexcept {
+        unsigned tail = *sqTail;
+        if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+            IoUringDatagramEngine::Submit(0, -1);
+            if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+                return nullptr;
+            }
+        }
+        unsigned index = tail & sqMask;
+        io_uring_sqe *sqe = &sqes[index];
+        ::memset(sqe, 0, sizeof(io_uring_sqe));
+        sqArray[index] = index;
+        return sqe;
+    }
+
+    void CommitSqe() noexcept {
+        __atomic_store_n(sqTail, *sqTail + 1, __ATOMIC_RELEASE);
+        ++toSubmit;
+    }
+
+    bool Arm(Registration *registration) noexcept {
+        io_uring_sqe *sqe = IoUringDatagramEngine::NextSqe();
+        if (!sqe) {
+            return false;
+        }
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->fd = registration->hSock;
+        sqe->addr = (UInt64) &registration->header;
+        sqe->len = 1;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = IoUringDatagramEngine::BufferGroup;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->user_data = (UInt64) registration;
+        IoUringDatagramEngine::CommitSqe();
+        registration->armed = true;
+        registration->starved = false;
+        return true;
+    }
+
+    bool ArmWakeUp() noexcept {
+        io_uring_sqe *sqe = IoUringDatagramEngine::NextSqe();
+        if (!sqe) {
+            return false;
+        }
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = hWakeUp;
+        sqe->poll32_events = POLLIN;
+        sqe->user_data = IoUringDatagramEngine::WakeUpData;
+        IoUringDatagramEngine::CommitSqe();
+        wakeUpArmed = true;
+        return true;
+    }
+
+    /**
+     * Submit pending sqes, and wait for at least one completion if timeoutMs isn't 0.
+     */
+    int Submit(unsigned minComplete, int timeoutMs) noexcept {
+        unsigned flags = minComplete ? IORING_ENTER_GETEVENTS : 0;
+        io_uring_getevents_arg arg{};
+        __kernel_timespec ts{};
+        const void *argPtr = nullptr;
+        SizeType argSize = 0;
+        if (minComplete && timeoutMs >= 0) {
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+            arg.sigmask_sz = _NSIG / 8;
+            arg.ts = (UInt64) &ts;
+            flags |= IORING_ENTER_EXT_ARG;
+            argPtr = &arg;
+            argSize = sizeof(arg);
+        }
+        int result = EscapistPrivate::IoUringEnter(hRing, toSubmit, minComplete, flags, argPtr, argSize);
+        if (result >= 0) {
+            toSubmit -= (unsigned) result < toSubmit ? (unsigned) result : toSubmit;
+            return result;
+        }
+        return (errno == ETIME || errno == EINTR || errno == EAGAIN || errno == EBUSY) ? 0 : -1;
+    }
+
+    int Reap() noexcept {
+        int dispatched = 0;
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe &cqe = cqes[head & cqMask];
+            if (cqe.user_data == IoUringDatagramEngine::WakeUpData) {
+                UInt64 value;
+                while (::read(hWakeUp, &value, sizeof(value)) > 0);
+                wakeUpArmed = false;
+                continue;
+            }
+            Registration *registration = (Registration *) cqe.user_data;
+            if (!(cqe.flags & IORING_CQE_F_MORE)) { // Multishot ended, re-armed later unless by a hard error.
+                registration->armed = false;
+                registration->starved = cqe.res == -ENOBUFS;
+                if (cqe.res < 0 && cqe.res != -ENOBUFS) {
+                    registration->failed = true;
+                    failure = -cqe.res;
+                }
+            }
+            if (cqe.res < 0 || !(cqe.flags & IORING_CQE_F_BUFFER)) {
+                continue;
+            }
+            unsigned index = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+            byte *buffer = buffers + index * IoUringDatagramEngine::BufferSize;
+            const io_uring_recvmsg_out *out = (const io_uring_recvmsg_out *) buffer;
+            if (out->flags & MSG_TRUNC) { // payloadlen is the original length, only a prefix was received.
+                IoUringDatagramEngine::ReturnBuffer(index);
+                ++truncatedCount;
+                continue;
+            }
+            DatagramAddress address{};
+            EscapistPrivate::FromSocketAddress(*(const sockaddr_in *) (buffer + sizeof(io_uring_recvmsg_out)),
+                                               address);
+            SizeType size = out->payloadlen;
+            heldCount.fetch_add(1, std::memory_order_relaxed);
+            {
+                ByteArray data(buffer + IoUringDatagramEngine::PayloadOffset - ByteArray::HeaderSize, size,
+                               IoUringDatagramEngine::PayloadCapacity, this);
+                registration->receiver->OnDatagram(address, data);
+            } // Buffer goes back to the ring here unless the receiver kept a copy.
+            ++dispatched;
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        return dispatched;
+    }
+
+public:
+    IoUringDatagramEngine() noexcept
+            : hRing(-1), hWakeUp(-1), usable(false), wakeUpArmed(false), stopping(false), failure(0),
+              sqRing(nullptr), sqRingSize(0), cqRing(nullptr), cqRingSize(0), sqes(nullptr), sqesSize(0),
+              sqHead(nullptr), sqTail(nullptr), sqArray(nullptr), sqMask(0), sqEntries(0), toSubmit(0),
+              cqHead(nullptr), cqTail(nullptr), cqMask(0), cqes(nullptr),
+              bufRing(nullptr), buffers(nullptr), bufTail(0), heldCount(0) {
+        usable = IoUringDatagramEngine::Setup();
+    }
+
+    IoUringDatagramEngine(const IoUringDatagramEngine &other) = delete;
+
+    ~IoUringDatagramEngine() override {
+        if (hRing >= 0) {
+            ::close(hRing); // Cancels every pending request before the memory below goes away.
+        }
+        if (hWakeUp >= 0) {
+            ::close(hWakeUp);
+        }
+        if (sqes) {
+            ::munmap(sqes, sqesSize);
+        }
+        if (sqRing) {
+            ::munmap(sqRing, sqRingSize);
+        }
+        if (bufRing) {
+            ::munmap(bufRing, IoUringDatagramEngine::BufferCount * sizeof(io_uring_buf));
+        }
+        if (buffers) {
+            ::munmap(buffers, IoUringDatagramEngine::BufferCount * IoUringDatagramEngine::BufferSize);
+        }
+        for (SizeType index = 0; index < registrations.GetSize(); ++index) {
+            delete registrations.GetConstAt(index);
+        }
+    }
+
+    /**
+     * @return false if the kernel refused to set up the ring, the engine must not be used then.
+     */
+    bool IsUsable() const noexcept {
+        return usable;
+    }
+
+    using DatagramEngine::Add;
+
+    DatagramBackend GetBackend() const noexcept override {
+        return DatagramBackend::IoUring;
+    }
+
+    bool Add(int hSock, DatagramReceiver *receiver) override {
+        assert(usable && receiver);
+        Registration *registration = new Registration{};
+        registration->hSock = hSock;
+        registration->receiver = receiver;
+        registration->header.msg_namelen = sizeof(sockaddr_in);
+        if (!IoUringDatagramEngine::Arm(registration)) {
+            delete registration;
+            return false;
+        }
+        registrations.Append(registration);
+        return true;
+    }
+
+    /**
+     * A socket whose receive fails with anything but ENOBUFS is not armed again, the pass reaping that error
+     * returns -1 with its errno.
+     */
+    int RunOnce(int timeoutMs) override {
+        assert(usable);
+        // Re-arming a socket starved by ENOBUFS while receivers hold every buffer would fail again at once,
+        // so it waits for a buffer to come back (Release wakes the loop then).
+        bool starving = heldCount.load(std::memory_order_acquire) >= IoUringDatagramEngine::BufferCount;
+        for (SizeType index = 0; index < registrations.GetSize(); ++index) {
+            Registration *registration = registrations.GetConstAt(index);
+            if (!registration->armed && !registration->failed && !(registration->starved && starving)) {
+                IoUringDatagramEngine::Arm(registration);
+            }
+        }
+        if (!wakeUpArmed) {
+            IoUringDatagramEngine::ArmWakeUp();
+        }
+        int dispatched = IoUringDatagramEngine::Reap();
+        if (!dispatched && !failure) { // Don't wait if there are completions already.
+            if (IoUringDatagramEngine::Submit(timeoutMs ? 1 : 0, timeoutMs) < 0) {
+                return -1;
+            }
+            dispatched = IoUringDatagramEngine::Reap();
+        } else {
+            IoUringDatagramEngine::Submit(0, 0);
+        }
+        if (failure) {
+            errno = failure;
+            failure = 0;
+            return -1;
+        }
+        return dispatched;
+    }
+
+    void Run() override {
+        while (!stopping.exchange(false, std::memory_order_acq_rel)) {
+            if (IoUringDatagramEngine::RunOnce(-1) < 0) {
+                break;
+            }
+        }
+    }
+
+    void Stop() override {
+        stopping.store(true, std::memory_order_release);
+        UInt64 value = 1;
+        ::write(hWakeUp, &value, sizeof(value));
+    }
+};
+
+inline DatagramEngine *DatagramEngine::Create(DatagramBackend preferred) {
+    if (preferred == DatagramBackend::IoUring) {
+        IoUringDatagramEngine *engine = new IoUringDatagramEngine();
+        if (engine->IsUsable()) {
+            return engine;
+        }
+        delete engine;
+    }
+    return new EpollDatagramEngine();
+}
+
+#endif
+
+#endif //ESCAPIST_DATAGRAMENGINE_H
@@ -0,0 +1,194 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_EVENTLOOP_H
+#define ESCAPIST_EVENTLOOP_H
+
+#include "../General.h"
+#include "Flag.h"
+#include "TimerWheel.h"
+#include <atomic>
+
+#ifdef ESCAPIST_OS_LINUX
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+enum class EventType : UInt32 {
+    Readable = EPOLLIN,
+    Writable = EPOLLOUT,
+    Error = EPOLLERR,
+    HangUp = EPOLLHUP
+};
+
+/**
+ * Readiness callbacks of a file descriptor registered in an EventLoop.\n
+ * All descriptors are registered edge-triggered, so a handler must drain the socket until it would block,
+ * otherwise it won't be notified again.
+ */
+class EventHandler {
+public:
+    virtual ~EventHandler() = default;
+
+    virtual void OnReadable() = 0;
+
+    virtual void OnWritable() {}
+
+    virtual void OnError() {}
+};
+
+/**
+ * Reactor based on edge-triggered epoll.\n
+ * One loop owns an arbitrary number of non-blocking sockets and dispatches their readiness to handlers,
+ * so a single thread is able to serve all of them.
+ */
+class EventLoop {
+public:
+    static constexpr int MaximumEvents = 256;
+
+private:
+    int hEpoll;
+    int hWakeUp; // eventfd used by Stop() to interrupt epoll_wait from another thread.
+    std::atomic<bool> running;
+    std::atomic<bool> stopping; // Set by Stop(), so a Stop() that races ahead of Run() is not lost.
+    TimerWheel *timers;
+    epoll_event events[EventLoop::MaximumEvents];
+
+    static UInt32 ToEpollEvents(const Flag<EventType> &types) noexcept {
+        return UInt32(types.GetValue()) | UInt32(EPOLLET);
+    }
+
+    bool Control(int operation, int fd, const Flag<EventType> &types, EventHandler *handler) noexcept {
+        epoll_event event{};
+        event.events = EventLoop::ToEpollEvents(types);
+        event.data.ptr = handler;
+        return ::epoll_ctl(hEpoll, operation, fd, &event) == 0;
+    }
+
+public:
+    EventLoop() noexcept: running(false), stopping(false), timers(nullptr) {
+        hEpoll = ::epoll_create1(EPOLL_CLOEXEC);
+        assert(hEpoll != -1);
+        hWakeUp = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        assert(hWakeUp != -1);
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr; // The only registration without a handler.
+        int added = ::epoll_ctl(hEpoll, EPOLL_CTL_ADD, hWakeUp, &event);
+        assert(added == 0);
+    }
+
+    EventLoop(const EventLoop &other) = delete;
+
+    ~EventLoop() noexcept {
+        ::close(hWakeUp);
+        ::close(hEpoll);
+    }
+
+    /**
+     * Register a non-blocking descriptor.
+     * @param fd descriptor, must stay valid until it is removed.
+     * @param types readiness we are interested in.
+     * @param handler callbacks, cannot be null and must outlive the registration.
+     * @return true if epoll accepted the descriptor.
+     */
+    bool Add(int fd, const Flag<EventType> &types, EventHandler *handler) noexcept {
+        assert(handler);
+        return EventLoop::Control(EPOLL_CTL_ADD, fd, types, handler);
+    }
+
+    bool Modify(int fd, const Flag<EventType> &types, EventHandler *handler) noexcept {
+        assert(handler);
+        return EventLoop::Control(EPOLL_CTL_MOD, fd, types, handler);
+    }
+
+    bool Remove(int fd) noexcept {
+        return ::epoll_ctl(hEpoll, EPOLL_CTL_DEL, fd, nullptr) == 0;
+    }
+
+    /**
+     * Drive a timer wheel from this loop: every wait is cut short by its next deadline and due timers fire
+     * after the ready descriptors are dispatched.
+     * @param wheel must outlive the loop, or be detached by null.
+     */
+    EventLoop &SetTimers(TimerWheel *wheel) noexcept {
+        timers = wheel;
+        return *this;
+    }
+
+    /**
+     * Wait once and dispatch every ready descriptor, then fire due timers.
+     * @param timeoutMs -1 blocks until something is ready (or the next timer is due).
+     * @return count of dispatched events, -1 if epoll_wait failed.
+     */
+    int RunOnce(int timeoutMs) noexcept {
+        if (timers) {
+            int timerMs = timers->GetTimeoutMs();
+            if (timerMs >= 0 && (timeoutMs < 0 || timerMs < timeoutMs)) {
+                timeoutMs = timerMs;
+            }
+        }
+        int count = ::epoll_wait(hEpoll, events, EventLoop::MaximumEvents, timeoutMs);
+        if (count < 0) {
+            if (errno != EINTR) {
+                return -1;
+            }
+            count = 0;
+        }
+        int dispatched = 0;
+        for (int index = 0; index < count; ++index) {
+            const epoll_event &event = events[index];
+            EventHandler *handler = (EventHandler *) event.data.ptr;
+            if (!handler) { // Woken up by Stop(), just consume the counter.
+                UInt64 value;
+                while (::read(hWakeUp, &value, sizeof(value)) > 0);
+                continue;
+            }
+            if (event.events & (EPOLLERR | EPOLLHUP)) {
+                handler->OnError();
+            }
+            if (event.events & EPOLLIN) {
+                handler->OnReadable();
+            }
+            if (event.events & EPOLLOUT) {
+                handler->OnWritable();
+            }
+            ++dispatched;
+        }
+        if (timers) {
+            timers->Advance();
+        }
+        return dispatched;
+    }
+
+    /**
+     * Dispatch events until Stop() is called.
+     */
+    void Run() noexcept {
+        running.store(true, std::memory_order_release);
+        while (!stopping.exchange(false, std::memory_order_acq_rel)) {
+            if (EventLoop::RunOnce(-1) < 0) {
+                break;
+            }
+        }
+        running.store(false, std::memory_order_release);
+    }
+
+    /**
+     * Thread-safe, the current (or the next) Run() will return after finishing current dispatching.
+     */
+    void Stop() noexcept {
+        stopping.store(true, std::memory_order_release);
+        UInt64 value = 1;
+        ::write(hWakeUp, &value, sizeof(value));
+    }
+
+    bool IsRunning() const noexcept {
+        return running.load(std::memory_order_acquire);
+    }
+};
+
+#endif
+
+#endif //ESCAPIST_EVENTLOOP_H
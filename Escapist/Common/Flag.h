@@ -7,6 +7,7 @@
 
 #include "../General.h"
 #include <type_traits>
+#include <cstdarg>
 
 template<typename Enum>
 class Flag {
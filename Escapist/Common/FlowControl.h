@@ -0,0 +1,453 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_FLOWCONTROL_H
+#define ESCAPIST_FLOWCONTROL_H
+
+#include "../General.h"
+#include "ByteArray.h"
+#include "DatagramEngine.h"
+#include "Message.h"
+#include "Socket.h"
+#include "TimerWheel.h"
+
+#ifdef ESCAPIST_OS_LINUX
+#include <poll.h>
+#endif
+
+/**
+ * What a CreditSender does with a message once the credits of its receiver are used up.
+ */
+enum class CreditPolicy {
+    Block, // Wait for credits, receiving on the socket meanwhile.
+    Queue, // Keep it until credits arrive, shed once the queue is full.
+    Shed // Drop it.
+};
+
+/**
+ * Credit grant, a MsgGO message of a reserved type whose payload is [limit:8].\n
+ * The limit is cumulative: the sender may have sent that many messages in total. Grants are therefore
+ * idempotent, a lost or duplicated one is healed by the next.
+ */
+struct CreditGrant {
+    static constexpr UInt16 Type = 0xFFF0;
+
+    static ByteArray &Encode(ByteArray &message, UInt64 limit) {
+        return MessageHeader::Encode(message, CreditGrant::Type, Flag<MessageFlag>(), (const byte *) &limit,
+                                     sizeof(UInt64));
+    }
+
+    /**
+     * @return false if datagram is not a valid grant.
+     */
+    static bool Parse(const ByteArray &datagram, UInt64 &limit) noexcept {
+        MessageHeader header{};
+        if (!MessageHeader::Parse(datagram, header) || header.type != CreditGrant::Type ||
+            !header.IsValid(datagram) || header.payloadLength != sizeof(UInt64) || !header.IsChecksumValid(datagram)) {
+            return false;
+        }
+        ::memcpy(&limit, datagram.GetConstData() + MessageHeader::Size, sizeof(UInt64));
+        return true;
+    }
+};
+
+/**
+ * Report of a sender out of credits, a MsgGO message of a reserved type whose payload is [sent:8].\n
+ * The count is cumulative: messages the sender handed to the kernel in total, so the receiver learns how many
+ * never arrived and grants their room again. Like grants, reports are idempotent.
+ */
+struct CreditReport {
+    static constexpr UInt16 Type = 0xFFF1;
+
+    static ByteArray &Encode(ByteArray &message, UInt64 sent) {
+        return MessageHeader::Encode(message, CreditReport::Type, Flag<MessageFlag>(), (const byte *) &sent,
+                                     sizeof(UInt64));
+    }
+
+    /**
+     * @return false if datagram is not a valid report.
+     */
+    static bool Parse(const ByteArray &datagram, UInt64 &sent) noexcept {
+        MessageHeader header{};
+        if (!MessageHeader::Parse(datagram, header) || header.type != CreditReport::Type ||
+            !header.IsValid(datagram) || header.payloadLength != sizeof(UInt64) || !header.IsChecksumValid(datagram)) {
+            return false;
+        }
+        ::memcpy(&sent, datagram.GetConstData() + MessageHeader::Size, sizeof(UInt64));
+        return true;
+    }
+};
+
+/**
+ * Receiving end of a flow-controlled peer: it grants window messages beyond what the application consumed,
+ * plus every message the sender reported as sent that never arrived, so lost datagrams don't eat credits.
+ * A new grant goes out once half the window is consumed, on every report, and again every refreshUs while
+ * credits are held back, in case a grant was lost.\n
+ * A message still in flight when its sender reports is granted as lost as well, which lets the sender exceed
+ * the window by what was in flight at most.
+ */
+class CreditReceiver {
+private:
+    DatagramServer &server;
+    DatagramAddress peer;
+    UInt64 window;
+    UInt64 refreshUs;
+    UInt64 consumed = 0;
+    UInt64 received = 0;
+    UInt64 reported = 0; // Highest count of sent messages reported by the peer.
+    UInt64 advertised = 0;
+    UInt64 advertisedAt = 0;
+    ByteArray grant; // Reused by every Advertise.
+
+    UInt64 GetLimit() const noexcept {
+        return consumed + window + (reported > received ? reported - received : 0);
+    }
+
+public:
+    /**
+     * @param server socket to grant by, must outlive this.
+     * @param window messages the receiver can hold without dropping, e.g. what fits into its socket buffer.
+     */
+    CreditReceiver(DatagramServer &server, const DatagramAddress &peer, UInt64 window, UInt64 refreshUs = 100000)
+            : server(server), peer(peer), window(window), refreshUs(refreshUs) {
+        assert(window);
+    }
+
+    /**
+     * Send the current limit, e.g. once at start.
+     * @return false if the kernel refused the grant.
+     */
+    bool Advertise(UInt64 now = TimerWheel::Now()) {
+        UInt64 limit = CreditReceiver::GetLimit();
+        advertised = limit > advertised ? limit : advertised; // Limits never shrink, see the class.
+        advertisedAt = now;
+        CreditGrant::Encode(grant, advertised);
+        return server.SendBatch(&grant, &peer, 1) == 1;
+    }
+
+    /**
+     * Report messages processed by the application, their room is granted again.
+     */
+    bool OnConsumed(UInt64 count = 1, UInt64 now = TimerWheel::Now()) {
+        consumed += count;
+        if (CreditReceiver::GetLimit() >= advertised + (window + 1) / 2) {
+            return CreditReceiver::Advertise(now);
+        }
+        return true;
+    }
+
+    /**
+     * Take a report of the peer, or count its datagram as received.
+     * @return false if datagram is not a report of the peer, the owner handles it then.
+     */
+    bool OnDatagram(const DatagramAddress &address, const ByteArray &datagram, UInt64 now = TimerWheel::Now()) {
+        if (address.port != peer.port || ::memcmp(address.ipAddress, peer.ipAddress, 4)) {
+            return false;
+        }
+        UInt64 sent;
+        if (!CreditReport::Parse(datagram, sent)) {
+            ++received;
+            return false;
+        }
+        reported = sent > reported ? sent : reported;
+        CreditReceiver::Advertise(now); // The sender is stalled, answer even if the limit stayed.
+        return true;
+    }
+
+    /**
+     * Repeat the last grant if refreshUs has passed, call it from a timer or after each EventLoop::RunOnce.
+     */
+    bool Poll(UInt64 now = TimerWheel::Now()) {
+        return now - advertisedAt >= refreshUs ? CreditReceiver::Advertise(now) : true;
+    }
+
+    UInt64 GetConsumedCount() const noexcept {
+        return consumed;
+    }
+
+    /**
+     * @return messages the peer reported as sent that never arrived (or were still in flight then).
+     */
+    UInt64 GetLostCount() const noexcept {
+        return reported > received ? reported - received : 0;
+    }
+};
+
+struct CreditMetrics {
+    UInt64 sentCount; // Messages handed to the kernel.
+    UInt64 availableCredits;
+    UInt64 queueDepth;
+    UInt64 maximumQueueDepth;
+    UInt64 shedCount; // Messages dropped for want of credits.
+    UInt64 stallCount; // Times the credits ran out while there was something to send.
+    UInt64 stallUs; // Total time spent waiting for credits, the current stall included.
+};
+
+/**
+ * Sending end of a flow-controlled peer: a message leaves only while the receiver granted room for it, so an
+ * overloaded receiver slows its senders down instead of its kernel dropping datagrams unseen.
+ * Out of credits, a message is blocked on, queued or shed by the CreditPolicy, and the sender reports how many
+ * it sent (see CreditReport), again every refreshUs until credits arrive.\n
+ * Grants arrive on the same socket, the owner hands every datagram from the peer to OnDatagram
+ * (Block waits for them by itself, see SetBlockingSource). Not thread-safe.
+ */
+class CreditSender {
+private:
+    DatagramServer &server;
+    DatagramAddress peer;
+    CreditPolicy policy;
+    ByteArray *queue; // Ring of queueCapacity messages.
+    SizeType queueCapacity;
+    SizeType queueHead = 0;
+    SizeType queueCount = 0;
+    UInt64 limit;
+    UInt64 sentCount = 0;
+    UInt64 maximumQueueDepth = 0;
+    UInt64 shedCount = 0;
+    UInt64 stallCount = 0;
+    UInt64 stallUs = 0;
+    UInt64 stallStart = 0; // 0 while not stalled.
+    UInt64 refreshUs;
+    UInt64 reportedAt = 0;
+    UInt64 reportedCount = 0; // sentCount of the last report.
+    ByteArray report; // Reused by every Report.
+    BufferPool *blockingPool = nullptr;
+    DatagramReceiver *blockingOther = nullptr;
+    int blockingTimeoutMs = -1;
+
+    bool Report(UInt64 now) {
+        reportedAt = now;
+        reportedCount = sentCount;
+        CreditReport::Encode(report, sentCount);
+        return server.SendBatch(&report, &peer, 1) == 1;
+    }
+
+    /**
+     * Credits ran out with something to send. Reports at once if more was sent since the last report, otherwise
+     * Poll repeats it.
+     */
+    void Stall(UInt64 now) {
+        if (!stallStart) {
+            stallStart = now ? now : 1;
+            ++stallCount;
+        }
+        if (sentCount != reportedCount) {
+            CreditSender::Report(now);
+        }
+    }
+
+    void Unstall(UInt64 now) noexcept {
+        if (stallStart) {
+            stallUs += now > stallStart ? now - stallStart : 0;
+            stallStart = 0;
+        }
+    }
+
+    bool Enqueue(const ByteArray &message, UInt64 now) {
+        if (queueCount == queueCapacity) {
+            ++shedCount;
+            return false;
+        }
+        queue[(queueHead + queueCount) % queueCapacity] = message; // Shares the buffer.
+        ++queueCount;
+        maximumQueueDepth = queueCount > maximumQueueDepth ? queueCount : maximumQueueDepth;
+        if (sentCount >= limit) { // Otherwise only the socket is full, Flush sends it.
+            CreditSender::Stall(now);
+        }
+        return true;
+    }
+
+    /**
+     * Send queued messages while credits last, by SendBatch over the contiguous parts of the ring.
+     */
+    void Drain(UInt64 now) {
+        while (queueCount && sentCount < limit) {
+            SizeType count = queueCount;
+            if (count > queueCapacity - queueHead) {
+                count = queueCapacity - queueHead;
+            }
+            if (count > limit - sentCount) {
+                count = SizeType(limit - sentCount);
+            }
+            if (count > SizeType(DatagramServer::MaximumBatchSize)) {
+                count = DatagramServer::MaximumBatchSize;
+            }
+            DatagramAddress peers[DatagramServer::MaximumBatchSize];
+            for (SizeType index = 0; index < count; ++index) {
+                peers[index] = peer;
+            }
+            int sent = server.SendBatch(queue + queueHead, peers, int(count));
+            if (sent <= 0) {
+                return; // The socket is full, the rest waits for the next grant or Flush.
+            }
+            for (int index = 0; index < sent; ++index) {
+                queue[queueHead + index].Empty();
+            }
+            queueHead = (queueHead + SizeType(sent)) % queueCapacity;
+            queueCount -= SizeType(sent);
+            sentCount += UInt64(sent);
+        }
+        if (!queueCount && (policy != CreditPolicy::Shed || sentCount < limit)) { // Shed stalls until credits arrive.
+            CreditSender::Unstall(now);
+        } else if (queueCount && sentCount >= limit) {
+            CreditSender::Stall(now);
+        }
+    }
+
+public:
+    /**
+     * @param server socket to send by, must outlive this.
+     * @param queueCapacity messages held back by Queue and Block at most.
+     * @param initialCredits messages that may go before the first grant arrives.
+     * @param refreshUs interval of reports while out of credits.
+     */
+    CreditSender(DatagramServer &server, const DatagramAddress &peer, CreditPolicy policy,
+                 SizeType queueCapacity = 1024, UInt64 initialCredits = 0, UInt64 refreshUs = 100000)
+            : server(server), peer(peer), policy(policy), queueCapacity(queueCapacity), limit(initialCredits),
+              refreshUs(refreshUs) {
+        assert(queueCapacity);
+        queue = new ByteArray[queueCapacity];
+    }
+
+    CreditSender(const CreditSender &other) = delete;
+
+    ~CreditSender() {
+        delete[] queue;
+    }
+
+    /**
+     * Where Block receives grants from while waiting: datagrams are read from the socket into pool, grants of the
+     * peer are taken, everything else goes to other.
+     * @param timeoutMs longest wait of one Send, -1 waits as long as it takes.
+     */
+    CreditSender &SetBlockingSource(BufferPool *pool, DatagramReceiver *other, int timeoutMs = -1) noexcept {
+        blockingPool = pool;
+        blockingOther = other;
+        blockingTimeoutMs = timeoutMs;
+        return *this;
+    }
+
+    /**
+     * Send message if a credit is left, otherwise apply the policy. Messages queued before go first.
+     * @return false if message was shed (or Block timed out with it still queued, it is sent later then), or
+     * the kernel refused it.
+     */
+    bool Send(const ByteArray &message, UInt64 now = TimerWheel::Now()) {
+        if (queueCount && sentCount < limit) {
+            CreditSender::Drain(now);
+        }
+        if (!queueCount && sentCount < limit) {
+            bool sent = server.SendBatch(&message, &peer, 1) == 1;
+            sentCount += sent;
+            return sent;
+        }
+        switch (policy) {
+            case CreditPolicy::Shed:
+                ++shedCount;
+                CreditSender::Stall(now);
+                return false;
+            case CreditPolicy::Queue:
+                return CreditSender::Enqueue(message, now);
+            case CreditPolicy::Block:
+            default:
+                if (!CreditSender::Enqueue(message, now)) {
+                    return false;
+                }
+#ifdef ESCAPIST_OS_LINUX
+                return CreditSender::Wait(blockingTimeoutMs);
+#else
+                return false;
+#endif
+        }
+    }
+
+    /**
+     * Take a grant.
+     * @return false if datagram is not a grant of the peer, the owner handles it then.
+     */
+    bool OnDatagram(const DatagramAddress &address, const ByteArray &datagram, UInt64 now = TimerWheel::Now()) {
+        UInt64 granted;
+        if (address.port != peer.port || ::memcmp(address.ipAddress, peer.ipAddress, 4) ||
+            !CreditGrant::Parse(datagram, granted)) {
+            return false;
+        }
+        if (granted > limit) {
+            limit = granted;
+            CreditSender::Drain(now);
+        }
+        if (sentCount < limit && policy == CreditPolicy::Shed) {
+            CreditSender::Unstall(now);
+        }
+        return true;
+    }
+
+    /**
+     * Send queued messages the credits allow, e.g. after the socket was full.
+     */
+    void Flush(UInt64 now = TimerWheel::Now()) {
+        CreditSender::Drain(now);
+    }
+
+    /**
+     * Repeat the report if still out of credits after refreshUs, call it from a timer or after each
+     * EventLoop::RunOnce. Block does so by itself while waiting.
+     * @return false if the kernel refused the report.
+     */
+    bool Poll(UInt64 now = TimerWheel::Now()) {
+        return stallStart && now - reportedAt >= refreshUs ? CreditSender::Report(now) : true;
+    }
+
+#ifdef ESCAPIST_OS_LINUX
+
+    /**
+     * Receive on the socket and send what the credits allow until the queue is empty, see SetBlockingSource.
+     * @return false on timeout, with messages still queued.
+     */
+    bool Wait(int timeoutMs) {
+        assert(blockingPool);
+        UInt64 deadline = TimerWheel::Now() + UInt64(timeoutMs) * 1000;
+        DatagramAddress address{};
+        ByteArray datagram;
+        while (queueCount) {
+            CreditSender::Drain(TimerWheel::Now()); // Credits may be left with the socket full last time.
+            while (server.TryReceive(*blockingPool, address, datagram)) {
+                if (!CreditSender::OnDatagram(address, datagram) && blockingOther) {
+                    blockingOther->OnDatagram(address, datagram);
+                }
+                datagram.Empty();
+            }
+            if (!queueCount) {
+                break;
+            }
+            UInt64 now = TimerWheel::Now();
+            CreditSender::Poll(now);
+            UInt64 waitUs = refreshUs; // Wake up for the next report at least.
+            if (timeoutMs >= 0) {
+                if (now >= deadline) {
+                    return false;
+                }
+                waitUs = deadline - now < waitUs ? deadline - now : waitUs;
+            }
+            int waitMs = int((waitUs + 999) / 1000);
+            // With credits left only the socket holds the queue back, wait for room in it too.
+            pollfd descriptor{server.GetHandle(), short(sentCount < limit ? POLLIN | POLLOUT : POLLIN), 0};
+            ::poll(&descriptor, 1, waitMs);
+        }
+        return true;
+    }
+
+#endif
+
+    UInt64 GetAvailableCredits() const noexcept {
+        return limit > sentCount ? limit - sentCount : 0;
+    }
+
+    CreditMetrics GetMetrics(UInt64 now = TimerWheel::Now()) const noexcept {
+        UInt64 stalled = stallStart && now > stallStart ? now - stallStart : 0;
+        return CreditMetrics{sentCount, CreditSender::GetAvailableCredits(), queueCount, maximumQueueDepth,
+                             shedCount, stallCount, stallUs + stalled};
+    }
+};
+
+#endif //ESCAPIST_FLOWCONTROL_H
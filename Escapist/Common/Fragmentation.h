@@ -0,0 +1,313 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_FRAGMENTATION_H
+#define ESCAPIST_FRAGMENTATION_H
+
+#include "../General.h"
+#include "ByteArray.h"
+#include "Socket.h"
+
+/**
+ * Header in front of every fragment, fields are in host byte order like the rest of ByteArray.
+ */
+struct FragmentHeader {
+    UInt32 messageId;
+    UInt32 totalSize; // Size of the whole message.
+    UInt32 offset; // Where the payload of this fragment goes in the message.
+    UInt16 index;
+    UInt16 count;
+
+    static constexpr SizeType Size = 3 * sizeof(UInt32) + 2 * sizeof(UInt16);
+};
+
+/**
+ * Splits a message larger than the path MTU into numbered fragments, see MessageReassembler for the other side.
+ */
+class MessageFragmenter {
+public:
+    static constexpr SizeType DefaultMtu = 1472; // Ethernet MTU minus IPv4 and UDP headers.
+    static constexpr SizeType MaximumFragmentCount = 65535;
+
+    /**
+     * @param mtu largest datagram payload, header included.
+     * @return count of fragments needed for a message of size bytes, 0 if it needs more than MaximumFragmentCount.
+     */
+    static SizeType GetFragmentCount(SizeType size, SizeType mtu = MessageFragmenter::DefaultMtu) noexcept {
+        assert(mtu > FragmentHeader::Size);
+        SizeType stride = mtu - FragmentHeader::Size;
+        SizeType count = size ? (size + stride - 1) / stride : 1;
+        return count > MessageFragmenter::MaximumFragmentCount ? 0 : count;
+    }
+
+    /**
+     * Write every fragment of message into its slot, each is a header followed by at most mtu bytes of the message.
+     * Reusing the same slots keeps their capacity, and they can be handed to SendBatch as they are.
+     * @param fragments preallocated slots, at least GetFragmentCount(message.GetSize(), mtu).
+     * @param count count of slots.
+     * @return count of fragments written, 0 if the message does not fit into count slots.
+     */
+    static int Split(const ByteArray &message, UInt32 messageId, ByteArray *fragments, int count,
+                     SizeType mtu = MessageFragmenter::DefaultMtu) {
+        assert(fragments && count >= 0);
+        SizeType size = message.GetSize();
+        SizeType needed = MessageFragmenter::GetFragmentCount(size, mtu);
+        if (!needed || needed > SizeType(count) || size > 0xFFFFFFFFu) {
+            return 0;
+        }
+        SizeType stride = mtu - FragmentHeader::Size;
+        for (SizeType index = 0; index < needed; ++index) {
+            SizeType offset = index * stride;
+            SizeType length = size - offset < stride ? size - offset : stride;
+            ByteArray &each = fragments[index];
+            each.Empty().EnsureCapacity(FragmentHeader::Size + length);
+            each.WriteSimpleValue<UInt32>(messageId).WriteSimpleValue<UInt32>(UInt32(size))
+                    .WriteSimpleValue<UInt32>(UInt32(offset)).WriteSimpleValue<UInt16>(UInt16(index))
+                    .WriteSimpleValue<UInt16>(UInt16(needed));
+            each.Append(message.GetConstData() + offset, length);
+            each.ResetMark();
+        }
+        return int(needed);
+    }
+};
+
+/**
+ * Puts fragments of MessageFragmenter back together, per peer and message id.\n
+ * The first fragment to arrive (in any order) allocates the whole message once and every fragment is copied
+ * straight to its offset, so reassembly is linear in the message size. A bitmap drops duplicates.\n
+ * Partial messages are held in a fixed number of slots and their sizes together never exceed the memory
+ * budget: a partial message older than the timeout is dropped, and when a new one doesn't fit, the oldest
+ * are evicted first. All times are microseconds of a steady clock, e.g. ReliableChannel::Now().
+ */
+class MessageReassembler {
+public:
+    static constexpr int DefaultSlotCount = 64;
+    static constexpr SizeType DefaultBudget = 16 * 1024 * 1024;
+    static constexpr UInt64 DefaultTimeout = 5000000;
+
+private:
+    struct Partial {
+        DatagramAddress peer;
+        UInt32 messageId = 0;
+        UInt16 count = 0;
+        UInt16 receivedCount = 0;
+        UInt32 stride = 0; // Payload bytes of every fragment but the last.
+        UInt64 startedAt = 0;
+        SizeType charge = 0; // Bytes counted against the budget, 0 if the slot is free.
+        ByteArray message;
+        byte *received = nullptr; // One bit per fragment.
+    };
+
+    Partial *partials;
+    int slotCount;
+    SizeType budget;
+    SizeType used = 0;
+    UInt64 timeout;
+    UInt64 expiredCount = 0;
+    UInt64 evictedCount = 0;
+
+    static bool IsSamePeer(const DatagramAddress &left, const DatagramAddress &right) noexcept {
+        return left.port == right.port && !::memcmp(left.ipAddress, right.ipAddress, 4);
+    }
+
+    void Release(Partial &each) noexcept {
+        used -= each.charge;
+        each.charge = 0;
+        each.message = ByteArray();
+        ::free((void *) each.received);
+        each.received = nullptr;
+    }
+
+    /**
+     * Check that a fragment takes exactly its place in the split, so fragments tile the message without
+     * overlaps or holes.
+     * @param stride receives the payload size of every fragment but the last, as implied by this one.
+     */
+    static bool IsWellPlaced(const FragmentHeader &header, SizeType length, UInt32 &stride) noexcept {
+        if (header.index + 1 == header.count) {
+            if (SizeType(header.offset) + length != header.totalSize || !length || header.offset % header.index) {
+                return false;
+            }
+            stride = header.offset / header.index;
+            if (!stride || length > stride) {
+                return false;
+            }
+        } else {
+            stride = UInt32(length);
+            if (!length || header.offset != UInt64(header.index) * length) {
+                return false;
+            }
+        }
+        // The count of fragments must be the one Split derives from the stride.
+        return (UInt64(header.totalSize) + stride - 1) / stride == header.count;
+    }
+
+    /**
+     * Find a free slot for size more bytes, evicting the oldest partial messages if needed.
+     * @return null if size alone exceeds the budget.
+     */
+    Partial *Reserve(SizeType size, UInt64 now) noexcept {
+        if (size > budget) {
+            return nullptr;
+        }
+        MessageReassembler::Expire(now);
+        for (;;) {
+            Partial *free = nullptr;
+            Partial *oldest = nullptr;
+            for (int index = 0; index < slotCount; ++index) {
+                Partial &each = partials[index];
+                if (!each.charge) {
+                    free = free ? free : &each;
+                } else if (!oldest || each.startedAt < oldest->startedAt) {
+                    oldest = &each;
+                }
+            }
+            if (free && used + size <= budget) {
+                return free;
+            }
+            MessageReassembler::Release(*oldest);
+            ++evictedCount;
+        }
+    }
+
+public:
+    /**
+     * @param budget bytes of partial messages held at most, a larger message is dropped.
+     * @param timeout microseconds a partial message may wait for its missing fragments.
+     * @param slotCount partial messages held at most.
+     */
+    explicit MessageReassembler(SizeType budget = MessageReassembler::DefaultBudget,
+                                UInt64 timeout = MessageReassembler::DefaultTimeout,
+                                int slotCount = MessageReassembler::DefaultSlotCount)
+            : slotCount(slotCount), budget(budget), timeout(timeout) {
+        assert(slotCount > 0);
+        partials = new Partial[slotCount];
+    }
+
+    MessageReassembler(const MessageReassembler &other) = delete;
+
+    ~MessageReassembler() {
+        for (int index = 0; index < slotCount; ++index) {
+            ::free((void *) partials[index].received);
+        }
+        delete[] partials;
+    }
+
+    /**
+     * Feed one datagram of peer.
+     * @param message receives the whole message when this fragment completes it, laid out like a fragment of
+     * count 1: a FragmentHeader, then the message, with the mark at its first byte so Read* starts there.
+     * A message of one fragment is moved out of datagram without copying.
+     * @return true if message was completed, false if more fragments are missing or the datagram was malformed.
+     */
+    bool OnFragment(const DatagramAddress &peer, ByteArray &datagram, UInt64 now, ByteArray &message) {
+        SizeType size = datagram.GetSize();
+        if (size < FragmentHeader::Size) {
+            return false;
+        }
+        datagram.ResetMark();
+        FragmentHeader header{};
+        header.messageId = datagram.ReadSimpleValue<UInt32>();
+        header.totalSize = datagram.ReadSimpleValue<UInt32>();
+        header.offset = datagram.ReadSimpleValue<UInt32>();
+        header.index = datagram.ReadSimpleValue<UInt16>();
+        header.count = datagram.ReadSimpleValue<UInt16>();
+        SizeType length = size - FragmentHeader::Size;
+        if (header.index >= header.count || SizeType(header.offset) + length > header.totalSize) {
+            return false;
+        }
+        if (header.count == 1) {
+            if (length != header.totalSize || header.offset) {
+                return false;
+            }
+            message = (ByteArray &&) datagram; // The mark stays behind the header.
+            return true;
+        }
+        UInt32 stride = 0;
+        if (!MessageReassembler::IsWellPlaced(header, length, stride)) {
+            return false;
+        }
+
+        Partial *partial = nullptr;
+        for (int index = 0; index < slotCount; ++index) {
+            Partial &each = partials[index];
+            if (each.charge && each.messageId == header.messageId && MessageReassembler::IsSamePeer(each.peer, peer)) {
+                partial = &each;
+                break;
+            }
+        }
+        if (!partial) {
+            SizeType bitmapSize = (header.count + 7) / 8;
+            SizeType charge = FragmentHeader::Size + header.totalSize + bitmapSize;
+            partial = MessageReassembler::Reserve(charge, now);
+            if (!partial) {
+                return false;
+            }
+            partial->peer = peer;
+            partial->messageId = header.messageId;
+            partial->count = header.count;
+            partial->receivedCount = 0;
+            partial->stride = stride;
+            partial->startedAt = now;
+            partial->charge = charge;
+            SizeType total = FragmentHeader::Size + header.totalSize;
+            partial->message = ByteArray(total, total);
+            UInt32 fields[] = {header.messageId, header.totalSize, 0};
+            UInt16 position[] = {0, 1};
+            ::memcpy(partial->message.GetData(), fields, sizeof(fields));
+            ::memcpy(partial->message.GetData() + sizeof(fields), position, sizeof(position));
+            partial->received = (byte *) ::calloc(bitmapSize, 1);
+            assert(partial->received);
+            used += partial->charge;
+        } else if (partial->count != header.count || partial->stride != stride ||
+                   partial->message.GetSize() != FragmentHeader::Size + header.totalSize) {
+            return false; // Disagrees with the fragments seen so far.
+        }
+
+        byte bit = byte(1 << (header.index & 7));
+        if (partial->received[header.index >> 3] & bit) {
+            return false;
+        }
+        partial->received[header.index >> 3] |= bit;
+        ::memcpy(partial->message.GetData() + FragmentHeader::Size + header.offset,
+                 datagram.GetConstData() + FragmentHeader::Size, length);
+        if (++partial->receivedCount < partial->count) {
+            return false;
+        }
+        message = (ByteArray &&) partial->message;
+        message.ResetMark().IgnoreBytes(SizeType(FragmentHeader::Size)); // IgnoreBytes binds a reference.
+        MessageReassembler::Release(*partial);
+        return true;
+    }
+
+    /**
+     * Drop partial messages older than the timeout, call it periodically when fragments stop arriving.
+     */
+    void Expire(UInt64 now) noexcept {
+        for (int index = 0; index < slotCount; ++index) {
+            Partial &each = partials[index];
+            if (each.charge && now - each.startedAt >= timeout) {
+                MessageReassembler::Release(each);
+                ++expiredCount;
+            }
+        }
+    }
+
+    /**
+     * @return bytes held by partial messages, never above the budget.
+     */
+    SizeType GetUsedBytes() const noexcept {
+        return used;
+    }
+
+    UInt64 GetExpiredCount() const noexcept {
+        return expiredCount;
+    }
+
+    UInt64 GetEvictedCount() const noexcept {
+        return evictedCount;
+    }
+};
+
+#endif //ESCAPIST_FRAGMENTATION_H
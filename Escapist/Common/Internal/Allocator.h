@@ -0,0 +1,75 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_ALLOCATOR_INTERNAL_H
+#define ESCAPIST_ALLOCATOR_INTERNAL_H
+
+#include "../../General.h"
+#include "BufferOwner.h"
+
+namespace EscapistPrivate {
+    /**
+     * Source of container buffers other than ::malloc, installed for the calling thread by AllocatorScope.\n
+     * A buffer remembers its allocator as its BufferOwner, so it is resized and released there whatever
+     * allocator is installed by then.
+     */
+    class Allocator : public BufferOwner {
+    public:
+        /**
+         * @return size bytes aligned for any type, or nullptr to let the container take them from the heap.
+         */
+        virtual void *Allocate(SizeType size) noexcept = 0;
+
+        /**
+         * @return the allocator installed for the calling thread, nullptr for the heap.
+         */
+        static Allocator *&Current() noexcept {
+            static thread_local Allocator *current = nullptr;
+            return current;
+        }
+    };
+
+    /**
+     * Allocate a container buffer from the allocator of the calling thread, or the heap.
+     * @param owner set to where the buffer goes back, nullptr for the heap.
+     */
+    inline void *AllocateBuffer(SizeType size, BufferOwner *&owner) noexcept {
+        Allocator *allocator = Allocator::Current();
+        void *buffer = allocator ? allocator->Allocate(size) : nullptr;
+        owner = buffer ? allocator : nullptr;
+        return buffer ? buffer : ::malloc(size);
+    }
+
+    /**
+     * Resize a container buffer where it comes from, or move it to a new one if its owner can't.
+     * @param keep leading bytes to keep if it moves.
+     * @param owner updated if the buffer moved to another owner.
+     */
+    inline void *ReallocateBuffer(void *buffer, SizeType keep, SizeType size, BufferOwner *&owner) noexcept {
+        if (!owner) {
+            return ::realloc(buffer, size);
+        }
+        void *resized = owner->Reallocate(buffer, size);
+        if (resized) {
+            return resized;
+        }
+        BufferOwner *oldOwner = owner;
+        resized = EscapistPrivate::AllocateBuffer(size, owner);
+        if (resized) {
+            ::memcpy(resized, buffer, keep < size ? keep : size);
+            oldOwner->Release(buffer);
+        }
+        return resized;
+    }
+
+    inline void ReleaseBuffer(void *buffer, BufferOwner *owner) noexcept {
+        if (owner) {
+            owner->Release(buffer);
+        } else {
+            ::free(buffer);
+        }
+    }
+}
+
+#endif //ESCAPIST_ALLOCATOR_INTERNAL_H
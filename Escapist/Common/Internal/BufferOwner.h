@@ -0,0 +1,37 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_BUFFEROWNER_H
+#define ESCAPIST_BUFFEROWNER_H
+
+#include "../../General.h"
+
+namespace EscapistPrivate {
+    /**
+     * Owner of memory that an ArrayList borrows instead of allocating from heap.\n
+     * The buffer keeps the same layout as a heap one: the first pointer-sized bytes are reserved for the
+     * reference count pointer, data starts right behind them.
+     */
+    class BufferOwner {
+    public:
+        virtual ~BufferOwner() = default;
+
+        /**
+         * Called once when the last ArrayList using the buffer leaves it.
+         * @param buffer the head of buffer, the same address given when adopted.
+         */
+        virtual void Release(void *buffer) noexcept = 0;
+
+        /**
+         * Resize a buffer of this owner, keeping its content.
+         * @return the buffer, which may have moved, or nullptr if this owner can't (e.g. fixed-size slots), the
+         * container moves to a new buffer then.
+         */
+        virtual void *Reallocate(void *, SizeType) noexcept {
+            return nullptr;
+        }
+    };
+}
+
+#endif //ESCAPIST_BUFFEROWNER_H
@@ -89,9 +89,14 @@ namespace EscapistPrivate {
                 new(dest)T(val);
         }
 
-        static void Destroy(T *dest) noexcept {}
+        static void Destroy(T *dest) noexcept {
+            dest->~T();
+        }
 
-        static void Destroy(T *dest, SizeType count) noexcept {}
+        static void Destroy(T *dest, SizeType count) noexcept {
+            for (; count > 0; --count, ++dest)
+                dest->~T();
+        }
     };
 
     enum class TypeTraitPattern : short {
@@ -129,7 +134,7 @@ namespace EscapistPrivate {
     template<typename T>
     struct TypeTraitPatternSelector<T,
             typename std::enable_if<(TypeTraitPatternDefiner<T>::Pattern == TypeTraitPattern::NonDefault)>::type> {
-        using TypeTrait = TypeTrait<T>;
+        using TypeTrait = ::TypeTrait<T>;
     };
 }
 
@@ -0,0 +1,176 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_LATENCY_H
+#define ESCAPIST_LATENCY_H
+
+#include "../General.h"
+#include "Socket.h"
+
+/**
+ * Log-linear histogram of nanoseconds: exact below 16, then 8 buckets per power of two (at most 12.5% error),
+ * so recording is a few instructions and the whole range of UInt64 fits into BucketCount counters.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int SubBits = 3;
+    static constexpr int LinearCount = 16;
+    static constexpr int BucketCount = LatencyHistogram::LinearCount + (64 - 4) * (1 << LatencyHistogram::SubBits);
+
+private:
+    UInt64 buckets[LatencyHistogram::BucketCount] = {};
+    UInt64 count = 0;
+    UInt64 sum = 0;
+    UInt64 minimum = ~UInt64(0);
+    UInt64 maximum = 0;
+
+    static int IndexOf(UInt64 value) noexcept {
+        if (value < UInt64(LatencyHistogram::LinearCount)) {
+            return int(value);
+        }
+        int exponent = 63 - __builtin_clzll(value);
+        int sub = int(value >> (exponent - LatencyHistogram::SubBits)) & ((1 << LatencyHistogram::SubBits) - 1);
+        return LatencyHistogram::LinearCount + ((exponent - 4) << LatencyHistogram::SubBits) + sub;
+    }
+
+    /**
+     * @return the largest value of bucket index.
+     */
+    static UInt64 UpperBoundOf(int index) noexcept {
+        if (index < LatencyHistogram::LinearCount) {
+            return UInt64(index);
+        }
+        int exponent = ((index - LatencyHistogram::LinearCount) >> LatencyHistogram::SubBits) + 4;
+        UInt64 sub = UInt64(index - LatencyHistogram::LinearCount) & ((1 << LatencyHistogram::SubBits) - 1);
+        UInt64 width = UInt64(1) << (exponent - LatencyHistogram::SubBits);
+        return (UInt64(1) << exponent) + (sub + 1) * width - 1;
+    }
+
+public:
+    void Record(UInt64 nanoseconds) noexcept {
+        ++buckets[LatencyHistogram::IndexOf(nanoseconds)];
+        ++count;
+        sum += nanoseconds;
+        minimum = nanoseconds < minimum ? nanoseconds : minimum;
+        maximum = nanoseconds > maximum ? nanoseconds : maximum;
+    }
+
+    /**
+     * Add every value of other, so each thread can record into its own histogram and merge at the end.
+     */
+    LatencyHistogram &Merge(const LatencyHistogram &other) noexcept {
+        for (int index = 0; index < LatencyHistogram::BucketCount; ++index) {
+            buckets[index] += other.buckets[index];
+        }
+        count += other.count;
+        sum += other.sum;
+        minimum = other.minimum < minimum ? other.minimum : minimum;
+        maximum = other.maximum > maximum ? other.maximum : maximum;
+        return *this;
+    }
+
+    void Reset() noexcept {
+        new(this) LatencyHistogram();
+    }
+
+    UInt64 GetCount() const noexcept {
+        return count;
+    }
+
+    UInt64 GetMean() const noexcept {
+        return count ? sum / count : 0;
+    }
+
+    UInt64 GetMinimum() const noexcept {
+        return count ? minimum : 0;
+    }
+
+    UInt64 GetMaximum() const noexcept {
+        return maximum;
+    }
+
+    /**
+     * @param percentile in [0, 100].
+     * @return upper bound of the bucket holding the percentile, never above GetMaximum().
+     */
+    UInt64 GetPercentile(double percentile) const noexcept {
+        if (!count) {
+            return 0;
+        }
+        UInt64 rank = UInt64(percentile / 100 * double(count) + 0.5);
+        rank = rank < 1 ? 1 : (rank > count ? count : rank);
+        UInt64 seen = 0;
+        for (int index = 0; index < LatencyHistogram::BucketCount; ++index) {
+            seen += buckets[index];
+            if (seen >= rank) {
+                UInt64 bound = LatencyHistogram::UpperBoundOf(index);
+                return bound < maximum ? bound : maximum;
+            }
+        }
+        return maximum;
+    }
+};
+
+enum class LatencyStage {
+    WireToKernel, // NIC (or sender) to the kernel receive timestamp.
+    KernelToUser, // Kernel receive timestamp to the return of the receive call.
+    UserToHandler // Return of the receive call to the handler.
+};
+
+/**
+ * Where the latency of received datagrams goes, one LatencyHistogram per LatencyStage.\n
+ * Kernel software timestamps and OS::RealtimeNs() share CLOCK_REALTIME, so the stages after the kernel work
+ * without any hardware. The wire time is the hardware timestamp if the NIC gave one; otherwise the caller
+ * may pass its own, e.g. the transmit timestamp of the sender on the same host (ReceiveTransmitTimestamp),
+ * which makes the first stage the trip through the stack on loopback.
+ */
+class LatencyBreakdown {
+private:
+    LatencyHistogram stages[3];
+
+    static UInt64 Elapsed(UInt64 from, UInt64 to) noexcept {
+        return to > from ? to - from : 0; // Clocks of NIC and host are not synchronized perfectly.
+    }
+
+public:
+    /**
+     * @param stamps of the datagram, given by DatagramServer::Receive/TryReceive after EnableTimestamping.
+     * @param userNs OS::RealtimeNs() right after the receive call returned.
+     * @param handlerNs OS::RealtimeNs() when the handler started.
+     * @param wireNs used when the NIC gave no hardware timestamp, 0 skips WireToKernel then.
+     */
+    void Record(const DatagramTimestamps &stamps, UInt64 userNs, UInt64 handlerNs, UInt64 wireNs = 0) noexcept {
+        if (!stamps.software) {
+            return;
+        }
+        UInt64 wire = stamps.hardware ? stamps.hardware : wireNs;
+        if (wire) {
+            stages[int(LatencyStage::WireToKernel)].Record(LatencyBreakdown::Elapsed(wire, stamps.software));
+        }
+        stages[int(LatencyStage::KernelToUser)].Record(LatencyBreakdown::Elapsed(stamps.software, userNs));
+        stages[int(LatencyStage::UserToHandler)].Record(LatencyBreakdown::Elapsed(userNs, handlerNs));
+    }
+
+    /**
+     * Add every stage of other, see LatencyHistogram::Merge.
+     */
+    LatencyBreakdown &Merge(const LatencyBreakdown &other) noexcept {
+        for (int stage = 0; stage < 3; ++stage) {
+            stages[stage].Merge(other.stages[stage]);
+        }
+        return *this;
+    }
+
+    const LatencyHistogram &GetStage(LatencyStage stage) const noexcept {
+        return stages[int(stage)];
+    }
+
+    void Reset() noexcept {
+        for (LatencyHistogram &each: stages) {
+            each.Reset();
+        }
+    }
+};
+
+#endif //ESCAPIST_LATENCY_H
@@ -0,0 +1,214 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_MESSAGE_H
+#define ESCAPIST_MESSAGE_H
+
+#include "../General.h"
+#include "ByteArray.h"
+#include "Flag.h"
+
+enum class MessageFlag : UInt8 {
+    Reliable = 1,
+    Fragmented = 2,
+    Compressed = 4,
+    Response = 8
+};
+
+/**
+ * Fixed header in front of every MsgGO message, all fields in host byte order like the rest of ByteArray.\n
+ * Layout: [magic:2][version:1][flags:1][type:2][reserved:2][payload length:4][checksum:4][payload...]
+ */
+struct MessageHeader {
+    static constexpr UInt16 Magic = 0x474D; // "MG" on the wire.
+    static constexpr UInt8 CurrentVersion = 1;
+    static constexpr SizeType Size = 16;
+
+    UInt16 magic;
+    UInt8 version;
+    Flag<MessageFlag> flags;
+    UInt16 type;
+    UInt32 payloadLength;
+    UInt32 checksum;
+
+    /**
+     * Adler-32 of data, the modulo is deferred to every 5552 bytes so the loop is two additions per byte.
+     */
+    static UInt32 Checksum(const byte *data, SizeType size) noexcept {
+        UInt32 low = 1, high = 0;
+        while (size) {
+            SizeType chunk = size < 5552 ? size : 5552;
+            size -= chunk;
+            for (; chunk; --chunk) {
+                low += *data++;
+                high += low;
+            }
+            low %= 65521;
+            high %= 65521;
+        }
+        return (high << 16) | low;
+    }
+
+    /**
+     * One bounds check, then loads at fixed offsets. Only the size is checked here, see IsValid for the rest.
+     * @return false if message is shorter than the header.
+     */
+    static bool Parse(const ByteArray &message, MessageHeader &header) noexcept {
+        return MessageHeader::Parse(message.GetConstData(), message.GetSize(), header);
+    }
+
+    /**
+     * Same as above for a header at any position, e.g. one of several messages packed into a datagram.
+     */
+    static bool Parse(const byte *data, SizeType size, MessageHeader &header) noexcept {
+        if (size < MessageHeader::Size) {
+            return false;
+        }
+        UInt8 flags;
+        ::memcpy(&header.magic, data, sizeof(UInt16));
+        ::memcpy(&header.version, data + 2, sizeof(UInt8));
+        ::memcpy(&flags, data + 3, sizeof(UInt8));
+        ::memcpy(&header.type, data + 4, sizeof(UInt16));
+        ::memcpy(&header.payloadLength, data + 8, sizeof(UInt32));
+        ::memcpy(&header.checksum, data + 12, sizeof(UInt32));
+        header.flags = Flag<MessageFlag>(flags);
+        return true;
+    }
+
+    /**
+     * @return true if magic and version are known and the payload length matches the size of message.
+     */
+    bool IsValid(const ByteArray &message) const noexcept {
+        return magic == MessageHeader::Magic && version == MessageHeader::CurrentVersion &&
+               SizeType(payloadLength) == message.GetSize() - MessageHeader::Size;
+    }
+
+    bool IsChecksumValid(const ByteArray &message) const noexcept {
+        return checksum == MessageHeader::Checksum(message.GetConstData() + MessageHeader::Size, payloadLength);
+    }
+
+    /**
+     * Write a header for a payload of length bytes with the given checksum to destination.
+     */
+    static void Store(byte *destination, UInt16 type, const Flag<MessageFlag> &flags, UInt32 length,
+                      UInt32 checksum) noexcept {
+        UInt16 magic = MessageHeader::Magic;
+        UInt8 version = MessageHeader::CurrentVersion;
+        UInt8 flagValue = flags.GetValue();
+        ::memset(destination, 0, MessageHeader::Size);
+        ::memcpy(destination, &magic, sizeof(UInt16));
+        ::memcpy(destination + 2, &version, sizeof(UInt8));
+        ::memcpy(destination + 3, &flagValue, sizeof(UInt8));
+        ::memcpy(destination + 4, &type, sizeof(UInt16));
+        ::memcpy(destination + 8, &length, sizeof(UInt32));
+        ::memcpy(destination + 12, &checksum, sizeof(UInt32));
+    }
+
+    /**
+     * Append a header and payload behind the current content of buffer, so several messages can share one buffer.
+     */
+    static ByteArray &Append(ByteArray &buffer, UInt16 type, const Flag<MessageFlag> &flags,
+                             const byte *payload, SizeType size) {
+        assert(size <= 0xFFFFFFFFu);
+        byte header[MessageHeader::Size];
+        MessageHeader::Store(header, type, flags, UInt32(size), MessageHeader::Checksum(payload, size));
+        buffer.EnsureCapacity(buffer.GetSize() + MessageHeader::Size + size);
+        buffer.Append(header, MessageHeader::Size).Append(payload, size);
+        return buffer;
+    }
+
+    /**
+     * Replace the content of message by a header and payload. Reusing the same message keeps its capacity.
+     */
+    static ByteArray &Encode(ByteArray &message, UInt16 type, const Flag<MessageFlag> &flags,
+                             const byte *payload, SizeType size) {
+        message.Empty();
+        MessageHeader::Append(message, type, flags, payload, size);
+        message.ResetMark();
+        return message;
+    }
+
+    static ByteArray &Encode(ByteArray &message, UInt16 type, const Flag<MessageFlag> &flags,
+                             const ByteArray &payload) {
+        return MessageHeader::Encode(message, type, flags, payload.GetConstData(), payload.GetSize());
+    }
+};
+
+class MessageHandler {
+public:
+    virtual ~MessageHandler() = default;
+
+    /**
+     * @param message the whole message, its mark is at the first byte of the payload, so Read* starts there.
+     */
+    virtual void OnMessage(const MessageHeader &header, ByteArray &message) = 0;
+};
+
+enum class DispatchResult {
+    Dispatched,
+    Malformed, // Too short, unknown magic or version, or wrong payload length.
+    ChecksumMismatch,
+    Unhandled // No handler registered for the type.
+};
+
+/**
+ * Routes messages to the handler of their type id by a flat table of TypeCount entries, one indexed load per
+ * message instead of a chain of comparisons. Type ids at or beyond TypeCount go to the fallback handler.
+ */
+template<UInt16 TypeCount>
+class MessageDispatcher {
+private:
+    MessageHandler *handlers[TypeCount];
+    MessageHandler *fallback;
+    bool verifyChecksum;
+
+public:
+    /**
+     * @param verifyChecksum false to skip the checksum, e.g. when the transport already has one.
+     */
+    explicit MessageDispatcher(bool verifyChecksum = true) noexcept: fallback(nullptr), verifyChecksum(verifyChecksum) {
+        for (UInt16 index = 0; index < TypeCount; ++index) {
+            handlers[index] = nullptr;
+        }
+    }
+
+    /**
+     * @param handler must outlive the dispatcher, null unregisters type.
+     */
+    MessageDispatcher &Register(UInt16 type, MessageHandler *handler) noexcept {
+        assert(type < TypeCount);
+        handlers[type] = handler;
+        return *this;
+    }
+
+    /**
+     * @param handler receives every message whose type has no entry, can be null.
+     */
+    MessageDispatcher &SetFallback(MessageHandler *handler) noexcept {
+        fallback = handler;
+        return *this;
+    }
+
+    DispatchResult Dispatch(ByteArray &message) {
+        MessageHeader header{};
+        if (!MessageHeader::Parse(message, header) || !header.IsValid(message)) {
+            return DispatchResult::Malformed;
+        }
+        if (verifyChecksum && !header.IsChecksumValid(message)) {
+            return DispatchResult::ChecksumMismatch;
+        }
+        MessageHandler *handler = header.type < TypeCount ? handlers[header.type] : nullptr;
+        if (!handler) {
+            handler = fallback;
+        }
+        if (!handler) {
+            return DispatchResult::Unhandled;
+        }
+        message.ResetMark().IgnoreBytes(SizeType(MessageHeader::Size));
+        handler->OnMessage(header, message);
+        return DispatchResult::Dispatched;
+    }
+};
+
+#endif //ESCAPIST_MESSAGE_H
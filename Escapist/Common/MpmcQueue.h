@@ -0,0 +1,268 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_MPMCQUEUE_H
+#define ESCAPIST_MPMCQUEUE_H
+
+#include "../General.h"
+#include "Internal/TypeTrait.h"
+#include "Thread.h"
+
+#ifdef ESCAPIST_OS_LINUX
+
+#include <ctime>
+#include <new>
+#include <utility>
+
+namespace EscapistPrivate {
+    inline UInt64 MonotonicMs() noexcept {
+        timespec now{};
+        ::clock_gettime(CLOCK_MONOTONIC, &now);
+        return UInt64(now.tv_sec) * 1000 + UInt64(now.tv_nsec) / 1000000;
+    }
+}
+
+/**
+ * Bounded lock-free multi-producer/multi-consumer queue (Vyukov), e.g. to hand ByteArray messages from receive
+ * threads to handler threads.\n
+ * Every cell carries a sequence stamp telling whether it is free for the producer of a position or filled for its
+ * consumer, so a producer and a consumer only meet on the cell they share, and producers (consumers) only contend
+ * on one CAS of their index. Cells and both indices sit on cache lines of their own.\n
+ * TryPush and TryPop never wait. Push and Pop sleep on a futex while the queue is full or empty, and the other
+ * side only makes a system call to wake them when someone actually sleeps.
+ * @tparam T stored by its TypeTrait: copied in (or moved), moved out and destroyed.
+ */
+template<typename T>
+class MpmcQueue {
+    using TypeTrait = typename EscapistPrivate::TypeTraitPatternSelector<T>::TypeTrait;
+
+private:
+    struct alignas(EscapistPrivate::CacheLineSize) Cell {
+        UInt64 sequence;
+        alignas(T) UInt8 storage[sizeof(T)];
+    };
+
+    alignas(EscapistPrivate::CacheLineSize) UInt64 enqueue = 0;
+    alignas(EscapistPrivate::CacheLineSize) UInt64 dequeue = 0;
+    alignas(EscapistPrivate::CacheLineSize) UInt32 pushed = 0; // Futex word of consumers waiting for an element.
+    UInt32 consumerWaiting = 0;
+    alignas(EscapistPrivate::CacheLineSize) UInt32 popped = 0; // Futex word of producers waiting for room.
+    UInt32 producerWaiting = 0;
+    alignas(EscapistPrivate::CacheLineSize) UInt64 mask;
+    Cell *cells;
+
+    /**
+     * @return the cell reserved for a push, or nullptr if full.
+     */
+    Cell *ReservePush(UInt64 &position) noexcept {
+        position = __atomic_load_n(&enqueue, __ATOMIC_RELAXED);
+        for (;;) {
+            Cell *cell = cells + (position & mask);
+            Int64 difference = Int64(__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) - position);
+            if (difference == 0) {
+                if (__atomic_compare_exchange_n(&enqueue, &position, position + 1, true, __ATOMIC_RELAXED,
+                                                __ATOMIC_RELAXED)) {
+                    return cell;
+                }
+            } else if (difference < 0) {
+                return nullptr;
+            } else {
+                position = __atomic_load_n(&enqueue, __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    /**
+     * @return the cell reserved for a pop, or nullptr if empty.
+     */
+    Cell *ReservePop(UInt64 &position) noexcept {
+        position = __atomic_load_n(&dequeue, __ATOMIC_RELAXED);
+        for (;;) {
+            Cell *cell = cells + (position & mask);
+            Int64 difference = Int64(__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) - (position + 1));
+            if (difference == 0) {
+                if (__atomic_compare_exchange_n(&dequeue, &position, position + 1, true, __ATOMIC_RELAXED,
+                                                __ATOMIC_RELAXED)) {
+                    return cell;
+                }
+            } else if (difference < 0) {
+                return nullptr;
+            } else {
+                position = __atomic_load_n(&dequeue, __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    static void Wake(UInt32 *word, UInt32 *waiting) noexcept {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST); // Pairs with the one of Sleep: either sees the other.
+        if (__atomic_load_n(waiting, __ATOMIC_RELAXED)) {
+            __atomic_fetch_add(word, 1, __ATOMIC_RELEASE);
+            OS::FutexWake(word, 1);
+        }
+    }
+
+    /**
+     * Sleep on word until woken or deadline, unless ready() holds once registered as waiting.
+     * @return false once the deadline passed.
+     */
+    template<typename Ready>
+    static bool Sleep(UInt32 *word, UInt32 *waiting, UInt64 deadline, Ready ready) noexcept {
+        int timeoutMs = -1;
+        if (deadline) {
+            UInt64 now = EscapistPrivate::MonotonicMs();
+            if (now >= deadline) {
+                return false;
+            }
+            timeoutMs = int(deadline - now);
+        }
+        UInt32 epoch = __atomic_load_n(word, __ATOMIC_ACQUIRE);
+        __atomic_fetch_add(waiting, 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (!ready()) {
+            OS::FutexWait(word, epoch, timeoutMs);
+        }
+        __atomic_fetch_sub(waiting, 1, __ATOMIC_RELAXED);
+        return true;
+    }
+
+    template<typename Value>
+    bool Emplace(Value &&value, int timeoutMs) {
+        UInt64 deadline = timeoutMs > 0 ? EscapistPrivate::MonotonicMs() + UInt64(timeoutMs) : timeoutMs ? 0 : 1;
+        while (!MpmcQueue::TryPush(std::forward<Value>(value))) {
+            if (!MpmcQueue::Sleep(&popped, &producerWaiting, deadline, [this]() { return !MpmcQueue::IsFull(); })) {
+                errno = ETIMEDOUT;
+                return false;
+            }
+        }
+        return true;
+    }
+
+public:
+    /**
+     * @param capacity elements held at most, a power of 2.
+     */
+    explicit MpmcQueue(SizeType capacity) : mask(UInt64(capacity) - 1) {
+        assert(capacity && !(capacity & (capacity - 1)));
+        void *memory = nullptr;
+        int error = ::posix_memalign(&memory, EscapistPrivate::CacheLineSize, capacity * sizeof(Cell));
+        assert(!error);
+        (void) error;
+        cells = (Cell *) memory;
+        for (SizeType index = 0; index < capacity; ++index) {
+            cells[index].sequence = index;
+        }
+    }
+
+    MpmcQueue(const MpmcQueue &other) = delete;
+
+    ~MpmcQueue() {
+        UInt64 position;
+        while (Cell *cell = MpmcQueue::ReservePop(position)) {
+            TypeTrait::Destroy((T *) cell->storage);
+            __atomic_store_n(&cell->sequence, position + mask + 1, __ATOMIC_RELEASE);
+        }
+        ::free(cells);
+    }
+
+    /**
+     * @return false if full.
+     */
+    bool TryPush(const T &value) {
+        UInt64 position;
+        Cell *cell = MpmcQueue::ReservePush(position);
+        if (!cell) {
+            return false;
+        }
+        TypeTrait::Copy((T *) cell->storage, &value, 1);
+        __atomic_store_n(&cell->sequence, position + 1, __ATOMIC_RELEASE);
+        MpmcQueue::Wake(&pushed, &consumerWaiting);
+        return true;
+    }
+
+    /**
+     * Move value in, e.g. a ByteArray without touching its reference count. It is left alone if full.
+     * @return false if full.
+     */
+    bool TryPush(T &&value) {
+        UInt64 position;
+        Cell *cell = MpmcQueue::ReservePush(position);
+        if (!cell) {
+            return false;
+        }
+        new(cell->storage) T(std::move(value));
+        __atomic_store_n(&cell->sequence, position + 1, __ATOMIC_RELEASE);
+        MpmcQueue::Wake(&pushed, &consumerWaiting);
+        return true;
+    }
+
+    /**
+     * @return false if empty.
+     */
+    bool TryPop(T &value) {
+        UInt64 position;
+        Cell *cell = MpmcQueue::ReservePop(position);
+        if (!cell) {
+            return false;
+        }
+        value = std::move(*(T *) cell->storage);
+        TypeTrait::Destroy((T *) cell->storage);
+        __atomic_store_n(&cell->sequence, position + mask + 1, __ATOMIC_RELEASE);
+        MpmcQueue::Wake(&popped, &producerWaiting);
+        return true;
+    }
+
+    /**
+     * Push, sleeping while the queue is full.
+     * @param timeoutMs -1 waits as long as it takes.
+     * @return false on timeout (errno ETIMEDOUT).
+     */
+    bool Push(const T &value, int timeoutMs = -1) {
+        return MpmcQueue::Emplace(value, timeoutMs);
+    }
+
+    bool Push(T &&value, int timeoutMs = -1) {
+        return MpmcQueue::Emplace(std::move(value), timeoutMs);
+    }
+
+    /**
+     * Pop, sleeping while the queue is empty.
+     * @param timeoutMs -1 waits as long as it takes.
+     * @return false on timeout (errno ETIMEDOUT).
+     */
+    bool Pop(T &value, int timeoutMs = -1) {
+        UInt64 deadline = timeoutMs > 0 ? EscapistPrivate::MonotonicMs() + UInt64(timeoutMs) : timeoutMs ? 0 : 1;
+        while (!MpmcQueue::TryPop(value)) {
+            if (!MpmcQueue::Sleep(&pushed, &consumerWaiting, deadline, [this]() { return !MpmcQueue::IsEmpty(); })) {
+                errno = ETIMEDOUT;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @return elements held at the moment, only a hint while other threads push or pop.
+     */
+    SizeType GetSize() const noexcept {
+        UInt64 head = __atomic_load_n(&dequeue, __ATOMIC_ACQUIRE);
+        UInt64 tail = __atomic_load_n(&enqueue, __ATOMIC_ACQUIRE);
+        return tail > head ? SizeType(tail - head) : 0;
+    }
+
+    SizeType GetCapacity() const noexcept {
+        return SizeType(mask + 1);
+    }
+
+    bool IsEmpty() const noexcept {
+        return !MpmcQueue::GetSize();
+    }
+
+    bool IsFull() const noexcept {
+        return MpmcQueue::GetSize() > mask;
+    }
+};
+
+#endif
+
+#endif //ESCAPIST_MPMCQUEUE_H
@@ -0,0 +1,392 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_PUBSUB_H
+#define ESCAPIST_PUBSUB_H
+
+#include "../General.h"
+#include "ArrayList.h"
+#include "ByteArray.h"
+#include "Message.h"
+#include "Socket.h"
+#include "String.h"
+#include <algorithm>
+
+/**
+ * Subscriptions of peers by topic pattern, a pattern is either a topic (exact match) or a prefix followed by
+ * TopicTrie::Wildcard, which matches every topic starting with the prefix ("orders.*", or "*" for all).\n
+ * Patterns are stored in a trie of characters, so Match walks the topic once and costs O(topic length) plus the
+ * count of matched peers, no matter how many subscriptions exist. Wildcards inside a topic are not supported,
+ * they would fork the walk.
+ */
+class TopicTrie {
+public:
+    static constexpr Char Wildcard = '*';
+
+private:
+    struct Node;
+
+    struct Edge {
+        Char ch;
+        Node *child;
+    };
+
+    struct Node {
+        ArrayList<Edge> children; // Sorted by ch.
+        ArrayList<DatagramAddress> exact;
+        ArrayList<DatagramAddress> prefix;
+
+        bool IsUnused() const noexcept {
+            return children.IsEmpty() && exact.IsEmpty() && prefix.IsEmpty();
+        }
+    };
+
+    Node *root;
+    SizeType subscriptionCount = 0;
+
+    static bool IsSamePeer(const DatagramAddress &left, const DatagramAddress &right) noexcept {
+        return left.port == right.port && !::memcmp(left.ipAddress, right.ipAddress, 4);
+    }
+
+    /**
+     * @return index of the first edge not below ch.
+     */
+    static SizeType LowerBound(const Node *node, Char ch) noexcept {
+        SizeType low = 0, high = node->children.GetSize();
+        while (low < high) {
+            SizeType middle = (low + high) / 2;
+            if (node->children.GetConstAt(middle).ch < ch) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return low;
+    }
+
+    static Node *FindChild(const Node *node, Char ch) noexcept {
+        SizeType index = TopicTrie::LowerBound(node, ch);
+        if (index < node->children.GetSize() && node->children.GetConstAt(index).ch == ch) {
+            return node->children.GetConstAt(index).child;
+        }
+        return nullptr;
+    }
+
+    static void Destroy(Node *node) noexcept {
+        for (SizeType index = 0; index < node->children.GetSize(); ++index) {
+            TopicTrie::Destroy(node->children.GetConstAt(index).child);
+        }
+        delete node;
+    }
+
+    static void Collect(const ArrayList<DatagramAddress> &from, ArrayList<DatagramAddress> &peers) {
+        if (!from.IsEmpty()) {
+            peers.Append(from);
+        }
+    }
+
+    /**
+     * Split pattern into its literal part and whether it ends with Wildcard.
+     */
+    static SizeType GetLiteralLength(const String &pattern, bool &isPrefix) noexcept {
+        SizeType length = pattern.GetLength();
+        isPrefix = length && pattern.GetConstAt(length - 1) == TopicTrie::Wildcard;
+        return isPrefix ? length - 1 : length;
+    }
+
+    static SizeType IndexOfPeer(const ArrayList<DatagramAddress> &peers, const DatagramAddress &peer) noexcept {
+        for (SizeType index = 0; index < peers.GetSize(); ++index) {
+            if (TopicTrie::IsSamePeer(peers.GetConstAt(index), peer)) {
+                return index;
+            }
+        }
+        return peers.GetSize();
+    }
+
+    SizeType RemovePeer(Node *node, const DatagramAddress &peer) {
+        SizeType removed = 0;
+        for (SizeType index = node->children.GetSize(); index-- > 0;) {
+            Node *child = node->children.GetConstAt(index).child;
+            removed += TopicTrie::RemovePeer(child, peer);
+            if (child->IsUnused()) {
+                delete child;
+                node->children.Delete(index, 1);
+            }
+        }
+        for (ArrayList<DatagramAddress> *list: {&node->exact, &node->prefix}) {
+            SizeType index = TopicTrie::IndexOfPeer(*list, peer);
+            if (index < list->GetSize()) {
+                list->Delete(index, 1);
+                ++removed;
+            }
+        }
+        return removed;
+    }
+
+public:
+    TopicTrie() : root(new Node()) {}
+
+    TopicTrie(const TopicTrie &other) = delete;
+
+    ~TopicTrie() {
+        TopicTrie::Destroy(root);
+    }
+
+    /**
+     * @return false if peer was already subscribed to pattern.
+     */
+    bool Subscribe(const String &pattern, const DatagramAddress &peer) {
+        bool isPrefix;
+        SizeType length = TopicTrie::GetLiteralLength(pattern, isPrefix);
+        Node *node = root;
+        for (SizeType position = 0; position < length; ++position) {
+            Char ch = pattern.GetConstAt(position);
+            SizeType index = TopicTrie::LowerBound(node, ch);
+            if (index < node->children.GetSize() && node->children.GetConstAt(index).ch == ch) {
+                node = node->children.GetConstAt(index).child;
+            } else {
+                Node *child = new Node();
+                if (index < node->children.GetSize()) {
+                    node->children.Insert(index, Edge{ch, child});
+                } else { // Insert only goes before an existing element.
+                    node->children.Append(Edge{ch, child});
+                }
+                node = child;
+            }
+        }
+        ArrayList<DatagramAddress> &list = isPrefix ? node->prefix : node->exact;
+        if (TopicTrie::IndexOfPeer(list, peer) < list.GetSize()) {
+            return false;
+        }
+        list.Append(peer);
+        ++subscriptionCount;
+        return true;
+    }
+
+    /**
+     * Nodes left without subscriptions or children are freed on the way back.
+     * @return false if peer was not subscribed to pattern.
+     */
+    bool Unsubscribe(const String &pattern, const DatagramAddress &peer) {
+        bool isPrefix;
+        SizeType length = TopicTrie::GetLiteralLength(pattern, isPrefix);
+        ArrayList<Node *> path;
+        path.EnsureCapacity(length + 1);
+        Node *node = root;
+        path.Append(node);
+        for (SizeType position = 0; position < length && node; ++position) {
+            node = TopicTrie::FindChild(node, pattern.GetConstAt(position));
+            path.Append(node);
+        }
+        if (!node) {
+            return false;
+        }
+        ArrayList<DatagramAddress> &list = isPrefix ? node->prefix : node->exact;
+        SizeType index = TopicTrie::IndexOfPeer(list, peer);
+        if (index == list.GetSize()) {
+            return false;
+        }
+        list.Delete(index, 1);
+        --subscriptionCount;
+        for (SizeType depth = length; depth > 0 && path.GetConstAt(depth)->IsUnused(); --depth) {
+            Node *parent = path.GetConstAt(depth - 1);
+            delete path.GetConstAt(depth);
+            parent->children.Delete(TopicTrie::LowerBound(parent, pattern.GetConstAt(depth - 1)), 1);
+        }
+        return true;
+    }
+
+    /**
+     * Drop every subscription of peer, e.g. when its session expired. Visits the whole trie.
+     * @return count of dropped subscriptions.
+     */
+    SizeType UnsubscribeAll(const DatagramAddress &peer) {
+        SizeType removed = TopicTrie::RemovePeer(root, peer);
+        subscriptionCount -= removed;
+        return removed;
+    }
+
+    /**
+     * Append every peer subscribed to a pattern matching topic to peers.
+     * A peer matching by several patterns is appended once per pattern.
+     */
+    void Match(const Char *topic, SizeType length, ArrayList<DatagramAddress> &peers) const {
+        const Node *node = root;
+        TopicTrie::Collect(node->prefix, peers);
+        for (SizeType position = 0; position < length; ++position) {
+            node = TopicTrie::FindChild(node, topic[position]);
+            if (!node) {
+                return;
+            }
+            TopicTrie::Collect(node->prefix, peers);
+        }
+        TopicTrie::Collect(node->exact, peers);
+    }
+
+    SizeType GetSubscriptionCount() const noexcept {
+        return subscriptionCount;
+    }
+};
+
+enum class PubSubType : UInt16 {
+    Subscribe = 1,
+    Unsubscribe = 2,
+    Publish = 3
+};
+
+/**
+ * Broker of a message bus on a DatagramServer.\n
+ * Every datagram is a MessageHeader of a PubSubType, whose payload starts with [topic length:2][topic...],
+ * the topic being raw Char units. A Publish carries the body behind its topic, Subscribe and Unsubscribe
+ * carry the pattern (see TopicTrie) as their topic.\n
+ * A Publish is forwarded unchanged to every subscriber: the received ByteArray is shared by reference count
+ * among the batch of SendBatch, so fan-out never copies the message. Its only allocation is the reference
+ * count, malloc'ed by the first share of a buffer not shared yet, once per message whatever the count of
+ * subscribers.
+ */
+class PubSubBroker {
+private:
+    DatagramServer &server;
+    TopicTrie trie;
+    ArrayList<DatagramAddress> targets; // Reused by every Publish.
+    UInt64 publishedCount = 0;
+    UInt64 forwardedCount = 0;
+    UInt64 droppedCount = 0;
+
+    static bool Before(const DatagramAddress &left, const DatagramAddress &right) noexcept {
+        int compared = ::memcmp(left.ipAddress, right.ipAddress, 4);
+        return compared < 0 || (!compared && left.port < right.port);
+    }
+
+    static bool IsSamePeer(const DatagramAddress &left, const DatagramAddress &right) noexcept {
+        return left.port == right.port && !::memcmp(left.ipAddress, right.ipAddress, 4);
+    }
+
+public:
+    /**
+     * @param server must outlive the broker.
+     */
+    explicit PubSubBroker(DatagramServer &server) noexcept: server(server) {}
+
+    /**
+     * Write a message of type to message (reusing its capacity), with topic and body as payload.
+     */
+    static ByteArray &Encode(ByteArray &message, PubSubType type, const String &topic,
+                             const byte *body = nullptr, SizeType size = 0) {
+        SizeType topicSize = topic.GetLength() * sizeof(Char);
+        assert(topic.GetLength() <= 0xFFFF);
+        ByteArray payload;
+        payload.EnsureCapacity(sizeof(UInt16) + topicSize + size);
+        payload.WriteSimpleValue<UInt16>(UInt16(topic.GetLength()));
+        payload.Append((const byte *) topic.GetConstData(), topicSize).Append(body, size);
+        return MessageHeader::Encode(message, UInt16(type), Flag<MessageFlag>(), payload);
+    }
+
+    /**
+     * Read the topic of a message parsed by MessageHeader, the mark moves to the first byte of the body.
+     * @return false if the payload is shorter than its topic.
+     */
+    static bool ReadTopic(ByteArray &message, const Char *&topic, SizeType &length) noexcept {
+        SizeType size = message.GetSize();
+        if (size < MessageHeader::Size + sizeof(UInt16)) {
+            return false;
+        }
+        message.ResetMark().IgnoreBytes(SizeType(MessageHeader::Size));
+        length = message.ReadSimpleValue<UInt16>();
+        if (size - MessageHeader::Size - sizeof(UInt16) < length * sizeof(Char)) {
+            return false;
+        }
+        topic = (const Char *) (message.GetConstData() + MessageHeader::Size + sizeof(UInt16));
+        message.IgnoreBytes(length * sizeof(Char));
+        return true;
+    }
+
+    /**
+     * Handle one datagram from peer.
+     * @return false if it was malformed, or not a PubSubType.
+     */
+    bool OnDatagram(const DatagramAddress &peer, ByteArray &datagram) {
+        MessageHeader header{};
+        const Char *topic;
+        SizeType length;
+        if (!MessageHeader::Parse(datagram, header) || !header.IsValid(datagram) ||
+            !header.IsChecksumValid(datagram) || !PubSubBroker::ReadTopic(datagram, topic, length)) {
+            return false;
+        }
+        switch (PubSubType(header.type)) {
+            case PubSubType::Subscribe:
+                trie.Subscribe(String(topic, length), peer);
+                return true;
+            case PubSubType::Unsubscribe:
+                trie.Unsubscribe(String(topic, length), peer);
+                return true;
+            case PubSubType::Publish:
+                PubSubBroker::Publish(topic, length, datagram);
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * Send message to every subscriber of topic once, without copying it. A subscriber the kernel refuses
+     * (e.g. unreachable) is counted as dropped and skipped, the rest still get the message.
+     * @param message whole datagram, usually the Publish as received.
+     * @return count of subscribers the kernel accepted the message for.
+     */
+    SizeType Publish(const Char *topic, SizeType length, const ByteArray &message) {
+        ++publishedCount;
+        targets.Empty();
+        trie.Match(topic, length, targets);
+        SizeType count = targets.GetSize();
+        if (!count) {
+            return 0;
+        }
+        DatagramAddress *peers = targets.GetData();
+        std::sort(peers, peers + count, PubSubBroker::Before);
+        count = SizeType(std::unique(peers, peers + count, PubSubBroker::IsSamePeer) - peers);
+
+        ByteArray batch[DatagramServer::MaximumBatchSize];
+        SizeType forwarded = 0;
+        for (SizeType offset = 0; offset < count; offset += DatagramServer::MaximumBatchSize) {
+            int chunk = int(count - offset < SizeType(DatagramServer::MaximumBatchSize) ?
+                            count - offset : DatagramServer::MaximumBatchSize);
+            for (int index = 0; index < chunk; ++index) {
+                batch[index] = message; // Shares the buffer, only the reference count changes.
+            }
+            for (int done = 0; done < chunk;) { // SendBatch stops at the first refused datagram.
+                int sent = server.SendBatch(batch + done, peers + offset + done, chunk - done);
+                forwarded += sent;
+                done += sent;
+                if (done < chunk) {
+                    ++droppedCount;
+                    ++done;
+                }
+            }
+        }
+        forwardedCount += forwarded;
+        return forwarded;
+    }
+
+    TopicTrie &GetTopics() noexcept {
+        return trie;
+    }
+
+    UInt64 GetPublishedCount() const noexcept {
+        return publishedCount;
+    }
+
+    UInt64 GetForwardedCount() const noexcept {
+        return forwardedCount;
+    }
+
+    /**
+     * @return count of copies the kernel refused, e.g. because the socket buffer was full.
+     */
+    UInt64 GetDroppedCount() const noexcept {
+        return droppedCount;
+    }
+};
+
+#endif //ESCAPIST_PUBSUB_H
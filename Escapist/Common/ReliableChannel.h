@@ -0,0 +1,488 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_RELIABLECHANNEL_H
+#define ESCAPIST_RELIABLECHANNEL_H
+
+#include "../General.h"
+#include "ByteArray.h"
+#include "Socket.h"
+#include <chrono>
+
+/**
+ * Way a ReliableChannel puts its packets on the wire.
+ */
+class ChannelTransport {
+public:
+    virtual ~ChannelTransport() = default;
+
+    /**
+     * @return false if the packet was refused, the channel treats it as lost.
+     */
+    virtual bool Transmit(const ByteArray &packet) = 0;
+};
+
+/**
+ * Transport of the connecting side, every packet goes to the peer of client.
+ */
+class ClientChannelTransport : public ChannelTransport {
+private:
+    DatagramClient &client;
+
+public:
+    explicit ClientChannelTransport(DatagramClient &client) noexcept: client(client) {}
+
+    bool Transmit(const ByteArray &packet) override {
+        return client.Send(packet);
+    }
+};
+
+/**
+ * Transport of the accepting side, one per peer, all sharing the same server.
+ */
+class ServerChannelTransport : public ChannelTransport {
+private:
+    DatagramServer &server;
+    DatagramAddress peer;
+
+public:
+    ServerChannelTransport(DatagramServer &server, const DatagramAddress &peer) noexcept: server(server), peer(peer) {}
+
+    bool Transmit(const ByteArray &packet) override {
+        return server.SendBatch(&packet, &peer, 1) == 1;
+    }
+};
+
+class ChannelReceiver {
+public:
+    virtual ~ChannelReceiver() = default;
+
+    /**
+     * Called once per message, in the order they were sent.
+     * @param message the whole packet, its mark is at the first byte of the message, so Read* starts there.
+     */
+    virtual void OnMessage(ByteArray &message) = 0;
+};
+
+/**
+ * At-least-once, in-order delivery of messages between two peers over datagrams.\n
+ * Every message travels in one packet with a sequence number. The receiver acknowledges cumulatively and
+ * selectively (a bitmap of the 64 packets after the first hole), so a single loss only resends that packet.
+ * A packet is lost once a packet sent after it was acknowledged and the smoothed RTT plus a reordering margin
+ * has passed since it was sent. The margin starts at a quarter of the minimum RTT and grows whenever a
+ * retransmission turns out to be spurious, which also undoes the window reduction; the retransmission timeout derived from measured RTT only recovers
+ * the tail. The sender keeps no more than a congestion window (slow start, then additive increase, halved on loss)
+ * of packets in flight.\n
+ * The channel owns no socket and no thread: feed it every datagram from the peer by OnDatagram, and call Poll
+ * after every batch and whenever GetTimeoutMs expires. All times are microseconds of ReliableChannel::Now().
+ */
+class ReliableChannel {
+public:
+    static constexpr UInt32 WindowCapacity = 1024; // Power of two, unacknowledged messages held by a channel.
+    static constexpr int SelectiveBits = 64;
+    static constexpr UInt64 InitialRto = 200000;
+    static constexpr UInt64 MinimumRto = 5000;
+    static constexpr UInt64 MaximumRto = 2000000;
+    static constexpr int MaximumReorderingSteps = 4;
+    static constexpr SizeType DataHeaderSize = sizeof(byte) + sizeof(UInt32);
+
+private:
+    enum PacketType : byte {
+        Data = 1,
+        Ack = 2
+    };
+
+    struct Outgoing {
+        ByteArray packet;
+        UInt64 sentAt = 0;
+        bool sent = false;
+        bool acked = false;
+        bool retransmitted = false;
+    };
+
+    struct Incoming {
+        ByteArray packet;
+        bool present = false;
+    };
+
+    ChannelTransport &transport;
+    ChannelReceiver *receiver;
+    Outgoing *outgoing;
+    Incoming *incoming;
+
+    UInt32 sendBase = 0; // Oldest unacknowledged.
+    UInt32 sendNext = 0; // Next to transmit for the first time.
+    UInt32 sendEnd = 0; // Next to be assigned by Send.
+    UInt32 inFlight = 0;
+    double window = 4;
+    double threshold = WindowCapacity;
+    UInt32 recoveryPoint = 0;
+    bool recovering = false;
+
+    UInt64 smoothedRtt = 0;
+    UInt64 rttVariance = 0;
+    UInt64 minimumRtt = 0;
+    int reorderingSteps = 1; // Reordering margin in quarters of minimumRtt, up to MaximumReorderingSteps.
+    double windowBeforeLoss = 0;
+    double thresholdBeforeLoss = 0;
+    UInt64 rto = ReliableChannel::InitialRto;
+    UInt64 latestAckedSentAt = 0; // Send time of the most recently sent packet that was acknowledged.
+
+    UInt32 receiveNext = 0;
+    int unacknowledged = 0;
+    bool ackPending = false;
+
+    UInt64 retransmitCount = 0;
+    UInt64 timeoutCount = 0;
+    UInt64 deliveredCount = 0;
+
+    static bool Before(UInt32 left, UInt32 right) noexcept {
+        return Int32(left - right) < 0;
+    }
+
+    Outgoing &OutgoingAt(UInt32 sequence) noexcept {
+        return outgoing[sequence & (ReliableChannel::WindowCapacity - 1)];
+    }
+
+    Incoming &IncomingAt(UInt32 sequence) noexcept {
+        return incoming[sequence & (ReliableChannel::WindowCapacity - 1)];
+    }
+
+    void TransmitOutgoing(Outgoing &each, UInt64 now) {
+        each.sentAt = now;
+        transport.Transmit(each.packet);
+    }
+
+    void TransmitAck() {
+        UInt64 bitmap = 0;
+        for (int index = 0; index < ReliableChannel::SelectiveBits; ++index) {
+            if (ReliableChannel::IncomingAt(receiveNext + 1 + index).present) {
+                bitmap |= UInt64(1) << index;
+            }
+        }
+        ByteArray packet;
+        packet.EnsureCapacity(sizeof(byte) + sizeof(UInt32) + sizeof(UInt64));
+        packet.WriteByte(PacketType::Ack).WriteSimpleValue<UInt32>(receiveNext).WriteSimpleValue<UInt64>(bitmap);
+        transport.Transmit(packet);
+        unacknowledged = 0;
+        ackPending = false;
+    }
+
+    void SampleRtt(UInt64 sample) noexcept {
+        if (!minimumRtt || sample < minimumRtt) {
+            minimumRtt = sample;
+        }
+        if (!smoothedRtt) {
+            smoothedRtt = sample;
+            rttVariance = sample / 2;
+        } else {
+            UInt64 deviation = smoothedRtt > sample ? smoothedRtt - sample : sample - smoothedRtt;
+            rttVariance = (3 * rttVariance + deviation) / 4;
+            smoothedRtt = (7 * smoothedRtt + sample) / 8;
+        }
+        rto = smoothedRtt + 4 * rttVariance;
+        if (rto < ReliableChannel::MinimumRto) {
+            rto = ReliableChannel::MinimumRto;
+        } else if (rto > ReliableChannel::MaximumRto) {
+            rto = ReliableChannel::MaximumRto;
+        }
+    }
+
+    /**
+     * Halve the window, at most once per window of data.
+     */
+    void OnLoss(UInt32 sequence) noexcept {
+        if (recovering && ReliableChannel::Before(sequence, recoveryPoint)) {
+            return;
+        }
+        windowBeforeLoss = window;
+        thresholdBeforeLoss = threshold;
+        threshold = window / 2 < 2 ? 2 : window / 2;
+        window = threshold;
+        recoveryPoint = sendNext;
+        recovering = true;
+    }
+
+    void Acknowledge(Outgoing &each, UInt64 now, UInt64 &latestSample) noexcept {
+        if (!each.sent || each.acked) {
+            return;
+        }
+        each.acked = true;
+        --inFlight;
+        if (!each.retransmitted) { // Karn, a retransmitted packet gives an ambiguous sample.
+            latestSample = now - each.sentAt;
+        } else if (now - each.sentAt < minimumRtt) { // Too fast for the retransmission, the original arrived.
+            if (reorderingSteps < ReliableChannel::MaximumReorderingSteps) {
+                ++reorderingSteps;
+            }
+            if (recovering) {
+                window = windowBeforeLoss;
+                threshold = thresholdBeforeLoss;
+                recovering = false;
+            }
+        }
+        if (each.sentAt > latestAckedSentAt) {
+            latestAckedSentAt = each.sentAt;
+        }
+        each.packet = ByteArray();
+        window += window < threshold ? 1 : 1 / window;
+        if (window > ReliableChannel::WindowCapacity) {
+            window = ReliableChannel::WindowCapacity;
+        }
+    }
+
+    void OnAck(ByteArray &packet, UInt64 now) {
+        UInt32 cumulative = packet.ReadSimpleValue<UInt32>();
+        UInt64 bitmap = packet.ReadSimpleValue<UInt64>();
+        if (ReliableChannel::Before(sendNext, cumulative)) {
+            return; // Acknowledges what was never sent, not from our peer.
+        }
+        UInt64 latestSample = 0;
+        for (UInt32 sequence = sendBase; ReliableChannel::Before(sequence, cumulative); ++sequence) {
+            ReliableChannel::Acknowledge(ReliableChannel::OutgoingAt(sequence), now, latestSample);
+        }
+        for (int index = 0; index < ReliableChannel::SelectiveBits; ++index) {
+            UInt32 sequence = cumulative + 1 + index;
+            if (!ReliableChannel::Before(sequence, sendNext)) {
+                break;
+            }
+            if (bitmap & (UInt64(1) << index)) {
+                ReliableChannel::Acknowledge(ReliableChannel::OutgoingAt(sequence), now, latestSample);
+            }
+        }
+        if (latestSample) {
+            ReliableChannel::SampleRtt(latestSample);
+        }
+        while (ReliableChannel::Before(sendBase, sendNext) && ReliableChannel::OutgoingAt(sendBase).acked) {
+            ++sendBase;
+        }
+        if (recovering && !ReliableChannel::Before(sendBase, recoveryPoint)) {
+            recovering = false;
+        }
+        ReliableChannel::DetectLosses(now);
+    }
+
+    UInt64 GetLossDelay() const noexcept {
+        if (!smoothedRtt) {
+            return rto;
+        }
+        UInt64 reordering = reorderingSteps * minimumRtt / 4;
+        return smoothedRtt + (reordering < smoothedRtt ? reordering : smoothedRtt);
+    }
+
+    /**
+     * Retransmit every packet overtaken by an acknowledged one for longer than GetLossDelay().
+     */
+    void DetectLosses(UInt64 now) {
+        UInt64 delay = ReliableChannel::GetLossDelay();
+        for (UInt32 sequence = sendBase; ReliableChannel::Before(sequence, sendNext); ++sequence) {
+            Outgoing &each = ReliableChannel::OutgoingAt(sequence);
+            if (each.acked || each.sentAt >= latestAckedSentAt || now - each.sentAt < delay) {
+                continue;
+            }
+            ReliableChannel::OnLoss(sequence);
+            each.retransmitted = true;
+            ++retransmitCount;
+            ReliableChannel::TransmitOutgoing(each, now);
+        }
+    }
+
+    void OnData(ByteArray &packet) {
+        UInt32 sequence = packet.ReadSimpleValue<UInt32>();
+        if (ReliableChannel::Before(sequence, receiveNext)) {
+            ReliableChannel::TransmitAck(); // Our ack was lost, repeat it at once.
+            return;
+        }
+        if (sequence - receiveNext >= ReliableChannel::WindowCapacity) {
+            return;
+        }
+        if (sequence != receiveNext) {
+            Incoming &slot = ReliableChannel::IncomingAt(sequence);
+            if (!slot.present) {
+                slot.packet = (ByteArray &&) packet;
+                slot.present = true;
+            }
+            ReliableChannel::TransmitAck(); // Tell the sender about the hole without delay.
+            return;
+        }
+        ++receiveNext;
+        ++deliveredCount;
+        receiver->OnMessage(packet);
+        bool filledHole = false;
+        for (Incoming *slot; (slot = &ReliableChannel::IncomingAt(receiveNext))->present; ++receiveNext) {
+            ByteArray message = (ByteArray &&) slot->packet;
+            slot->present = false;
+            filledHole = true;
+            ++deliveredCount;
+            receiver->OnMessage(message);
+        }
+        if (filledHole || ++unacknowledged >= 2) {
+            ReliableChannel::TransmitAck();
+        } else {
+            ackPending = true;
+        }
+    }
+
+    void TransmitNew(UInt64 now) {
+        while (ReliableChannel::Before(sendNext, sendEnd) && inFlight < UInt32(window)) {
+            Outgoing &each = ReliableChannel::OutgoingAt(sendNext++);
+            each.sent = true;
+            ++inFlight;
+            ReliableChannel::TransmitOutgoing(each, now);
+        }
+    }
+
+public:
+    static UInt64 Now() noexcept {
+        return (UInt64) std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * @param transport must outlive the channel.
+     * @param receiver delivered messages, must outlive the channel.
+     */
+    ReliableChannel(ChannelTransport &transport, ChannelReceiver *receiver) : transport(transport), receiver(receiver) {
+        assert(receiver);
+        outgoing = new Outgoing[ReliableChannel::WindowCapacity];
+        incoming = new Incoming[ReliableChannel::WindowCapacity];
+    }
+
+    ReliableChannel(const ReliableChannel &other) = delete;
+
+    ~ReliableChannel() {
+        delete[] outgoing;
+        delete[] incoming;
+    }
+
+    /**
+     * Queue a message and transmit it as soon as the congestion window allows.
+     * @return false if WindowCapacity messages are still unacknowledged, try again after acks arrive.
+     */
+    bool Send(const ByteArray &message, UInt64 now) {
+        if (sendEnd - sendBase >= ReliableChannel::WindowCapacity) {
+            return false;
+        }
+        Outgoing &each = ReliableChannel::OutgoingAt(sendEnd++);
+        each.packet.EnsureCapacity(ReliableChannel::DataHeaderSize + message.GetSize());
+        each.packet.WriteByte(PacketType::Data).WriteSimpleValue<UInt32>(sendEnd - 1).WriteBytes(message);
+        each.sent = false;
+        each.acked = false;
+        each.retransmitted = false;
+        ReliableChannel::TransmitNew(now);
+        return true;
+    }
+
+    /**
+     * Feed a datagram received from the peer. In-order messages are delivered at once, out-of-order packets
+     * are kept (moved out of datagram, without copying) until the hole before them is filled.
+     */
+    void OnDatagram(ByteArray &datagram, UInt64 now) {
+        if (datagram.GetSize() < ReliableChannel::DataHeaderSize) {
+            return;
+        }
+        datagram.ResetMark();
+        byte type = datagram.ReadByte();
+        if (type == PacketType::Data) {
+            ReliableChannel::OnData(datagram);
+        } else if (type == PacketType::Ack && datagram.GetSize() >= sizeof(byte) + sizeof(UInt32) + sizeof(UInt64)) {
+            ReliableChannel::OnAck(datagram, now);
+            ReliableChannel::TransmitNew(now);
+        }
+    }
+
+    /**
+     * Flush a delayed ack, retransmit timed out packets and transmit what the window now allows.
+     */
+    void Poll(UInt64 now) {
+        if (ackPending) {
+            ReliableChannel::TransmitAck();
+        }
+        ReliableChannel::DetectLosses(now);
+        bool timedOut = false;
+        for (UInt32 sequence = sendBase; ReliableChannel::Before(sequence, sendNext); ++sequence) {
+            Outgoing &each = ReliableChannel::OutgoingAt(sequence);
+            if (each.acked || now - each.sentAt < rto) {
+                continue;
+            }
+            if (!timedOut) {
+                timedOut = true;
+                threshold = inFlight / 2.0 < 2 ? 2 : inFlight / 2.0;
+                window = 1;
+                recovering = false;
+            }
+            each.retransmitted = true;
+            ++retransmitCount;
+            ReliableChannel::TransmitOutgoing(each, now);
+        }
+        if (timedOut) {
+            ++timeoutCount;
+            rto = rto * 2 > ReliableChannel::MaximumRto ? ReliableChannel::MaximumRto : rto * 2;
+        }
+        ReliableChannel::TransmitNew(now);
+    }
+
+    /**
+     * @return milliseconds until Poll has something to do, -1 if nothing is pending, suitable for EventLoop::RunOnce.
+     */
+    int GetTimeoutMs(UInt64 now) noexcept {
+        if (ackPending) {
+            return 0;
+        }
+        UInt64 earliest = 0;
+        bool pending = false;
+        UInt64 delay = ReliableChannel::GetLossDelay();
+        for (UInt32 sequence = sendBase; ReliableChannel::Before(sequence, sendNext); ++sequence) {
+            const Outgoing &each = ReliableChannel::OutgoingAt(sequence);
+            if (each.acked) {
+                continue;
+            }
+            UInt64 deadline = each.sentAt + (each.sentAt < latestAckedSentAt && delay < rto ? delay : rto);
+            if (!pending || deadline < earliest) {
+                earliest = deadline;
+                pending = true;
+            }
+        }
+        if (!pending) {
+            return -1;
+        }
+        return earliest <= now ? 0 : int((earliest - now + 999) / 1000);
+    }
+
+    /**
+     * @return count of messages sent but not acknowledged yet, including those waiting for the window.
+     */
+    UInt32 GetPendingCount() const noexcept {
+        return sendEnd - sendBase;
+    }
+
+    UInt64 GetSmoothedRtt() const noexcept {
+        return smoothedRtt;
+    }
+
+    UInt64 GetRto() const noexcept {
+        return rto;
+    }
+
+    double GetWindow() const noexcept {
+        return window;
+    }
+
+    UInt64 GetRetransmitCount() const noexcept {
+        return retransmitCount;
+    }
+
+    /**
+     * @return count of retransmission timeouts, each one resends every expired packet and collapses the window.
+     */
+    UInt64 GetTimeoutCount() const noexcept {
+        return timeoutCount;
+    }
+
+    UInt64 GetDeliveredCount() const noexcept {
+        return deliveredCount;
+    }
+};
+
+#endif //ESCAPIST_RELIABLECHANNEL_H
@@ -0,0 +1,502 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_RPC_H
+#define ESCAPIST_RPC_H
+
+#include "../General.h"
+#include "ArrayList.h"
+#include "ByteArray.h"
+#include "Message.h"
+#include "Socket.h"
+#include "TimerWheel.h"
+#include "Tuple.h"
+
+#ifdef ESCAPIST_OS_LINUX
+#include <poll.h>
+#endif
+
+/**
+ * Correlation id of a call, (generation << 32) | (slot + 1), so a late response to a reused slot is told apart.
+ */
+using RpcId = UInt64;
+
+enum class RpcStatus : UInt8 {
+    Ok = 0,
+    UnknownMethod = 1, // Reported by the server.
+    Failed = 2, // Reported by the server, the method refused the call.
+    Timeout = 3,
+    Cancelled = 4
+};
+
+/**
+ * Packs fundamental values of a Tuple behind each other by ByteArray::WriteSimpleValue and back, in order.
+ */
+class RpcCodec {
+private:
+    template<SizeType index, typename ...Types>
+    struct Packer {
+        static void Pack(ByteArray &buffer, const Tuple<Types...> &values) {
+            Packer<index - 1, Types...>::Pack(buffer, values);
+            buffer.WriteSimpleValue(GetTupleValue<index - 1>(values));
+        }
+    };
+
+    template<typename ...Types>
+    struct Packer<0, Types...> {
+        static void Pack(ByteArray &, const Tuple<Types...> &) {}
+    };
+
+public:
+    template<typename ...Types>
+    static ByteArray &Pack(ByteArray &buffer, const Tuple<Types...> &values) {
+        RpcCodec::Packer<sizeof...(Types), Types...>::Pack(buffer, values);
+        return buffer;
+    }
+
+    /**
+     * @return bytes Pack appends for values of Types.
+     */
+    template<typename ...Types>
+    static SizeType GetPackedSize() noexcept {
+        SizeType sizes[] = {0, sizeof(Types)...};
+        SizeType total = 0;
+        for (SizeType size: sizes) {
+            total += size;
+        }
+        return total;
+    }
+
+    /**
+     * @return true if buffer holds at least the values of Types from its mark on.
+     */
+    template<typename ...Types>
+    static bool CanUnpack(const ByteArray &buffer, SizeType mark) noexcept {
+        SizeType total = RpcCodec::GetPackedSize<Types...>();
+        return buffer.GetSize() >= mark && buffer.GetSize() - mark >= total;
+    }
+
+    /**
+     * Read the values from the mark of buffer on, see CanUnpack for the bounds.
+     */
+    template<typename ...Types>
+    static Tuple<Types...> Unpack(ByteArray &buffer) noexcept {
+        return Tuple<Types...>{buffer.ReadSimpleValue<Types>()...}; // Braces evaluate left to right.
+    }
+};
+
+class RpcClient;
+
+class RpcHandler {
+public:
+    virtual ~RpcHandler() = default;
+
+    /**
+     * Called once per call: with the response, or with Timeout or Cancelled.
+     * @param result the response, its mark is at the first byte of the result, empty without a response.
+     */
+    virtual void OnResponse(RpcId id, UInt64 context, RpcStatus status, ByteArray &result) = 0;
+};
+
+/**
+ * Result of one call for callers who would rather look than be called back. It is to outlive the call,
+ * destroying it while pending cancels the call.
+ */
+class RpcFuture : public RpcHandler {
+private:
+    friend class RpcClient;
+
+    RpcClient *client = nullptr;
+    RpcId id = 0;
+    bool ready = false;
+    RpcStatus status = RpcStatus::Ok;
+    ByteArray result;
+
+public:
+    RpcFuture() = default;
+
+    RpcFuture(const RpcFuture &other) = delete;
+
+    inline ~RpcFuture() override;
+
+    void OnResponse(RpcId, UInt64, RpcStatus responseStatus, ByteArray &response) override {
+        ready = true;
+        status = responseStatus;
+        result = static_cast<ByteArray &&>(response); // Keeps the received datagram, no copy.
+    }
+
+    bool IsReady() const noexcept {
+        return ready;
+    }
+
+    RpcStatus GetStatus() const noexcept {
+        return status;
+    }
+
+    /**
+     * @return the response, its mark is at the first byte of the result.
+     */
+    ByteArray &GetResult() noexcept {
+        return result;
+    }
+};
+
+/**
+ * Calls methods of one RpcServer over a connected DatagramClient, any count of calls in flight at once.\n
+ * A request is a MsgGO message whose type is the method, its payload [correlation id:8][arguments...]; the
+ * response carries MessageFlag::Response and [correlation id:8][status:1][result...]. Responses complete their
+ * calls in whatever order they arrive.\n
+ * Pending calls live in a slot table allocated once, so a call allocates nothing. Timeouts are timers of a
+ * TimerWheel, which the owner advances along with the EventLoop reading the client (see Poll).
+ * Not thread-safe.
+ */
+class RpcClient : public TimerHandler {
+private:
+    static constexpr UInt32 Null = 0xFFFFFFFFu;
+    static constexpr SizeType IdSize = sizeof(RpcId);
+
+    struct Slot {
+        RpcHandler *handler; // Null if the slot is free.
+        UInt64 context;
+        TimerId timer;
+        UInt32 generation;
+        UInt32 next; // Free list.
+    };
+
+    DatagramClient &client;
+    TimerWheel *timers;
+    ArrayList<Slot> slots;
+    UInt32 freeHead;
+    SizeType pendingCount = 0;
+    ByteArray request; // Reused by every call.
+
+    static RpcId MakeId(UInt32 index, UInt32 generation) noexcept {
+        return (UInt64(generation) << 32) | (UInt64(index) + 1);
+    }
+
+    Slot *SlotOf(RpcId id) noexcept {
+        UInt32 index = UInt32(id) - 1;
+        if (!id || index >= slots.GetSize()) {
+            return nullptr;
+        }
+        Slot &slot = slots.GetData()[index];
+        return slot.handler && slot.generation == UInt32(id >> 32) ? &slot : nullptr;
+    }
+
+    /**
+     * Free the slot of id and call its handler, which may start new calls right away.
+     */
+    void Complete(RpcId id, RpcStatus status, ByteArray &result) {
+        Slot *slot = RpcClient::SlotOf(id);
+        if (!slot) {
+            return;
+        }
+        if (slot->timer != TimerWheel::InvalidId) {
+            timers->Cancel(slot->timer);
+        }
+        RpcHandler *handler = slot->handler;
+        UInt64 context = slot->context;
+        UInt32 index = UInt32(id) - 1;
+        slot->handler = nullptr;
+        ++slot->generation;
+        slot->next = freeHead;
+        freeHead = index;
+        --pendingCount;
+        handler->OnResponse(id, context, status, result);
+    }
+
+    /**
+     * Start the request of the next call in the reused buffer: room for the header, then the correlation id.
+     * The arguments are to be appended behind, see FinishRequest.
+     * @param size bytes of arguments, reserved at once.
+     * @return correlation id the call will get, 0 if every slot is in use.
+     */
+    RpcId BeginRequest(SizeType size) {
+        if (freeHead == RpcClient::Null) {
+            errno = ENOBUFS;
+            return 0;
+        }
+        RpcId id = RpcClient::MakeId(freeHead, slots.GetConstAt(freeHead).generation);
+        // Header, id and arguments in one buffer; the header is filled once the checksum is known.
+        request.Empty();
+        request.EnsureCapacity(MessageHeader::Size + RpcClient::IdSize + size);
+        request.Append(byte(0), MessageHeader::Size);
+        request.WriteSimpleValue(id);
+        return id;
+    }
+
+    /**
+     * Fill the header of the request begun by BeginRequest, send it, then take the slot of id.
+     * @return id, 0 if the kernel refused the request.
+     */
+    RpcId FinishRequest(UInt16 method, RpcId id, RpcHandler *handler, UInt64 context, UInt64 timeoutUs) {
+        const byte *payload = request.GetConstData() + MessageHeader::Size;
+        SizeType length = request.GetSize() - MessageHeader::Size;
+        MessageHeader::Store(request.GetData(), method, Flag<MessageFlag>(), UInt32(length),
+                             MessageHeader::Checksum(payload, length));
+        if (!client.Send(request)) {
+            return 0;
+        }
+        Slot &slot = slots.GetData()[UInt32(id) - 1];
+        freeHead = slot.next;
+        slot.handler = handler;
+        slot.context = context;
+        slot.timer = timers && timeoutUs ? timers->Schedule(timeoutUs, this, id) : TimerWheel::InvalidId;
+        ++pendingCount;
+        return id;
+    }
+
+public:
+    /**
+     * @param client connected to the server, must outlive this.
+     * @param capacity most calls in flight at once.
+     * @param timers wheel to keep timeouts by, must outlive this, null disables timeouts.
+     */
+    explicit RpcClient(DatagramClient &client, SizeType capacity = 1024, TimerWheel *timers = nullptr)
+            : client(client), timers(timers), slots(capacity, capacity), freeHead(RpcClient::Null) {
+        assert(capacity && capacity < RpcClient::Null);
+        for (SizeType index = capacity; index > 0; --index) {
+            Slot &slot = slots.GetData()[index - 1];
+            slot = Slot{nullptr, 0, TimerWheel::InvalidId, 0, freeHead};
+            freeHead = UInt32(index - 1);
+        }
+    }
+
+    RpcClient(const RpcClient &other) = delete;
+
+    /**
+     * Pending calls are cancelled.
+     */
+    ~RpcClient() override {
+        for (SizeType index = 0; index < slots.GetSize() && pendingCount; ++index) {
+            const Slot &slot = slots.GetConstAt(index);
+            if (slot.handler) {
+                RpcClient::Cancel(RpcClient::MakeId(UInt32(index), slot.generation));
+            }
+        }
+    }
+
+    /**
+     * Send a request without waiting for its response.
+     * @param arguments bytes to append behind the correlation id, see RpcCodec.
+     * @param handler called once with the outcome, must stay valid until then.
+     * @param timeoutUs 0 waits forever, ignored without a TimerWheel.
+     * @return correlation id, 0 if every slot is in use or the kernel refused the request (errno tells then).
+     */
+    RpcId Call(UInt16 method, const byte *arguments, SizeType size, RpcHandler *handler, UInt64 context = 0,
+               UInt64 timeoutUs = 0) {
+        assert(handler);
+        RpcId id = RpcClient::BeginRequest(size);
+        if (!id) {
+            return 0;
+        }
+        request.Append(arguments, size);
+        return RpcClient::FinishRequest(method, id, handler, context, timeoutUs);
+    }
+
+    RpcId Call(UInt16 method, const ByteArray &arguments, RpcHandler *handler, UInt64 context = 0,
+               UInt64 timeoutUs = 0) {
+        return RpcClient::Call(method, arguments.GetConstData(), arguments.GetSize(), handler, context, timeoutUs);
+    }
+
+    /**
+     * Call with typed arguments, packed by RpcCodec straight behind the id in the reused request.
+     */
+    template<typename ...Types>
+    RpcId Call(UInt16 method, const Tuple<Types...> &arguments, RpcHandler *handler, UInt64 context = 0,
+               UInt64 timeoutUs = 0) {
+        assert(handler);
+        RpcId id = RpcClient::BeginRequest(RpcCodec::GetPackedSize<Types...>());
+        if (!id) {
+            return 0;
+        }
+        RpcCodec::Pack(request, arguments);
+        return RpcClient::FinishRequest(method, id, handler, context, timeoutUs);
+    }
+
+    /**
+     * Call completing future, which must not be in use by another call.
+     */
+    RpcId Call(UInt16 method, const ByteArray &arguments, RpcFuture &future, UInt64 timeoutUs = 0) {
+        assert(!future.client || future.ready);
+        future.ready = false;
+        future.result.Empty();
+        future.id = RpcClient::Call(method, arguments, &future, 0, timeoutUs);
+        future.client = future.id ? this : nullptr;
+        return future.id;
+    }
+
+    /**
+     * Complete the call with Cancelled, a response arriving later is ignored.
+     * @return false if the call is already complete.
+     */
+    bool Cancel(RpcId id) {
+        if (!RpcClient::SlotOf(id)) {
+            return false;
+        }
+        ByteArray none;
+        RpcClient::Complete(id, RpcStatus::Cancelled, none);
+        return true;
+    }
+
+    /**
+     * Handle one datagram from the server.
+     * @return false if it is not a valid response, or the response of a call no longer pending.
+     */
+    bool OnDatagram(ByteArray &datagram) {
+        MessageHeader header{};
+        if (!MessageHeader::Parse(datagram, header) || !header.IsValid(datagram) ||
+            !header.flags.HasFlag(MessageFlag::Response) || header.payloadLength < RpcClient::IdSize + 1 ||
+            !header.IsChecksumValid(datagram)) {
+            return false;
+        }
+        datagram.ResetMark().IgnoreBytes(SizeType(MessageHeader::Size));
+        RpcId id = datagram.ReadSimpleValue<RpcId>();
+        RpcStatus status = RpcStatus(datagram.ReadByte());
+        if (!RpcClient::SlotOf(id)) {
+            return false;
+        }
+        RpcClient::Complete(id, status, datagram);
+        return true;
+    }
+
+    /**
+     * Handle every response already received, e.g. when the EventLoop reports the client readable.
+     * @return count of completed calls.
+     */
+    SizeType Poll(BufferPool &pool) {
+        SizeType completed = 0;
+        ByteArray datagram;
+        while (client.TryReceive(pool, datagram)) {
+            completed += RpcClient::OnDatagram(datagram);
+        }
+        return completed;
+    }
+
+#ifdef ESCAPIST_OS_LINUX
+
+    /**
+     * Block until future is complete, receiving responses (completing other calls too) and firing timers.
+     * The client must be non-blocking.
+     */
+    void Wait(RpcFuture &future, BufferPool &pool) {
+        while (!future.IsReady()) {
+            RpcClient::Poll(pool);
+            if (timers) {
+                timers->Advance();
+            }
+            if (future.IsReady()) {
+                break;
+            }
+            pollfd descriptor{client.GetHandle(), POLLIN, 0};
+            ::poll(&descriptor, 1, timers ? timers->GetTimeoutMs() : -1);
+        }
+    }
+
+#endif
+
+    void OnTimer(TimerId, UInt64 context) override {
+        Slot *slot = RpcClient::SlotOf(context);
+        if (slot) {
+            slot->timer = TimerWheel::InvalidId; // Fired, nothing to cancel.
+            ByteArray none;
+            RpcClient::Complete(context, RpcStatus::Timeout, none);
+        }
+    }
+
+    SizeType GetPendingCount() const noexcept {
+        return pendingCount;
+    }
+
+    SizeType GetCapacity() const noexcept {
+        return slots.GetSize();
+    }
+};
+
+RpcFuture::~RpcFuture() {
+    if (client && !ready) {
+        client->Cancel(id);
+    }
+}
+
+class RpcMethod {
+public:
+    virtual ~RpcMethod() = default;
+
+    /**
+     * @param arguments the request, its mark is at the first byte of the arguments.
+     * @param result to append the result to, empty when called.
+     * @return Ok, or Failed to report the call refused.
+     */
+    virtual RpcStatus OnCall(UInt16 method, ByteArray &arguments, ByteArray &result) = 0;
+};
+
+/**
+ * Answers requests of RpcClient by the method registered for their type, one flat table like
+ * MessageDispatcher. Requests are independent, so calls pipelined by a client are answered as they come.
+ */
+template<UInt16 MethodCount>
+class RpcServer {
+private:
+    DatagramServer &server;
+    RpcMethod *methods[MethodCount];
+    ByteArray result; // Reused by every call.
+    ByteArray response;
+
+public:
+    /**
+     * @param server must outlive this.
+     */
+    explicit RpcServer(DatagramServer &server) noexcept: server(server) {
+        for (UInt16 index = 0; index < MethodCount; ++index) {
+            methods[index] = nullptr;
+        }
+    }
+
+    /**
+     * @param handler must outlive the server, null unregisters method.
+     */
+    RpcServer &Register(UInt16 method, RpcMethod *handler) noexcept {
+        assert(method < MethodCount);
+        methods[method] = handler;
+        return *this;
+    }
+
+    /**
+     * Handle one request from peer and send its response.
+     * @return false if it was malformed or the kernel refused the response.
+     */
+    bool OnDatagram(const DatagramAddress &peer, ByteArray &datagram) {
+        MessageHeader header{};
+        if (!MessageHeader::Parse(datagram, header) || !header.IsValid(datagram) ||
+            header.flags.HasFlag(MessageFlag::Response) || header.payloadLength < sizeof(RpcId) ||
+            !header.IsChecksumValid(datagram)) {
+            return false;
+        }
+        datagram.ResetMark().IgnoreBytes(SizeType(MessageHeader::Size));
+        RpcId id = datagram.ReadSimpleValue<RpcId>();
+        RpcMethod *method = header.type < MethodCount ? methods[header.type] : nullptr;
+        RpcStatus status = RpcStatus::UnknownMethod;
+        result.Empty();
+        if (method) {
+            status = method->OnCall(header.type, datagram, result);
+        }
+        if (status != RpcStatus::Ok) {
+            result.Empty();
+        }
+        SizeType length = sizeof(RpcId) + 1 + result.GetSize();
+        response.Empty();
+        response.EnsureCapacity(MessageHeader::Size + length);
+        response.Append(byte(0), MessageHeader::Size);
+        response.WriteSimpleValue(id);
+        response.WriteByte(byte(status));
+        response.Append(result);
+        MessageHeader::Store(response.GetData(), header.type, Flag<MessageFlag>(MessageFlag::Response),
+                             UInt32(length), MessageHeader::Checksum(response.GetConstData() + MessageHeader::Size,
+                                                                     length));
+        return server.SendBatch(&response, &peer, 1) == 1;
+    }
+};
+
+#endif //ESCAPIST_RPC_H
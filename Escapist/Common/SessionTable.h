@@ -0,0 +1,482 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_SESSIONTABLE_H
+#define ESCAPIST_SESSIONTABLE_H
+
+#include "../General.h"
+#include "ArrayList.h"
+#include "BufferPool.h"
+#include "Socket.h"
+#include <atomic>
+
+/**
+ * Concurrent open-addressing table of per-peer state, keyed by DatagramAddress.\n
+ * Reads (Find, Touch) take no lock: every bucket is a seqlock, a reader copies the value and retries if a writer
+ * changed it meanwhile. Writes take the lock of one of ShardCount shards only.\n
+ * A shard grows online: a larger table is published at once and the old one is moved over a few buckets at a
+ * time by every later write, while readers look in both. A moved bucket is copied before it is tombstoned, so a
+ * reader missing it in the old table finds it by looking in the new one again. Old tables are freed once no
+ * reader that could have seen them is still inside (epochs per thread, see EscapistPrivate::GetThreadIndex).\n
+ * Idle entries are evicted by EvictIdle, to be called periodically from a background thread or timer.
+ * @tparam V per-peer state, trivially copyable since it lives in ArrayList storage and is copied out by readers.
+ */
+template<typename V>
+class SessionTable {
+    static_assert(std::is_trivially_copyable<V>::value, "V must be trivially copyable!");
+
+public:
+    static constexpr int ShardCount = 16; // Power of two.
+    static constexpr SizeType MinimumShardCapacity = 16; // Power of two.
+    static constexpr SizeType MigrationStep = 32; // Buckets moved by every write while a shard grows.
+
+private:
+    static constexpr UInt64 EmptyKey = 0;
+    static constexpr UInt64 TombstoneKey = ~UInt64(0);
+
+    struct Bucket {
+        UInt64 key; // EmptyKey -> peer key -> TombstoneKey, never back.
+        UInt64 lastSeen;
+        UInt32 version; // Odd while a writer changes value.
+        V value;
+    };
+
+    struct Table {
+        ArrayList<Bucket> buckets;
+        Bucket *data;
+        SizeType mask;
+        SizeType used = 0; // Live and tombstoned buckets.
+
+        explicit Table(SizeType capacity) {
+            buckets.Assign(Bucket(), capacity);
+            data = buckets.GetData();
+            mask = capacity - 1;
+        }
+    };
+
+    struct alignas(64) Shard {
+        std::atomic<Table *> current{nullptr};
+        std::atomic<Table *> previous{nullptr}; // Being moved to current, null if not growing.
+        SizeType migrated = 0; // Buckets of previous already moved.
+        std::atomic<SizeType> count{0};
+        std::atomic_flag lock = ATOMIC_FLAG_INIT;
+    };
+
+    struct alignas(64) ReaderEpoch {
+        std::atomic<UInt64> epoch{0}; // 0 if the thread is not reading.
+    };
+
+    struct Retired {
+        Table *table;
+        UInt64 epoch;
+    };
+
+    Shard shards[SessionTable::ShardCount];
+    ReaderEpoch readers[EscapistPrivate::MaximumPoolThreads];
+    std::atomic<int> unslottedReaders{0}; // Threads beyond MaximumPoolThreads.
+    std::atomic<UInt64> globalEpoch{1};
+    ArrayList<Retired> retired;
+    std::atomic_flag retiredLock = ATOMIC_FLAG_INIT;
+
+    /**
+     * Marks the calling thread as reading for its lifetime, tables it can reach are not freed meanwhile.
+     */
+    class ReadGuard {
+    private:
+        SessionTable<V> &table;
+        int thread;
+
+    public:
+        explicit ReadGuard(SessionTable<V> &table) noexcept: table(table), thread(EscapistPrivate::GetThreadIndex()) {
+            if (thread < EscapistPrivate::MaximumPoolThreads) {
+                table.readers[thread].epoch.store(table.globalEpoch.load(std::memory_order_seq_cst),
+                                                  std::memory_order_seq_cst);
+            } else {
+                table.unslottedReaders.fetch_add(1, std::memory_order_seq_cst);
+            }
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        ~ReadGuard() {
+            if (thread < EscapistPrivate::MaximumPoolThreads) {
+                table.readers[thread].epoch.store(0, std::memory_order_release);
+            } else {
+                table.unslottedReaders.fetch_sub(1, std::memory_order_release);
+            }
+        }
+    };
+
+    static UInt64 ToKey(const DatagramAddress &peer) noexcept {
+        UInt32 ip;
+        ::memcpy(&ip, peer.ipAddress, 4);
+        return (UInt64(1) << 62) | (UInt64(ip) << 16) | peer.port; // Never EmptyKey nor TombstoneKey.
+    }
+
+    static UInt64 Hash(UInt64 key) noexcept { // splitmix64 finalizer.
+        key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ull;
+        key = (key ^ (key >> 27)) * 0x94D049BB133111EBull;
+        return key ^ (key >> 31);
+    }
+
+    Shard &ShardOf(UInt64 hash) noexcept {
+        return shards[hash >> 60 & (SessionTable::ShardCount - 1)];
+    }
+
+    static void Lock(Shard &shard) noexcept {
+        while (shard.lock.test_and_set(std::memory_order_acquire));
+    }
+
+    static void Unlock(Shard &shard) noexcept {
+        shard.lock.clear(std::memory_order_release);
+    }
+
+    /**
+     * Lock-free lookup in one table.
+     * @return the bucket holding key, null if there is none.
+     */
+    static Bucket *Load(Table *table, UInt64 key, UInt64 hash, V *value) noexcept {
+        for (SizeType probe = 0; probe <= table->mask; ++probe) {
+            Bucket &each = table->data[(hash + probe) & table->mask];
+            for (;;) {
+                UInt32 before = __atomic_load_n(&each.version, __ATOMIC_ACQUIRE);
+                UInt64 found = __atomic_load_n(&each.key, __ATOMIC_ACQUIRE);
+                if (found == SessionTable::EmptyKey) {
+                    return nullptr;
+                }
+                if (found != key) {
+                    break;
+                }
+                if (value) {
+                    ::memcpy((void *) value, (const void *) &each.value, sizeof(V));
+                }
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                if (!(before & 1) && __atomic_load_n(&each.version, __ATOMIC_RELAXED) == before) {
+                    return &each;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * Current, then previous, then current again: a bucket moved meanwhile is in current by the time it is
+     * tombstoned in previous.
+     */
+    Bucket *LoadAny(Shard &shard, UInt64 key, UInt64 hash, V *value) noexcept {
+        Bucket *bucket = SessionTable::Load(shard.current.load(std::memory_order_acquire), key, hash, value);
+        if (!bucket) {
+            Table *previous = shard.previous.load(std::memory_order_acquire);
+            if (previous) {
+                bucket = SessionTable::Load(previous, key, hash, value);
+                if (!bucket) {
+                    bucket = SessionTable::Load(shard.current.load(std::memory_order_acquire), key, hash, value);
+                }
+            }
+        }
+        return bucket;
+    }
+
+    /**
+     * Probe under the shard lock.
+     * @return the bucket holding key, otherwise the first empty one, null if the table is full.
+     */
+    static Bucket *Probe(Table *table, UInt64 key, UInt64 hash) noexcept {
+        for (SizeType probe = 0; probe <= table->mask; ++probe) {
+            Bucket &each = table->data[(hash + probe) & table->mask];
+            if (each.key == key || each.key == SessionTable::EmptyKey) {
+                return &each;
+            }
+        }
+        return nullptr;
+    }
+
+    static void WriteValue(Bucket &bucket, const V &value) noexcept {
+        UInt32 version = bucket.version;
+        __atomic_store_n(&bucket.version, version + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        ::memcpy((void *) &bucket.value, (const void *) &value, sizeof(V));
+        __atomic_store_n(&bucket.version, version + 2, __ATOMIC_RELEASE);
+    }
+
+    static void Publish(Table *table, Bucket &bucket, UInt64 key, const V &value, UInt64 lastSeen) noexcept {
+        ::memcpy((void *) &bucket.value, (const void *) &value, sizeof(V));
+        __atomic_store_n(&bucket.lastSeen, lastSeen, __ATOMIC_RELAXED);
+        __atomic_store_n(&bucket.key, key, __ATOMIC_RELEASE);
+        ++table->used;
+    }
+
+    static void Tombstone(Bucket &bucket) noexcept {
+        UInt32 version = bucket.version;
+        __atomic_store_n(&bucket.version, version + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        __atomic_store_n(&bucket.key, SessionTable::TombstoneKey, __ATOMIC_RELAXED);
+        __atomic_store_n(&bucket.version, version + 2, __ATOMIC_RELEASE);
+    }
+
+    /**
+     * Copy a live bucket of previous to current, then tombstone it.
+     */
+    static void Move(Table *current, Bucket &bucket) noexcept {
+        Bucket *target = SessionTable::Probe(current, bucket.key, SessionTable::Hash(bucket.key));
+        assert(target && target->key == SessionTable::EmptyKey);
+        SessionTable::Publish(current, *target, bucket.key, bucket.value,
+                              __atomic_load_n(&bucket.lastSeen, __ATOMIC_RELAXED));
+        SessionTable::Tombstone(bucket);
+    }
+
+    void Migrate(Shard &shard, SizeType step) {
+        Table *previous = shard.previous.load(std::memory_order_relaxed);
+        if (!previous) {
+            return;
+        }
+        Table *current = shard.current.load(std::memory_order_relaxed);
+        for (; step && shard.migrated <= previous->mask; --step, ++shard.migrated) {
+            Bucket &each = previous->data[shard.migrated];
+            if (each.key != SessionTable::EmptyKey && each.key != SessionTable::TombstoneKey) {
+                SessionTable::Move(current, each);
+            }
+        }
+        if (shard.migrated > previous->mask) {
+            shard.previous.store(nullptr, std::memory_order_seq_cst);
+            SessionTable::Retire(previous);
+        }
+    }
+
+    /**
+     * Make room for one more bucket in current, growing (or purging tombstones) once it is 3/4 used.
+     */
+    void Reserve(Shard &shard) {
+        Table *current = shard.current.load(std::memory_order_relaxed);
+        if ((current->used + 1) * 4 <= (current->mask + 1) * 3) {
+            return;
+        }
+        SessionTable::Migrate(shard, ~SizeType(0));
+        SizeType capacity = current->mask + 1;
+        while (shard.count.load(std::memory_order_relaxed) * 2 >= capacity) {
+            capacity *= 2;
+        }
+        shard.migrated = 0;
+        shard.previous.store(current, std::memory_order_seq_cst);
+        shard.current.store(new Table(capacity), std::memory_order_seq_cst);
+    }
+
+    void Retire(Table *table) {
+        UInt64 epoch = globalEpoch.fetch_add(1, std::memory_order_seq_cst);
+        while (retiredLock.test_and_set(std::memory_order_acquire));
+        retired.Append(Retired{table, epoch});
+        retiredLock.clear(std::memory_order_release);
+        SessionTable::Reclaim();
+    }
+
+    /**
+     * Free retired tables that no reader can still be looking at.
+     */
+    void Reclaim() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (unslottedReaders.load(std::memory_order_seq_cst)) {
+            return;
+        }
+        UInt64 oldest = ~UInt64(0);
+        for (int index = 0; index < EscapistPrivate::MaximumPoolThreads; ++index) {
+            UInt64 epoch = readers[index].epoch.load(std::memory_order_seq_cst);
+            if (epoch && epoch < oldest) {
+                oldest = epoch;
+            }
+        }
+        while (retiredLock.test_and_set(std::memory_order_acquire));
+        for (SizeType index = retired.GetSize(); index-- > 0;) {
+            Retired each = retired.GetConstAt(index);
+            if (each.epoch < oldest) {
+                delete each.table;
+                retired.Delete(index, 1);
+            }
+        }
+        retiredLock.clear(std::memory_order_release);
+    }
+
+    /**
+     * Under the shard lock, bring key over from previous so that it is only changed in current.
+     */
+    Bucket *Locate(Shard &shard, UInt64 key, UInt64 hash) {
+        SessionTable::Migrate(shard, SessionTable::MigrationStep);
+        Table *previous = shard.previous.load(std::memory_order_relaxed);
+        if (previous) {
+            Bucket *old = SessionTable::Probe(previous, key, hash);
+            if (old && old->key == key) {
+                SessionTable::Move(shard.current.load(std::memory_order_relaxed), *old);
+            }
+        }
+        return SessionTable::Probe(shard.current.load(std::memory_order_relaxed), key, hash);
+    }
+
+    SizeType EvictIdle(Table *table, UInt64 now, UInt64 idle) noexcept {
+        SizeType evicted = 0;
+        for (SizeType index = 0; index <= table->mask; ++index) {
+            Bucket &each = table->data[index];
+            if (each.key != SessionTable::EmptyKey && each.key != SessionTable::TombstoneKey &&
+                now - __atomic_load_n(&each.lastSeen, __ATOMIC_RELAXED) >= idle) {
+                SessionTable::Tombstone(each);
+                ++evicted;
+            }
+        }
+        return evicted;
+    }
+
+public:
+    /**
+     * @param capacity expected count of peers, tables grow beyond it anyway.
+     */
+    explicit SessionTable(SizeType capacity = 0) {
+        SizeType each = SessionTable::MinimumShardCapacity;
+        while (each * SessionTable::ShardCount < capacity * 2) {
+            each *= 2;
+        }
+        for (Shard &shard: shards) {
+            shard.current.store(new Table(each), std::memory_order_relaxed);
+        }
+    }
+
+    SessionTable(const SessionTable &other) = delete;
+
+    /**
+     * No reader or writer may be inside any more.
+     */
+    ~SessionTable() {
+        for (Shard &shard: shards) {
+            delete shard.current.load(std::memory_order_relaxed);
+            delete shard.previous.load(std::memory_order_relaxed);
+        }
+        for (SizeType index = 0; index < retired.GetSize(); ++index) {
+            delete retired.GetConstAt(index).table;
+        }
+    }
+
+    /**
+     * Lock-free lookup.
+     * @param value receives a consistent copy of the state of peer.
+     * @return false if peer is unknown.
+     */
+    bool Find(const DatagramAddress &peer, V &value) {
+        UInt64 key = SessionTable::ToKey(peer);
+        UInt64 hash = SessionTable::Hash(key);
+        ReadGuard guard(*this);
+        return SessionTable::LoadAny(SessionTable::ShardOf(hash), key, hash, &value) != nullptr;
+    }
+
+    /**
+     * Lock-free refresh of the last-seen time of peer, meant for every packet.
+     * A touch racing with a concurrent move to a grown table can be lost, evicting the peer one period early at worst.
+     * @return false if peer is unknown.
+     */
+    bool Touch(const DatagramAddress &peer, UInt64 now) {
+        UInt64 key = SessionTable::ToKey(peer);
+        UInt64 hash = SessionTable::Hash(key);
+        ReadGuard guard(*this);
+        Bucket *bucket = SessionTable::LoadAny(SessionTable::ShardOf(hash), key, hash, nullptr);
+        if (!bucket) {
+            return false;
+        }
+        __atomic_store_n(&bucket->lastSeen, now, __ATOMIC_RELAXED);
+        return true;
+    }
+
+    /**
+     * Insert or replace the state of peer, and refresh its last-seen time.
+     * @return true if peer was new.
+     */
+    bool Put(const DatagramAddress &peer, const V &value, UInt64 now) {
+        UInt64 key = SessionTable::ToKey(peer);
+        UInt64 hash = SessionTable::Hash(key);
+        Shard &shard = SessionTable::ShardOf(hash);
+        SessionTable::Lock(shard);
+        Bucket *bucket = SessionTable::Locate(shard, key, hash);
+        bool inserted = !bucket || bucket->key != key;
+        if (inserted) {
+            SessionTable::Reserve(shard);
+            Table *current = shard.current.load(std::memory_order_relaxed);
+            bucket = SessionTable::Probe(current, key, hash);
+            SessionTable::Publish(current, *bucket, key, value, now);
+            shard.count.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            SessionTable::WriteValue(*bucket, value);
+            __atomic_store_n(&bucket->lastSeen, now, __ATOMIC_RELAXED);
+        }
+        SessionTable::Unlock(shard);
+        return inserted;
+    }
+
+    /**
+     * Change the state of peer in place, under the lock of its shard.
+     * @param update called as update(V &value), readers see either the old or the new value.
+     * @return false if peer is unknown, update is not called then.
+     */
+    template<typename F>
+    bool Update(const DatagramAddress &peer, F update) {
+        UInt64 key = SessionTable::ToKey(peer);
+        UInt64 hash = SessionTable::Hash(key);
+        Shard &shard = SessionTable::ShardOf(hash);
+        SessionTable::Lock(shard);
+        Bucket *bucket = SessionTable::Locate(shard, key, hash);
+        bool found = bucket && bucket->key == key;
+        if (found) {
+            V value = bucket->value;
+            update(value);
+            SessionTable::WriteValue(*bucket, value);
+        }
+        SessionTable::Unlock(shard);
+        return found;
+    }
+
+    /**
+     * @return false if peer is unknown.
+     */
+    bool Remove(const DatagramAddress &peer) {
+        UInt64 key = SessionTable::ToKey(peer);
+        UInt64 hash = SessionTable::Hash(key);
+        Shard &shard = SessionTable::ShardOf(hash);
+        SessionTable::Lock(shard);
+        Bucket *bucket = SessionTable::Locate(shard, key, hash);
+        bool found = bucket && bucket->key == key;
+        if (found) {
+            SessionTable::Tombstone(*bucket);
+            shard.count.fetch_sub(1, std::memory_order_relaxed);
+        }
+        SessionTable::Unlock(shard);
+        return found;
+    }
+
+    /**
+     * Remove every peer not seen for idle microseconds, one shard at a time, readers are never blocked.
+     * @return count of evicted peers.
+     */
+    SizeType EvictIdle(UInt64 now, UInt64 idle) {
+        SizeType evicted = 0;
+        for (Shard &shard: shards) {
+            SessionTable::Lock(shard);
+            SizeType each = SessionTable::EvictIdle(shard.current.load(std::memory_order_relaxed), now, idle);
+            Table *previous = shard.previous.load(std::memory_order_relaxed);
+            if (previous) {
+                each += SessionTable::EvictIdle(previous, now, idle);
+            }
+            shard.count.fetch_sub(each, std::memory_order_relaxed);
+            SessionTable::Unlock(shard);
+            evicted += each;
+        }
+        SessionTable::Reclaim();
+        return evicted;
+    }
+
+    /**
+     * @return count of peers, only a snapshot while writers are active.
+     */
+    SizeType GetSize() const noexcept {
+        SizeType size = 0;
+        for (const Shard &shard: shards) {
+            size += shard.count.load(std::memory_order_relaxed);
+        }
+        return size;
+    }
+};
+
+#endif //ESCAPIST_SESSIONTABLE_H
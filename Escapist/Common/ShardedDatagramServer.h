@@ -0,0 +1,162 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_SHARDEDDATAGRAMSERVER_H
+#define ESCAPIST_SHARDEDDATAGRAMSERVER_H
+
+#include "../General.h"
+#include "Socket.h"
+#include "DatagramEngine.h"
+#include "Thread.h"
+
+#ifdef ESCAPIST_OS_LINUX
+
+#include <cstdio>
+
+/**
+ * One SO_REUSEPORT socket per worker, each worker runs its own DatagramEngine on its own pinned core.\n
+ * The kernel spreads datagrams among shards; with steering enabled, a classic BPF program hashes the source
+ * address and port, so a given peer always lands on the same shard.
+ */
+class ShardedDatagramServer {
+private:
+    struct Shard : public Thread {
+        DatagramServer server;
+        DatagramEngine *engine = nullptr;
+        DatagramReceiver *receiver = nullptr;
+        bool started = false;
+
+        void Run() override {
+            engine->Run();
+        }
+    };
+
+    Shard *shards;
+    int shardCount;
+    DatagramBackend backend;
+
+    /**
+     * hash = ((srcIp ^ srcPort) * 2654435761) >> 16, then modulo count of shards.\n
+     * Offsets are relative to the IPv4 header, which is assumed to carry no options.
+     */
+    bool AttachSteeringProgram() {
+        sock_filter program[] = {
+                BPF_STMT(BPF_LD | BPF_W | BPF_ABS, (UInt32) (SKF_NET_OFF + 12)), // Source address.
+                BPF_STMT(BPF_MISC | BPF_TAX, 0),
+                BPF_STMT(BPF_LD | BPF_H | BPF_ABS, (UInt32) (SKF_NET_OFF + 20)), // Source port.
+                BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),
+                BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, 2654435761u),
+                BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 16),
+                BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, (UInt32) shardCount),
+                BPF_STMT(BPF_RET | BPF_A, 0),
+        };
+        // The program belongs to the whole group, attaching it to one socket is enough.
+        return shards[0].server.AttachReusePortProgram(program, sizeof(program) / sizeof(sock_filter));
+    }
+
+public:
+    /**
+     * @param count count of shards, 0 means one per online core.
+     * @param backend backend of every shard's engine, falls back the same way as DatagramEngine::Create.
+     */
+    explicit ShardedDatagramServer(int count = 0, DatagramBackend backend = DatagramBackend::IoUring)
+            : shardCount(count), backend(backend) {
+        if (shardCount <= 0) {
+            shardCount = OS::GetCoreCount();
+        }
+        shards = new Shard[shardCount];
+        for (int index = 0; index < shardCount; ++index) {
+            char name[16]; // Thread names hold 15 characters, shards beyond that keep the name of the process.
+            if (::snprintf(name, sizeof(name), "msggo-shard-%d", index) < int(sizeof(name))) {
+                shards[index].SetName(name);
+            }
+            shards[index].server.SetReusePort(true);
+        }
+    }
+
+    ShardedDatagramServer(const ShardedDatagramServer &other) = delete;
+
+    ~ShardedDatagramServer() {
+        ShardedDatagramServer::Stop();
+        for (int index = 0; index < shardCount; ++index) {
+            delete shards[index].engine;
+        }
+        delete[] shards;
+    }
+
+    int GetShardCount() const noexcept {
+        return shardCount;
+    }
+
+    DatagramServer &GetServer(int index) noexcept {
+        assert(index >= 0 && index < shardCount);
+        return shards[index].server;
+    }
+
+    /**
+     * Bind every shard to the same address and port.
+     * @param steerByPeer attach the hashing program, otherwise the kernel's own flow hash is used.
+     * @return false if steering was requested but the kernel rejected the program.
+     */
+    bool Bind(const char *ipAddr, int port, bool steerByPeer = true) {
+        for (int index = 0; index < shardCount; ++index) {
+            shards[index].server.Bind(ipAddr, port);
+        }
+        return !steerByPeer || ShardedDatagramServer::AttachSteeringProgram();
+    }
+
+    /**
+     * Start one worker per shard.
+     * @param receivers one receiver per shard, each is only called by its own worker.
+     * Receivers are bound by the first Start, a restart must pass the same ones (engines can't drop a socket).
+     * @param pinCores pin shard i to core (i % online cores).
+     */
+    ShardedDatagramServer &Start(DatagramReceiver *const *receivers, bool pinCores = true) {
+        int cores = OS::GetCoreCount();
+        for (int index = 0; index < shardCount; ++index) {
+            Shard &shard = shards[index];
+            assert(!shard.started && receivers[index]);
+            assert(!shard.engine || shard.receiver == receivers[index]);
+            shard.ClearAffinity();
+            if (pinCores) {
+                shard.SetAffinity(index % cores);
+            }
+            if (!shard.engine) {
+                shard.receiver = receivers[index];
+                shard.engine = DatagramEngine::Create(backend);
+                bool added = shard.engine->Add(shard.server, shard.receiver);
+                assert(added);
+            }
+            shard.started = shard.Start();
+            if (!shard.started && pinCores) { // The core is outside the cpuset of the process, run unpinned.
+                shard.ClearAffinity();
+                shard.started = shard.Start();
+            }
+            assert(shard.started);
+        }
+        return *this;
+    }
+
+    /**
+     * Stop and join every worker.
+     */
+    ShardedDatagramServer &Stop() {
+        for (int index = 0; index < shardCount; ++index) {
+            if (shards[index].started) {
+                shards[index].engine->Stop();
+            }
+        }
+        for (int index = 0; index < shardCount; ++index) {
+            if (shards[index].started) {
+                shards[index].Wait();
+                shards[index].started = false;
+            }
+        }
+        return *this;
+    }
+};
+
+#endif
+
+#endif //ESCAPIST_SHARDEDDATAGRAMSERVER_H
@@ -0,0 +1,467 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_SHAREDMEMORY_H
+#define ESCAPIST_SHAREDMEMORY_H
+
+#include "../General.h"
+#include "ByteArray.h"
+#include "BufferPool.h"
+#include <atomic>
+
+#ifdef ESCAPIST_OS_LINUX
+
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <ctime>
+
+namespace EscapistPrivate {
+    /**
+     * Head of the shared region, the ring data follows at SharedRing::DataOffset.
+     * Atomics of a lock-free width are address-free, so they work across processes.
+     */
+    struct SharedRingControl {
+        UInt64 magic;
+        UInt64 capacity;
+        alignas(64) std::atomic<UInt64> tail; // Reserved by producers.
+        alignas(64) std::atomic<UInt64> head; // Consumed by the consumer.
+        alignas(64) std::atomic<UInt32> signal; // Futex word, bumped to wake the consumer.
+        std::atomic<UInt32> waiting; // The consumer sleeps or is about to.
+    };
+
+    /**
+     * Multi-producer, single-consumer ring of variable-size records in a shared mapping.\n
+     * Record: [header:4][payload][padding to 8]. A producer reserves space by CAS on tail, copies its payload and
+     * commits by storing the header (length | Committed) with release. The consumer reads records at head in order,
+     * zeroes them (so a header that is not committed yet reads as 0) and advances head. A record never wraps:
+     * if it doesn't fit before the end, the rest is filled by a Padding record.\n
+     * Producers are trusted: one dying between its reservation and its commit leaves a header that stays 0, its
+     * length is not known to anyone else, so the consumer can't skip it and every later record is stuck behind it.
+     * Skipping after a timeout would not be safe either, a producer that is merely descheduled would later write
+     * into space handed to others. IsStalled tells the consumer, the way out is a new ring.
+     */
+    class SharedRing {
+    public:
+        static constexpr UInt64 Magic = 0x474E495247534D31ull; // "1MSGRING"
+        static constexpr SizeType DataOffset = (sizeof(SharedRingControl) + 63) / 64 * 64;
+        static constexpr UInt32 Committed = 0x80000000u;
+        static constexpr UInt32 Padding = 0x40000000u;
+        static constexpr UInt32 LengthMask = 0x3FFFFFFFu;
+        static constexpr SizeType RecordHeaderSize = sizeof(UInt32);
+
+    private:
+        int hMemory = -1;
+        void *mapping = nullptr;
+        SizeType mappingSize = 0;
+        SharedRingControl *control = nullptr;
+        byte *data = nullptr;
+        UInt64 mask = 0;
+
+        static SizeType Align(SizeType size) noexcept {
+            return (size + 7) & ~SizeType(7);
+        }
+
+        UInt32 *HeaderAt(UInt64 position) const noexcept {
+            return (UInt32 *) (data + (position & mask));
+        }
+
+        static long Futex(std::atomic<UInt32> *word, int operation, UInt32 value, const timespec *timeout) noexcept {
+            return ::syscall(SYS_futex, (UInt32 *) word, operation, value, timeout, nullptr, 0);
+        }
+
+        bool Map(int hMemory, SizeType size) noexcept {
+            void *address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, hMemory, 0);
+            if (address == MAP_FAILED) {
+                return false;
+            }
+            mapping = address;
+            mappingSize = size;
+            control = (SharedRingControl *) address;
+            data = (byte *) address + SharedRing::DataOffset;
+            return true;
+        }
+
+    public:
+        SharedRing() = default;
+
+        SharedRing(const SharedRing &other) = delete;
+
+        ~SharedRing() {
+            SharedRing::Close();
+        }
+
+        /**
+         * Size and initialize the region of hMemory for a ring of capacity bytes, then map it.
+         * The ring owns hMemory afterwards, it is closed on failure too.
+         * @param capacity power of two.
+         */
+        bool Initialize(int hMemory, SizeType capacity) noexcept {
+            assert(capacity >= 64 && !(capacity & (capacity - 1)));
+            SharedRing::Close();
+            this->hMemory = hMemory;
+            SizeType size = SharedRing::DataOffset + capacity;
+            if (::ftruncate(hMemory, (off_t) size) != 0 || !SharedRing::Map(hMemory, size)) {
+                SharedRing::Close();
+                return false;
+            }
+            new(control) SharedRingControl();
+            control->capacity = capacity;
+            control->tail.store(0, std::memory_order_relaxed);
+            control->head.store(0, std::memory_order_relaxed);
+            control->signal.store(0, std::memory_order_relaxed);
+            control->waiting.store(0, std::memory_order_relaxed);
+            __atomic_store_n(&control->magic, SharedRing::Magic, __ATOMIC_RELEASE);
+            mask = capacity - 1;
+            return true;
+        }
+
+        /**
+         * Map a region initialized by another process.
+         * The ring owns hMemory afterwards, it is closed on failure too.
+         */
+        bool Attach(int hMemory) noexcept {
+            SharedRing::Close();
+            this->hMemory = hMemory;
+            struct stat status{};
+            if (::fstat(hMemory, &status) != 0 || SizeType(status.st_size) <= SharedRing::DataOffset ||
+                !SharedRing::Map(hMemory, SizeType(status.st_size))) {
+                SharedRing::Close();
+                return false;
+            }
+            UInt64 capacity = control->capacity;
+            if (__atomic_load_n(&control->magic, __ATOMIC_ACQUIRE) != SharedRing::Magic || capacity < 64 ||
+                (capacity & (capacity - 1)) || capacity + SharedRing::DataOffset > mappingSize) {
+                SharedRing::Close();
+                return false;
+            }
+            mask = capacity - 1;
+            return true;
+        }
+
+        void Close() noexcept {
+            if (mapping) {
+                ::munmap(mapping, mappingSize);
+                mapping = nullptr;
+                control = nullptr;
+                data = nullptr;
+            }
+            if (hMemory != -1) {
+                ::close(hMemory);
+                hMemory = -1;
+            }
+        }
+
+        int GetHandle() const noexcept {
+            return hMemory;
+        }
+
+        bool IsOpen() const noexcept {
+            return control != nullptr;
+        }
+
+        /**
+         * Largest payload of a record, a quarter of the ring so that a padded record always fits an empty ring.
+         */
+        SizeType GetMaximumMessageSize() const noexcept {
+            return SizeType(mask + 1) / 4 - SharedRing::RecordHeaderSize;
+        }
+
+        /**
+         * Copy a record in and wake the consumer if it sleeps. Safe from any count of producers.
+         * @return false with errno EAGAIN if the ring is full, EMSGSIZE if size is too large.
+         */
+        bool Write(const void *payload, SizeType size) noexcept {
+            if (size > SharedRing::GetMaximumMessageSize()) {
+                errno = EMSGSIZE;
+                return false;
+            }
+            UInt64 capacity = mask + 1;
+            UInt64 needed = SharedRing::Align(SharedRing::RecordHeaderSize + size);
+            UInt64 tail = control->tail.load(std::memory_order_relaxed);
+            UInt64 padding;
+            do {
+                UInt64 head = control->head.load(std::memory_order_acquire);
+                UInt64 rest = capacity - (tail & mask);
+                padding = rest < needed ? rest : 0;
+                if (tail + padding + needed - head > capacity) {
+                    errno = EAGAIN;
+                    return false;
+                }
+            } while (!control->tail.compare_exchange_weak(tail, tail + padding + needed, std::memory_order_relaxed));
+            if (padding) {
+                UInt32 value = SharedRing::Committed | SharedRing::Padding | UInt32(padding);
+                __atomic_store_n(SharedRing::HeaderAt(tail), value, __ATOMIC_RELEASE);
+                tail += padding;
+            }
+            UInt32 *header = SharedRing::HeaderAt(tail);
+            ::memcpy(header + 1, payload, size);
+            __atomic_store_n(header, SharedRing::Committed | UInt32(size), __ATOMIC_RELEASE);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (control->waiting.load(std::memory_order_relaxed)) {
+                control->waiting.store(0, std::memory_order_relaxed);
+                control->signal.fetch_add(1, std::memory_order_release);
+                SharedRing::Futex(&control->signal, FUTEX_WAKE, 1, nullptr);
+            }
+            return true;
+        }
+
+        /**
+         * Copy the oldest record out by assign, only the single consumer may call it.
+         * @return false if the ring is empty, or the oldest record is not committed yet.
+         */
+        template<typename Assign>
+        bool Read(Assign assign) noexcept {
+            UInt64 head = control->head.load(std::memory_order_relaxed);
+            for (;;) {
+                UInt32 *header = SharedRing::HeaderAt(head);
+                UInt32 value = __atomic_load_n(header, __ATOMIC_ACQUIRE);
+                if (!(value & SharedRing::Committed)) {
+                    return false;
+                }
+                SizeType length = value & SharedRing::LengthMask;
+                if (value & SharedRing::Padding) {
+                    ::memset(header, 0, length);
+                    head += length;
+                    control->head.store(head, std::memory_order_release);
+                    continue;
+                }
+                assign((const byte *) (header + 1), length);
+                SizeType total = SharedRing::Align(SharedRing::RecordHeaderSize + length);
+                ::memset(header, 0, total);
+                control->head.store(head + total, std::memory_order_release);
+                return true;
+            }
+        }
+
+        /**
+         * @return true if the oldest record is reserved but not committed yet: a producer is copying it, or died
+         * doing so if it stays that way.
+         */
+        bool IsStalled() const noexcept {
+            UInt64 head = control->head.load(std::memory_order_relaxed);
+            return control->tail.load(std::memory_order_acquire) != head &&
+                   !(__atomic_load_n(SharedRing::HeaderAt(head), __ATOMIC_ACQUIRE) & SharedRing::Committed);
+        }
+
+        /**
+         * Sleep on the futex until a producer commits, unless a record is already there.
+         * @param timeoutMs -1 to wait forever.
+         */
+        void Wait(int timeoutMs) noexcept {
+            UInt32 signal = control->signal.load(std::memory_order_acquire);
+            control->waiting.store(1, std::memory_order_seq_cst);
+            UInt64 head = control->head.load(std::memory_order_relaxed);
+            if (__atomic_load_n(SharedRing::HeaderAt(head), __ATOMIC_ACQUIRE) & SharedRing::Committed) {
+                control->waiting.store(0, std::memory_order_relaxed);
+                return;
+            }
+            timespec timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1000000L};
+            SharedRing::Futex(&control->signal, FUTEX_WAIT, signal, timeoutMs < 0 ? nullptr : &timeout);
+            control->waiting.store(0, std::memory_order_relaxed);
+        }
+    };
+}
+
+/**
+ * Producer side of a same-host transport, with the send surface of DatagramClient.\n
+ * Messages are copied into a ring in shared memory created by a SharedMemoryServer, several clients (in any
+ * processes) can send to the same server. A full ring refuses like a full non-blocking socket: OS::WouldBlock()
+ * is true after a false or short send.
+ */
+class SharedMemoryClient {
+private:
+    EscapistPrivate::SharedRing ring;
+
+public:
+    SharedMemoryClient() = default;
+
+    explicit SharedMemoryClient(const char *name) {
+        bool succeeded = SharedMemoryClient::Connect(name);
+        assert(succeeded);
+    }
+
+    SharedMemoryClient(const SharedMemoryClient &other) = delete;
+
+    /**
+     * Attach to the ring a server bound to name.
+     * @return false if there is no such ring.
+     */
+    bool Connect(const char *name) {
+        int hMemory = ::shm_open(name, O_RDWR, 0);
+        if (hMemory == -1) {
+            return false;
+        }
+        return ring.Attach(hMemory);
+    }
+
+    /**
+     * Attach to an anonymous ring, hMemory is a duplicate of SharedMemoryServer::GetHandle() (by fork or SCM_RIGHTS).
+     * The client owns hMemory afterwards, it is closed on failure too.
+     */
+    bool Connect(int hMemory) {
+        return ring.Attach(hMemory);
+    }
+
+    bool IsConnected() const noexcept {
+        return ring.IsOpen();
+    }
+
+    SizeType GetMaximumMessageSize() const noexcept {
+        return ring.GetMaximumMessageSize();
+    }
+
+    bool Send(const void *data, SizeType size) {
+        assert(ring.IsOpen());
+        return ring.Write(data, size);
+    }
+
+    bool Send(const ByteArray &data) {
+        return SharedMemoryClient::Send(data.GetConstData(), data.GetSize());
+    }
+
+    /**
+     * @return count of messages written, the rest is to be sent again by the caller.
+     */
+    int Send(const ByteArray *data, int count) {
+        assert(data && count >= 0);
+        int sent = 0;
+        while (sent < count && SharedMemoryClient::Send(data[sent])) {
+            ++sent;
+        }
+        return sent;
+    }
+};
+
+/**
+ * Consumer side of a same-host transport, with the receive surface of DatagramServer.\n
+ * Owns the ring, a single thread receives from it. Receive sleeps on a futex in the ring, producers only make
+ * the wake-up syscall while the consumer actually sleeps, so a busy ring costs no syscall at all.
+ */
+class SharedMemoryServer {
+public:
+    static constexpr SizeType DefaultCapacity = 1 << 20;
+
+private:
+    EscapistPrivate::SharedRing ring;
+    char name[256] = {0}; // Unlinked on destruction if the ring has a name.
+
+public:
+    SharedMemoryServer() = default;
+
+    SharedMemoryServer(const SharedMemoryServer &other) = delete;
+
+    ~SharedMemoryServer() {
+        if (name[0]) {
+            ::shm_unlink(name);
+        }
+    }
+
+    /**
+     * Create a ring reachable by name (shm_open, e.g. "/msggo-orders"), replacing a stale ring of the same name.
+     * @param capacity bytes of the ring, power of two.
+     */
+    bool Bind(const char *name, SizeType capacity = SharedMemoryServer::DefaultCapacity) {
+        assert(name && ::strlen(name) < sizeof(this->name));
+        ::shm_unlink(name);
+        int hMemory = ::shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (hMemory == -1) {
+            return false;
+        }
+        if (!ring.Initialize(hMemory, capacity)) {
+            ::shm_unlink(name);
+            return false;
+        }
+        ::strcpy(this->name, name);
+        return true;
+    }
+
+    /**
+     * Create a ring without a name (memfd), hand GetHandle() to the clients.
+     */
+    bool BindAnonymous(SizeType capacity = SharedMemoryServer::DefaultCapacity) {
+        int hMemory = (int) ::syscall(SYS_memfd_create, "msggo-ring", 0);
+        if (hMemory == -1) {
+            return false;
+        }
+        return ring.Initialize(hMemory, capacity);
+    }
+
+    int GetHandle() const noexcept {
+        return ring.GetHandle();
+    }
+
+    /**
+     * A message that stays reserved but uncommitted for long (e.g. 100 ms, far longer than a copy) means its
+     * producer died while writing it. Nothing behind it can be received any more, bind a new ring.
+     * @return true if the next message is reserved by a producer but not committed yet.
+     */
+    bool IsStalled() const noexcept {
+        return ring.IsStalled();
+    }
+
+    /**
+     * Non-blocking receive of one message.
+     * @return false if there is nothing left to read.
+     */
+    bool TryReceive(ByteArray &data) {
+        return ring.Read([&data](const byte *payload, SizeType size) {
+            data.Assign(payload, size);
+            data.ResetMark();
+        });
+    }
+
+    /**
+     * Non-blocking receive of one message into a slot of pool, messages larger than the slot are truncated.
+     */
+    bool TryReceive(BufferPool &pool, ByteArray &data) {
+        return ring.Read([&pool, &data](const byte *payload, SizeType size) {
+            void *slot = pool.Acquire();
+            if (size > pool.GetSlotCapacity()) {
+                size = pool.GetSlotCapacity();
+            }
+            ::memcpy(BufferPool::GetData(slot), payload, size);
+            pool.Adopt(data, slot, size);
+        });
+    }
+
+    /**
+     * Receive up to count messages without waiting, reusing the slots keeps their capacity.
+     * @return count of received messages.
+     */
+    int ReceiveBatch(ByteArray *data, int count) {
+        assert(data && count >= 0);
+        int received = 0;
+        while (received < count && SharedMemoryServer::TryReceive(data[received])) {
+            ++received;
+        }
+        return received;
+    }
+
+    /**
+     * Blocking receive of one message.
+     * @param timeoutMs -1 to wait forever.
+     * @return false if the timeout expired first.
+     */
+    bool Receive(ByteArray &data, int timeoutMs = -1) {
+        if (SharedMemoryServer::TryReceive(data)) {
+            return true;
+        }
+        if (!timeoutMs) {
+            return false;
+        }
+        do {
+            ring.Wait(timeoutMs);
+            if (SharedMemoryServer::TryReceive(data)) {
+                return true;
+            }
+        } while (timeoutMs < 0);
+        return false;
+    }
+};
+
+#endif
+
+#endif //ESCAPIST_SHAREDMEMORY_H
@@ -6,12 +6,535 @@
 #define ESCAPIST_SOCKET_H
 
 #include "../General.h"
+#include "ByteArray.h"
+#include "BufferPool.h"
+#include "EventLoop.h"
 
+#ifdef ESCAPIST_OS_WINDOWS
 #pragma comment(lib, "ws2_32.lib")
+#else
+#define SOCKET_ERROR (-1)
+#endif
+
+#ifdef ESCAPIST_OS_LINUX
+#include <linux/errqueue.h>
+#include <linux/filter.h>
+#include <linux/net_tstamp.h>
+#include <netinet/udp.h>
+#include <ctime>
+#endif
+
+namespace OS {
+    inline void CloseSocket(int hSock) noexcept {
+#ifdef ESCAPIST_OS_WINDOWS
+        ::closesocket(hSock);
+#else
+        ::close(hSock);
+#endif
+    }
+
+    inline bool SetNonBlocking(int hSock, bool nonBlocking) noexcept {
+#ifdef ESCAPIST_OS_WINDOWS
+        u_long mode = nonBlocking ? 1 : 0;
+        return ::ioctlsocket(hSock, FIONBIO, &mode) == 0;
+#else
+        int flags = ::fcntl(hSock, F_GETFL, 0);
+        if (flags == -1) {
+            return false;
+        }
+        flags = nonBlocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+        return ::fcntl(hSock, F_SETFL, flags) == 0;
+#endif
+    }
+
+    inline bool WouldBlock() noexcept {
+#ifdef ESCAPIST_OS_WINDOWS
+        return ::WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+    }
+
+#ifdef ESCAPIST_OS_LINUX
+
+    /**
+     * @return nanoseconds of CLOCK_REALTIME, the clock of kernel software timestamps.
+     */
+    inline UInt64 RealtimeNs() noexcept {
+        timespec now{};
+        ::clock_gettime(CLOCK_REALTIME, &now);
+        return UInt64(now.tv_sec) * 1000000000ull + UInt64(now.tv_nsec);
+    }
+
+#endif
+}
+
+/**
+ * IPv4 address and port of a datagram peer, port is in host byte order.
+ */
+struct DatagramAddress {
+    unsigned char ipAddress[4];
+    unsigned short port;
+};
+
+/**
+ * Nanoseconds of CLOCK_REALTIME reported by SO_TIMESTAMPING, 0 if not reported.
+ * software is taken by the kernel, hardware by the NIC (raw clock of the NIC, only with hardware support).
+ */
+struct DatagramTimestamps {
+    UInt64 software = 0;
+    UInt64 hardware = 0;
+};
+
+namespace EscapistPrivate {
+    inline void ToSocketAddress(const DatagramAddress &address, sockaddr_in &addr) noexcept {
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(address.port);
+        ::memcpy(&addr.sin_addr.s_addr, address.ipAddress, 4);
+    }
+
+    inline void FromSocketAddress(const sockaddr_in &addr, DatagramAddress &address) noexcept {
+        ::memcpy(address.ipAddress, &addr.sin_addr.s_addr, 4);
+        address.port = ntohs(addr.sin_port);
+    }
+
+    constexpr int MaximumBatchSize = 64;
+    constexpr int BatchSlotSize = 2048;
+
+    /**
+     * recvmmsg into scratch, then assign each datagram to its slot.
+     * Datagrams larger than a slot (MSG_TRUNC) are dropped, and counted in truncated if not null.
+     * @param batchBuffer scratch of MaximumBatchSize * BatchSlotSize bytes.
+     * @return count of datagrams kept, 0 if nothing is left or the receive failed (errno tells which).
+     */
+    inline int ReceiveBatch(int hSock, byte *batchBuffer, ByteArray *data, DatagramAddress *addresses, int count,
+                            UInt64 *truncated = nullptr) {
+        assert(batchBuffer && data && count >= 0);
+        if (count > EscapistPrivate::MaximumBatchSize) {
+            count = EscapistPrivate::MaximumBatchSize;
+        }
+#ifdef ESCAPIST_OS_LINUX
+        mmsghdr headers[EscapistPrivate::MaximumBatchSize];
+        iovec vectors[EscapistPrivate::MaximumBatchSize];
+        sockaddr_in names[EscapistPrivate::MaximumBatchSize];
+        int kept = 0;
+        while (!kept) { // A batch of truncated datagrams only is not the end of the readable ones.
+            for (int index = 0; index < count; ++index) {
+                vectors[index].iov_base = batchBuffer + index * EscapistPrivate::BatchSlotSize;
+                vectors[index].iov_len = EscapistPrivate::BatchSlotSize;
+                ::memset(&headers[index], 0, sizeof(mmsghdr));
+                headers[index].msg_hdr.msg_name = &names[index];
+                headers[index].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+                headers[index].msg_hdr.msg_iov = &vectors[index];
+                headers[index].msg_hdr.msg_iovlen = 1;
+            }
+            int received = ::recvmmsg(hSock, headers, count, MSG_WAITFORONE, nullptr);
+            if (received == SOCKET_ERROR) {
+                return 0;
+            }
+            if (!received) {
+                return 0;
+            }
+            for (int index = 0; index < received; ++index) {
+                if (headers[index].msg_hdr.msg_flags & MSG_TRUNC) {
+                    if (truncated) {
+                        ++*truncated;
+                    }
+                    continue;
+                }
+                data[kept].Assign((byte *) vectors[index].iov_base, headers[index].msg_len);
+                data[kept].ResetMark();
+                if (addresses) {
+                    EscapistPrivate::FromSocketAddress(names[index], addresses[kept]);
+                }
+                ++kept;
+            }
+        }
+        return kept;
+#else
+        // No batched syscall on this platform, so just receive a single datagram.
+        if (!count) {
+            return 0;
+        }
+        sockaddr_in addr{};
+        socklen_t addrLen = sizeof(sockaddr_in);
+        int received = 1;
+        int size = ::recvfrom(hSock, (char *) batchBuffer, EscapistPrivate::BatchSlotSize, 0,
+                              (sockaddr *) (&addr), &addrLen);
+        if (size == SOCKET_ERROR) {
+            return 0;
+        }
+        data[0].Assign(batchBuffer, size);
+        data[0].ResetMark();
+        if (addresses) {
+            EscapistPrivate::FromSocketAddress(addr, addresses[0]);
+        }
+        return received;
+#endif
+    }
+
+    /**
+     * recvmmsg straight into slots of pool, each datagram is adopted by its slot without copying.
+     * Datagrams larger than a slot (MSG_TRUNC) are dropped, and counted in truncated if not null.
+     * Errors are not asserted, errno tells why nothing was received.
+     */
+    inline int ReceiveBatch(int hSock, BufferPool &pool, ByteArray *data, DatagramAddress *addresses, int count,
+                            UInt64 *truncated = nullptr) {
+        assert(data && count >= 0);
+        if (count > EscapistPrivate::MaximumBatchSize) {
+            count = EscapistPrivate::MaximumBatchSize;
+        }
+#ifdef ESCAPIST_OS_LINUX
+        void *slots[EscapistPrivate::MaximumBatchSize];
+        mmsghdr headers[EscapistPrivate::MaximumBatchSize];
+        iovec vectors[EscapistPrivate::MaximumBatchSize];
+        sockaddr_in names[EscapistPrivate::MaximumBatchSize];
+        int kept = 0;
+        int received = 1;
+        while (!kept && received > 0) { // A batch of truncated datagrams only is not the end of the readable ones.
+            // Slots are only lent by the cache of the thread, just those filled are taken.
+            int lent = pool.Lend(slots, count);
+            for (int index = lent; index < count; ++index) {
+                slots[index] = pool.Acquire();
+            }
+            for (int index = 0; index < count; ++index) {
+                vectors[index].iov_base = BufferPool::GetData(slots[index]);
+                vectors[index].iov_len = pool.GetSlotCapacity();
+                ::memset(&headers[index], 0, sizeof(mmsghdr));
+                headers[index].msg_hdr.msg_name = &names[index];
+                headers[index].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+                headers[index].msg_hdr.msg_iov = &vectors[index];
+                headers[index].msg_hdr.msg_iovlen = 1;
+            }
+            // Besides blocking, a connected socket reports ICMP errors of its peer.
+            received = ::recvmmsg(hSock, headers, count, MSG_WAITFORONE, nullptr);
+            int filled = received > 0 ? received : 0;
+            pool.Take(filled < lent ? filled : lent);
+            for (int index = 0; index < filled; ++index) {
+                if (headers[index].msg_hdr.msg_flags & MSG_TRUNC) {
+                    if (truncated) {
+                        ++*truncated;
+                    }
+                    pool.Free(slots[index]);
+                    continue;
+                }
+                pool.Adopt(data[kept], slots[index], headers[index].msg_len);
+                if (addresses) {
+                    EscapistPrivate::FromSocketAddress(names[index], addresses[kept]);
+                }
+                ++kept;
+            }
+            for (int index = filled > lent ? filled : lent; index < count; ++index) {
+                pool.Free(slots[index]);
+            }
+        }
+        return kept;
+#else
+        if (!count) {
+            return 0;
+        }
+        void *slot = pool.Acquire();
+        sockaddr_in addr{};
+        socklen_t addrLen = sizeof(sockaddr_in);
+        int size = ::recvfrom(hSock, (char *) BufferPool::GetData(slot), (int) pool.GetSlotCapacity(), 0,
+                              (sockaddr *) (&addr), &addrLen);
+        if (size == SOCKET_ERROR) {
+            pool.Free(slot);
+            return 0;
+        }
+        pool.Adopt(data[0], slot, size);
+        if (addresses) {
+            EscapistPrivate::FromSocketAddress(addr, addresses[0]);
+        }
+        return 1;
+#endif
+    }
+
+    /**
+     * Stops at the first datagram the kernel refuses, errno (OS::WouldBlock) tells why whenever fewer than count
+     * were sent.
+     * @param addresses null on a connected socket.
+     */
+    inline int SendBatch(int hSock, const ByteArray *data, const DatagramAddress *addresses, int count) {
+        assert(data && count >= 0);
+        int sent = 0;
+#ifdef ESCAPIST_OS_LINUX
+        mmsghdr headers[EscapistPrivate::MaximumBatchSize];
+        iovec vectors[EscapistPrivate::MaximumBatchSize];
+        sockaddr_in names[EscapistPrivate::MaximumBatchSize];
+        while (sent < count) {
+            int chunk = count - sent;
+            if (chunk > EscapistPrivate::MaximumBatchSize) {
+                chunk = EscapistPrivate::MaximumBatchSize;
+            }
+            for (int index = 0; index < chunk; ++index) {
+                const ByteArray &each = data[sent + index];
+                vectors[index].iov_base = (void *) each.GetConstData();
+                vectors[index].iov_len = each.GetSize();
+                ::memset(&headers[index], 0, sizeof(mmsghdr));
+                if (addresses) {
+                    EscapistPrivate::ToSocketAddress(addresses[sent + index], names[index]);
+                    headers[index].msg_hdr.msg_name = &names[index];
+                    headers[index].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+                }
+                headers[index].msg_hdr.msg_iov = &vectors[index];
+                headers[index].msg_hdr.msg_iovlen = 1;
+            }
+            // A short count leaves errno alone, the kernel reports the error of the refused datagram on the next
+            // call, so the rest is sent again: it goes on or fails with the actual errno.
+            int result = ::sendmmsg(hSock, headers, chunk, 0);
+            if (result == SOCKET_ERROR) {
+                break;
+            }
+            sent += result;
+        }
+#else
+        for (; sent < count; ++sent) {
+            int result;
+            if (addresses) {
+                sockaddr_in addr{};
+                EscapistPrivate::ToSocketAddress(addresses[sent], addr);
+                result = ::sendto(hSock, (const char *) data[sent].GetConstData(), (int) data[sent].GetSize(), 0,
+                                  (sockaddr *) &addr, sizeof(sockaddr_in));
+            } else {
+                result = ::send(hSock, (const char *) data[sent].GetConstData(), (int) data[sent].GetSize(), 0);
+            }
+            if (result == SOCKET_ERROR) {
+                break;
+            }
+        }
+#endif
+        return sent;
+    }
+
+    constexpr int MaximumSegmentCount = 64; // UDP_MAX_SEGMENTS of the kernel.
+    constexpr SizeType MaximumSegmentedSize = 65507;
+
+    /**
+     * Send data as datagrams of segmentSize bytes each (the last can be shorter) by a single UDP_SEGMENT sendmsg,
+     * platforms without GSO send one datagram per segment. Where the kernel or the device rejects the segmentation
+     * (EINVAL, EIO: no UDP_SEGMENT, no checksum offload) the segments go out by SendBatch instead.
+     * @param address null on a connected socket.
+     * @param calls if not null, receives count of datagrams the kernel saw sent: 1 with GSO, else one per segment.
+     * @return false unless every segment was sent, errno tells why.
+     */
+    inline bool SendSegmented(int hSock, const ByteArray &data, UInt16 segmentSize, const DatagramAddress *address,
+                              int *calls = nullptr) {
+        assert(segmentSize && data.GetSize() <= EscapistPrivate::MaximumSegmentedSize);
+        assert((data.GetSize() + segmentSize - 1) / segmentSize <= EscapistPrivate::MaximumSegmentCount);
+        if (calls) {
+            *calls = 0;
+        }
+        sockaddr_in addr{};
+        if (address) {
+            EscapistPrivate::ToSocketAddress(*address, addr);
+        }
+#ifdef ESCAPIST_OS_LINUX
+        iovec vector{(void *) data.GetConstData(), data.GetSize()};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(UInt16))];
+        msghdr header{};
+        if (address) {
+            header.msg_name = &addr;
+            header.msg_namelen = sizeof(sockaddr_in);
+        }
+        header.msg_iov = &vector;
+        header.msg_iovlen = 1;
+        if (data.GetSize() > segmentSize) { // A single segment is a plain datagram.
+            ::memset(control, 0, sizeof(control));
+            header.msg_control = control;
+            header.msg_controllen = sizeof(control);
+            cmsghdr *message = CMSG_FIRSTHDR(&header);
+            message->cmsg_level = SOL_UDP;
+            message->cmsg_type = UDP_SEGMENT;
+            message->cmsg_len = CMSG_LEN(sizeof(UInt16));
+            ::memcpy(CMSG_DATA(message), &segmentSize, sizeof(UInt16));
+        }
+        if (::sendmsg(hSock, &header, 0) != SOCKET_ERROR) {
+            if (calls) {
+                *calls = 1;
+            }
+            return true;
+        }
+        if (!header.msg_control || (errno != EINVAL && errno != EIO)) {
+            return false;
+        }
+        ByteArray segments[EscapistPrivate::MaximumSegmentCount];
+        DatagramAddress addresses[EscapistPrivate::MaximumSegmentCount];
+        int count = 0;
+        for (SizeType offset = 0; offset < data.GetSize(); offset += segmentSize, ++count) {
+            SizeType length = data.GetSize() - offset < segmentSize ? data.GetSize() - offset : segmentSize;
+            segments[count] = ByteArray(data, length, offset, 0);
+            if (address) {
+                addresses[count] = *address;
+            }
+        }
+        int sent = EscapistPrivate::SendBatch(hSock, segments, address ? addresses : nullptr, count);
+        if (calls) {
+            *calls = sent;
+        }
+        return sent == count;
+#else
+        SizeType offset = 0;
+        do {
+            SizeType length = data.GetSize() - offset < segmentSize ? data.GetSize() - offset : segmentSize;
+            const char *segment = (const char *) data.GetConstData() + offset;
+            int result = address ? ::sendto(hSock, segment, (int) length, 0, (sockaddr *) &addr, sizeof(sockaddr_in))
+                                 : ::send(hSock, segment, (int) length, 0);
+            if (result == SOCKET_ERROR) {
+                return false;
+            }
+            if (calls) {
+                ++*calls;
+            }
+            offset += length;
+        } while (offset < data.GetSize());
+        return true;
+#endif
+    }
+
+    /**
+     * Receive one datagram into a slot of pool, with UDP_GRO enabled it can be several coalesced segments.
+     * Buffers larger than a slot (MSG_TRUNC) are dropped, and counted in truncated if not null.
+     * @param segmentSize size of every segment but the last, the whole size if nothing was coalesced.
+     * @return false if there is nothing to read, errno tells why.
+     */
+    inline bool ReceiveSegmented(int hSock, BufferPool &pool, ByteArray &data, DatagramAddress *address,
+                                 UInt16 &segmentSize, UInt64 *truncated = nullptr) {
+        void *slot = pool.Acquire();
+        sockaddr_in addr{};
+#ifdef ESCAPIST_OS_LINUX
+        iovec vector{BufferPool::GetData(slot), pool.GetSlotCapacity()};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+        msghdr header{};
+        header.msg_name = &addr;
+        header.msg_iov = &vector;
+        header.msg_iovlen = 1;
+        header.msg_control = control;
+        ssize_t size;
+        do {
+            header.msg_namelen = sizeof(sockaddr_in);
+            header.msg_controllen = sizeof(control);
+            size = ::recvmsg(hSock, &header, 0);
+            if (size == SOCKET_ERROR) {
+                pool.Free(slot);
+                return false;
+            }
+            if ((header.msg_flags & MSG_TRUNC) && truncated) {
+                ++*truncated;
+            }
+        } while (header.msg_flags & MSG_TRUNC);
+        segmentSize = UInt16(size);
+        for (cmsghdr *message = CMSG_FIRSTHDR(&header); message; message = CMSG_NXTHDR(&header, message)) {
+            if (message->cmsg_level == SOL_UDP && message->cmsg_type == UDP_GRO) {
+                int value;
+                ::memcpy(&value, CMSG_DATA(message), sizeof(int));
+                segmentSize = UInt16(value);
+            }
+        }
+#else
+        socklen_t addrLen = sizeof(sockaddr_in);
+        int size = ::recvfrom(hSock, (char *) BufferPool::GetData(slot), (int) pool.GetSlotCapacity(), 0,
+                              (sockaddr *) (&addr), &addrLen);
+        if (size == SOCKET_ERROR) {
+            pool.Free(slot);
+            return false;
+        }
+        segmentSize = UInt16(size);
+#endif
+        pool.Adopt(data, slot, SizeType(size));
+        if (address) {
+            EscapistPrivate::FromSocketAddress(addr, *address);
+        }
+        return true;
+    }
+
+#ifdef ESCAPIST_OS_LINUX
+
+    inline UInt64 ToNanoseconds(const timespec &time) noexcept {
+        return UInt64(time.tv_sec) * 1000000000ull + UInt64(time.tv_nsec);
+    }
+
+    /**
+     * Pick SCM_TIMESTAMPING out of the control messages, and the id of a transmit timestamp if any.
+     */
+    inline void ReadTimestamps(msghdr &header, DatagramTimestamps &stamps, UInt32 *id) noexcept {
+        stamps = DatagramTimestamps();
+        for (cmsghdr *message = CMSG_FIRSTHDR(&header); message; message = CMSG_NXTHDR(&header, message)) {
+            if (message->cmsg_level == SOL_SOCKET && message->cmsg_type == SCM_TIMESTAMPING) {
+                scm_timestamping each{};
+                ::memcpy(&each, CMSG_DATA(message), sizeof(each));
+                stamps.software = EscapistPrivate::ToNanoseconds(each.ts[0]);
+                stamps.hardware = EscapistPrivate::ToNanoseconds(each.ts[2]);
+            } else if (id && ((message->cmsg_level == SOL_IP && message->cmsg_type == IP_RECVERR) ||
+                              (message->cmsg_level == SOL_IPV6 && message->cmsg_type == IPV6_RECVERR))) {
+                sock_extended_err error{};
+                ::memcpy(&error, CMSG_DATA(message), sizeof(error));
+                if (error.ee_origin == SO_EE_ORIGIN_TIMESTAMPING) {
+                    *id = error.ee_data;
+                }
+            }
+        }
+    }
+
+    /**
+     * recvmsg of one datagram together with its receive timestamps.
+     * Datagrams larger than capacity (MSG_TRUNC) are dropped, and counted in truncated if not null.
+     * @return size of datagram, -1 if nothing was received.
+     */
+    inline int ReceiveTimestamped(int hSock, byte *buffer, SizeType capacity, DatagramAddress &address,
+                                  DatagramTimestamps &stamps, UInt64 *truncated = nullptr) noexcept {
+        sockaddr_in addr{};
+        iovec vector{buffer, capacity};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(scm_timestamping))];
+        msghdr header{};
+        ssize_t size;
+        do {
+            header.msg_name = &addr;
+            header.msg_namelen = sizeof(sockaddr_in);
+            header.msg_iov = &vector;
+            header.msg_iovlen = 1;
+            header.msg_control = control;
+            header.msg_controllen = sizeof(control);
+            size = ::recvmsg(hSock, &header, 0);
+            if (size == SOCKET_ERROR) {
+                return -1;
+            }
+            if ((header.msg_flags & MSG_TRUNC) && truncated) {
+                ++*truncated;
+            }
+        } while (header.msg_flags & MSG_TRUNC);
+        EscapistPrivate::ReadTimestamps(header, stamps, nullptr);
+        EscapistPrivate::FromSocketAddress(addr, address);
+        return int(size);
+    }
+
+#endif
+}
 
 class DatagramServer {
+public:
+    static constexpr int MaximumDatagramSize = 65507;
+
+    /**
+     * Upper bound of datagrams moved by one ReceiveBatch/SendBatch syscall.
+     */
+    static constexpr int MaximumBatchSize = EscapistPrivate::MaximumBatchSize;
+
+    /**
+     * Every slot of ReceiveBatch can hold this many bytes, larger datagrams are dropped (see GetTruncatedCount).
+     */
+    static constexpr int BatchSlotSize = EscapistPrivate::BatchSlotSize;
+
+    /**
+     * Upper bound of segments carried by one SendSegmented.
+     */
+    static constexpr int MaximumSegmentCount = EscapistPrivate::MaximumSegmentCount;
+
 private:
     int hSock;
+    byte *batchBuffer; // MaximumBatchSize * BatchSlotSize bytes, allocated on first ReceiveBatch.
+    UInt32 transmitCount; // Datagrams sent since EnableTimestamping, the id of the next transmit timestamp.
+    UInt64 truncatedCount; // Datagrams dropped for not fitting their slot.
 
 public:
     DatagramServer() {
@@ -20,61 +543,431 @@ public:
         assert(!::WSAStartup(MAKEWORD(2, 2), &d));
 #endif
         hSock = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-        assert(hSock);
+        assert(hSock != SOCKET_ERROR);
+        batchBuffer = nullptr;
+        transmitCount = 0;
+        truncatedCount = 0;
     }
 
     DatagramServer(const DatagramServer &other) = delete;
 
     ~DatagramServer() {
-        if (hSock) {
-            ::closesocket(hSock);
+        if (hSock != SOCKET_ERROR) {
+            OS::CloseSocket(hSock);
         }
+        ::free((void *) batchBuffer);
 #ifdef ESCAPIST_OS_WINDOWS
         ::WSACleanup();
 #endif
     }
 
+    int GetHandle() const noexcept {
+        return hSock;
+    }
+
     DatagramServer &Bind(const char *ipAddr, int port) {
         sockaddr_in addr{};
         addr.sin_family = AF_INET;
-        addr.sin_port = ::htons(port);
+        addr.sin_port = htons(port);
         if (ipAddr) {
-
+            int parsed = ::inet_pton(AF_INET, ipAddr, &addr.sin_addr);
+            assert(parsed == 1);
         } else {
-            addr.sin_addr.S_un.S_addr = INADDR_ANY;
+            addr.sin_addr.s_addr = INADDR_ANY;
         }
-        assert(::bind(hSock, reinterpret_cast<const sockaddr *>(&addr), sizeof(sockaddr_in)) != SOCKET_ERROR);
+        int bound = ::bind(hSock, reinterpret_cast<const sockaddr *>(&addr), sizeof(sockaddr_in));
+        assert(bound != SOCKET_ERROR);
+        return *this;
+    }
+
+    DatagramServer &SetNonBlocking(bool nonBlocking = true) {
+        bool changed = OS::SetNonBlocking(hSock, nonBlocking);
+        assert(changed);
+        return *this;
+    }
+
+#ifdef ESCAPIST_OS_LINUX
+
+    /**
+     * Let several sockets bind the same address and port, the kernel spreads datagrams among them.
+     * Must be called before Bind.
+     */
+    DatagramServer &SetReusePort(bool enable = true) {
+        int value = enable ? 1 : 0;
+        int changed = ::setsockopt(hSock, SOL_SOCKET, SO_REUSEPORT, &value, sizeof(value));
+        assert(changed == 0);
+        return *this;
     }
 
+    /**
+     * Replace the kernel's choice of socket within a SO_REUSEPORT group by a classic BPF program.
+     * The program returns the index of socket in the group (in order of Bind), out of range falls back to hashing.
+     * @return false if the kernel rejected the program.
+     */
+    bool AttachReusePortProgram(sock_filter *program, unsigned short length) {
+        sock_fprog prog{};
+        prog.len = length;
+        prog.filter = program;
+        return ::setsockopt(hSock, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == 0;
+    }
+
+#endif
+
+    /**
+     * Blocking receive of exactly one datagram.
+     */
     DatagramServer &Receive(unsigned char ipAddress[4], ByteArray &data) {
-        sockaddr_in addr;
-        char each[1024];
-        int size, addrLen;
-        ByteArray result;
-        do {
-            size = ::recvfrom(hSock, each, 1024, 0, (sockaddr *) (&addr), &addrLen);
-            assert(size != SOCKET_ERROR);
-            result.Append((unsigned char *) each, size);
-        } while (size != 0);
-        ::memcpy(ipAddress, &addr.sin_addr.S_un.S_un_w, 4);
+        sockaddr_in addr{};
+        socklen_t addrLen = sizeof(sockaddr_in);
+        char each[DatagramServer::MaximumDatagramSize];
+        int size = ::recvfrom(hSock, each, DatagramServer::MaximumDatagramSize, 0, (sockaddr *) (&addr), &addrLen);
+        assert(size != SOCKET_ERROR);
+        data.Assign((unsigned char *) each, size);
+        ::memcpy(ipAddress, &addr.sin_addr.s_addr, 4);
+        return *this;
+    }
+
+    /**
+     * Non-blocking receive of one datagram, used to drain the socket inside EventHandler::OnReadable.
+     * @return false if there is nothing left to read, or the receive failed (errno tells which).
+     */
+    bool TryReceive(unsigned char ipAddress[4], unsigned short &port, ByteArray &data) {
+        sockaddr_in addr{};
+        socklen_t addrLen = sizeof(sockaddr_in);
+        char each[DatagramServer::MaximumDatagramSize];
+        int size = ::recvfrom(hSock, each, DatagramServer::MaximumDatagramSize, 0, (sockaddr *) (&addr), &addrLen);
+        if (size == SOCKET_ERROR) {
+            return false;
+        }
+        data.Assign((unsigned char *) each, size);
+        ::memcpy(ipAddress, &addr.sin_addr.s_addr, 4);
+        port = ntohs(addr.sin_port);
+        return true;
     }
 
     DatagramServer &Send(unsigned char ipAddress[4], short port, unsigned char *data, int size) {
-        sockaddr_in addr;
+        sockaddr_in addr{};
         addr.sin_family = AF_INET;
-        addr.sin_port = ::htons(port);
-        ::memcpy(&addr.sin_addr.S_un.S_addr, ipAddress, 4);
-        assert(::sendto(hSock, (const char *) data, size, 0, (sockaddr *) &addr, sizeof(sockaddr_in))
-               != SOCKET_ERROR);
+        addr.sin_port = htons(port);
+        ::memcpy(&addr.sin_addr.s_addr, ipAddress, 4);
+        int sent = ::sendto(hSock, (const char *) data, size, 0, (sockaddr *) &addr, sizeof(sockaddr_in));
+        assert(sent != SOCKET_ERROR);
+        ++transmitCount;
+        return *this;
+    }
+
+    /**
+     * Receive up to count datagrams, as many as possible by one recvmmsg.\n
+     * A blocking socket waits for the first datagram only, a non-blocking socket never waits.
+     * @param data preallocated slots, each received datagram is assigned to one slot.
+     * Reusing the same slots keeps their capacity, so the steady state doesn't allocate.
+     * @param addresses source of each datagram, can be null.
+     * @param count count of slots, at most MaximumBatchSize datagrams are received by one call.
+     * @return count of received datagrams, 0 if nothing is available on a non-blocking socket.
+     */
+    int ReceiveBatch(ByteArray *data, DatagramAddress *addresses, int count) {
+        if (!batchBuffer) {
+            batchBuffer = (byte *) ::malloc(DatagramServer::MaximumBatchSize * DatagramServer::BatchSlotSize);
+            assert(batchBuffer);
+        }
+        return EscapistPrivate::ReceiveBatch(hSock, batchBuffer, data, addresses, count, &truncatedCount);
+    }
+
+    /**
+     * Same as ReceiveBatch, but datagrams are received into slots of pool directly, neither copy nor allocation.
+     * Datagrams larger than pool.GetSlotCapacity() are dropped.
+     */
+    int ReceiveBatch(BufferPool &pool, ByteArray *data, DatagramAddress *addresses, int count) {
+        return EscapistPrivate::ReceiveBatch(hSock, pool, data, addresses, count, &truncatedCount);
+    }
+
+    /**
+     * Non-blocking receive of one datagram into a slot of pool.
+     * @return false if there is nothing left to read.
+     */
+    bool TryReceive(BufferPool &pool, DatagramAddress &address, ByteArray &data) {
+        return EscapistPrivate::ReceiveBatch(hSock, pool, &data, &address, 1, &truncatedCount) == 1;
+    }
+
+    /**
+     * @return count of datagrams received so far that were larger than their slot (or buffer), and dropped.
+     */
+    UInt64 GetTruncatedCount() const noexcept {
+        return truncatedCount;
+    }
+
+    /**
+     * Send count datagrams by as few sendmmsg as possible. Data is handed to the kernel directly, no copy.
+     * @param addresses destination of each datagram.
+     * @return count of datagrams accepted by the kernel, smaller than count if a non-blocking socket is full
+     * (OS::WouldBlock() is true then) or the kernel refused a datagram.
+     */
+    int SendBatch(const ByteArray *data, const DatagramAddress *addresses, int count) {
+        assert(addresses);
+        int sent = EscapistPrivate::SendBatch(hSock, data, addresses, count);
+        transmitCount += UInt32(sent);
+        return sent;
+    }
+
+    /**
+     * Let the kernel coalesce consecutive datagrams of a peer into one buffer of up to 64 KB (UDP_GRO).
+     * Once enabled, read the socket by ReceiveSegmented only, the slots of ReceiveBatch are too small.
+     * @return false if the kernel doesn't support it, datagrams then keep arriving one by one.
+     */
+    bool EnableGro(bool enable = true) {
+#ifdef ESCAPIST_OS_LINUX
+        int value = enable ? 1 : 0;
+        return ::setsockopt(hSock, SOL_UDP, UDP_GRO, &value, sizeof(value)) == 0;
+#else
+        return !enable;
+#endif
+    }
+
+    /**
+     * Receive a coalesced buffer into a slot of pool, no copy.
+     * Segment k is [k * segmentSize, min((k + 1) * segmentSize, data.GetSize())), they were separate datagrams.
+     * @param pool slots of at least MaximumDatagramSize bytes, larger coalesced buffers are dropped.
+     * @return false if there is nothing left to read.
+     */
+    bool ReceiveSegmented(BufferPool &pool, DatagramAddress &address, ByteArray &data, UInt16 &segmentSize) {
+        return EscapistPrivate::ReceiveSegmented(hSock, pool, data, &address, segmentSize, &truncatedCount);
+    }
+
+    /**
+     * Send the contiguous data as datagrams of segmentSize bytes (the last can be shorter) by one syscall (UDP_SEGMENT).
+     * @param data at most MaximumDatagramSize bytes, and at most MaximumSegmentCount segments.
+     * @return false unless every segment was sent, without GSO support they go out by SendBatch.
+     */
+    bool SendSegmented(const DatagramAddress &address, const ByteArray &data, UInt16 segmentSize) {
+        int calls = 0;
+        bool sent = EscapistPrivate::SendSegmented(hSock, data, segmentSize, &address, &calls);
+        transmitCount += UInt32(calls); // One timestamp id per sendmsg, not per segment.
+        return sent;
+    }
+
+#ifdef ESCAPIST_OS_LINUX
+
+    /**
+     * Ask the kernel (SO_TIMESTAMPING) to timestamp every received and sent datagram in software, and by the NIC
+     * too if hardware is true and it supports it. Software timestamps work everywhere, loopback included.
+     * Hardware timestamps also need the NIC configured by SIOCSHWTSTAMP, which is out of scope here.
+     * Ids of transmit timestamps restart from 0.
+     * @return false if the kernel refused.
+     */
+    bool EnableTimestamping(bool hardware = false) {
+        int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+                    SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+        if (hardware) {
+            flags |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+        }
+        transmitCount = 0;
+        return ::setsockopt(hSock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0;
+    }
+
+    /**
+     * Blocking receive of exactly one datagram with its receive timestamps, see EnableTimestamping.
+     */
+    DatagramServer &Receive(DatagramAddress &address, ByteArray &data, DatagramTimestamps &stamps) {
+        byte each[DatagramServer::MaximumDatagramSize];
+        int size = EscapistPrivate::ReceiveTimestamped(hSock, each, DatagramServer::MaximumDatagramSize,
+                                                       address, stamps);
+        assert(size != SOCKET_ERROR);
+        data.Assign(each, size);
+        data.ResetMark();
+        return *this;
+    }
+
+    /**
+     * Non-blocking receive of one datagram into a slot of pool, with its receive timestamps.
+     * @return false if there is nothing left to read.
+     */
+    bool TryReceive(BufferPool &pool, DatagramAddress &address, ByteArray &data, DatagramTimestamps &stamps) {
+        void *slot = pool.Acquire();
+        int size = EscapistPrivate::ReceiveTimestamped(hSock, BufferPool::GetData(slot), pool.GetSlotCapacity(),
+                                                       address, stamps, &truncatedCount);
+        if (size == SOCKET_ERROR) {
+            pool.Free(slot);
+            return false;
+        }
+        pool.Adopt(data, slot, SizeType(size));
+        return true;
+    }
+
+    /**
+     * Send one datagram and tell the id its transmit timestamp will carry.
+     * @param id counts every datagram this server sent since EnableTimestamping.
+     * @return false if the kernel refused it.
+     */
+    bool Send(const DatagramAddress &address, const ByteArray &data, UInt32 &id) {
+        id = transmitCount;
+        return DatagramServer::SendBatch(&data, &address, 1) == 1;
+    }
+
+    /**
+     * Non-blocking read of one transmit timestamp from the error queue, they arrive shortly after the send.
+     * @return false if none is available yet.
+     */
+    bool ReceiveTransmitTimestamp(UInt32 &id, DatagramTimestamps &stamps) {
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(scm_timestamping)) + CMSG_SPACE(sizeof(sock_extended_err) +
+                                                                                         sizeof(sockaddr_in))];
+        msghdr header{};
+        header.msg_control = control;
+        header.msg_controllen = sizeof(control);
+        if (::recvmsg(hSock, &header, MSG_ERRQUEUE | MSG_DONTWAIT) == SOCKET_ERROR) {
+            return false;
+        }
+        EscapistPrivate::ReadTimestamps(header, stamps, &id);
+        return true;
+    }
+
+    /**
+     * Switch to non-blocking mode and register the socket in a loop.
+     * @param handler must drain the socket by TryReceive on every OnReadable.
+     */
+    DatagramServer &Attach(EventLoop &loop, EventHandler *handler) {
+        DatagramServer::SetNonBlocking(true);
+        bool added = loop.Add(hSock, Flag<EventType>(EventType::Readable), handler);
+        assert(added);
+        return *this;
     }
+
+    DatagramServer &Detach(EventLoop &loop) {
+        loop.Remove(hSock);
+        return *this;
+    }
+
+#endif
 };
 
+/**
+ * Sender bound to one peer by connect(), so the kernel resolves the route once instead of on every send.\n
+ * Sends never assert on a refusal, they report it: OS::WouldBlock() after a short send means a non-blocking
+ * socket is full, anything else (e.g. ECONNREFUSED from an ICMP reply of the peer) is left in errno.
+ */
 class DatagramClient {
 private:
-    int socket;
+    int hSock;
+    bool connected;
 
 public:
-    
+    DatagramClient() {
+#ifdef ESCAPIST_OS_WINDOWS
+        WSAData d{};
+        assert(!::WSAStartup(MAKEWORD(2, 2), &d));
+#endif
+        hSock = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        assert(hSock != SOCKET_ERROR);
+        connected = false;
+    }
+
+    DatagramClient(const char *ipAddr, int port) : DatagramClient() {
+        bool succeeded = DatagramClient::Connect(ipAddr, port);
+        assert(succeeded);
+    }
+
+    DatagramClient(const DatagramClient &other) = delete;
+
+    ~DatagramClient() {
+        if (hSock != SOCKET_ERROR) {
+            OS::CloseSocket(hSock);
+        }
+#ifdef ESCAPIST_OS_WINDOWS
+        ::WSACleanup();
+#endif
+    }
+
+    int GetHandle() const noexcept {
+        return hSock;
+    }
+
+    bool IsConnected() const noexcept {
+        return connected;
+    }
+
+    DatagramClient &SetNonBlocking(bool nonBlocking = true) {
+        bool changed = OS::SetNonBlocking(hSock, nonBlocking);
+        assert(changed);
+        return *this;
+    }
+
+    /**
+     * Fix the peer of every later send, connecting again switches to another peer.
+     * Only datagrams from this peer are received afterwards.
+     * @return false if ipAddr is not a valid IPv4 address or connect() failed.
+     */
+    bool Connect(const char *ipAddr, int port) {
+        DatagramAddress address{};
+        if (::inet_pton(AF_INET, ipAddr, address.ipAddress) != 1) {
+            return false;
+        }
+        address.port = (unsigned short) port;
+        return DatagramClient::Connect(address);
+    }
+
+    bool Connect(const DatagramAddress &address) {
+        sockaddr_in addr{};
+        EscapistPrivate::ToSocketAddress(address, addr);
+        connected = ::connect(hSock, (const sockaddr *) &addr, sizeof(sockaddr_in)) != SOCKET_ERROR;
+        return connected;
+    }
+
+    /**
+     * Send one datagram to the connected peer.
+     * @return false if the kernel refused it, see the class comment.
+     */
+    bool Send(const void *data, SizeType size) {
+        assert(connected);
+        return ::send(hSock, (const char *) data, (int) size, 0) != SOCKET_ERROR;
+    }
+
+    bool Send(const ByteArray &data) {
+        return DatagramClient::Send(data.GetConstData(), data.GetSize());
+    }
+
+    /**
+     * Send count datagrams to the connected peer by as few sendmmsg as possible, no copy.
+     * @return count of datagrams accepted by the kernel, the rest is to be sent again by the caller.
+     */
+    int Send(const ByteArray *data, int count) {
+        assert(connected);
+        return EscapistPrivate::SendBatch(hSock, data, nullptr, count);
+    }
+
+    /**
+     * Send the contiguous data to the connected peer as datagrams of segmentSize bytes by one syscall,
+     * see DatagramServer::SendSegmented.
+     */
+    bool SendSegmented(const ByteArray &data, UInt16 segmentSize) {
+        assert(connected);
+        return EscapistPrivate::SendSegmented(hSock, data, segmentSize, nullptr);
+    }
+
+    /**
+     * Non-blocking receive of one reply from the connected peer into a slot of pool.
+     * @return false if there is nothing left to read.
+     */
+    bool TryReceive(BufferPool &pool, ByteArray &data) {
+        return EscapistPrivate::ReceiveBatch(hSock, pool, &data, nullptr, 1) == 1;
+    }
+
+#ifdef ESCAPIST_OS_LINUX
+
+    /**
+     * Register the socket in a loop, the handler will be notified when it becomes writable or readable again.
+     */
+    DatagramClient &Attach(EventLoop &loop, EventHandler *handler) {
+        DatagramClient::SetNonBlocking(true);
+        bool added = loop.Add(hSock, Flag<EventType>(EventType::Readable).AddFlag(EventType::Writable), handler);
+        assert(added);
+        return *this;
+    }
+
+    DatagramClient &Detach(EventLoop &loop) {
+        loop.Remove(hSock);
+        return *this;
+    }
+
+#endif
 };
 
 #endif //ESCAPIST_SOCKET_H
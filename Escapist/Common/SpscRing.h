@@ -0,0 +1,152 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_SPSCRING_H
+#define ESCAPIST_SPSCRING_H
+
+#include "../General.h"
+#include "Thread.h"
+#include <atomic>
+#include <utility>
+
+/**
+ * Wait-free single-producer/single-consumer ring, e.g. from one receive thread to one decoder thread.\n
+ * Each side owns its index and keeps a cached copy of the other's, reloading it only when the cached one says
+ * full (empty), so the indices rarely travel between cores. Reserve/Commit publish a batch with one release
+ * store, Peek/Release consume one the same way.\n
+ * Slots always hold a constructed T. Elements go in and out by move, so ByteArray handles pass through
+ * without touching their reference counts. Slots can also be filled in place, e.g. by
+ * DatagramServer::ReceiveBatch into the slots of Reserve.
+ * @tparam T default constructible and movable.
+ */
+template<typename T>
+class SpscRing {
+private:
+    alignas(EscapistPrivate::CacheLineSize) std::atomic<SizeType> tail; // Written by the producer.
+    SizeType cachedHead = 0; // The producer's view of head.
+    alignas(EscapistPrivate::CacheLineSize) std::atomic<SizeType> head; // Written by the consumer.
+    SizeType cachedTail = 0; // The consumer's view of tail.
+    alignas(EscapistPrivate::CacheLineSize) SizeType mask;
+    T *slots;
+
+public:
+    /**
+     * @param capacity elements held at most, a power of 2.
+     */
+    explicit SpscRing(SizeType capacity) : tail(0), head(0), mask(capacity - 1) {
+        assert(capacity && !(capacity & (capacity - 1)));
+        slots = new T[capacity];
+    }
+
+    SpscRing(const SpscRing &other) = delete;
+
+    ~SpscRing() {
+        delete[] slots;
+    }
+
+    /**
+     * Producer only: free slots from the next one on, up to count and to the end of the array (a batch wrapping
+     * around takes two calls).
+     * @param reserved set to the first slot, which holds a moved-from (or default) T.
+     * @return slots reserved, 0 if full.
+     */
+    SizeType Reserve(SizeType count, T *&reserved) noexcept {
+        SizeType position = tail.load(std::memory_order_relaxed);
+        SizeType free = mask + 1 - (position - cachedHead);
+        if (free < count) {
+            cachedHead = head.load(std::memory_order_acquire);
+            free = mask + 1 - (position - cachedHead);
+        }
+        SizeType contiguous = mask + 1 - (position & mask);
+        count = count < free ? count : free;
+        count = count < contiguous ? count : contiguous;
+        reserved = slots + (position & mask);
+        return count;
+    }
+
+    /**
+     * Producer only: publish count slots filled since Reserve, at most what it returned.
+     */
+    void Commit(SizeType count) noexcept {
+        tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    /**
+     * Consumer only: published elements from the oldest on, up to count and to the end of the array.
+     * @param available set to the first element.
+     * @return elements available, 0 if empty.
+     */
+    SizeType Peek(SizeType count, T *&available) noexcept {
+        SizeType position = head.load(std::memory_order_relaxed);
+        SizeType filled = cachedTail - position;
+        if (filled < count) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            filled = cachedTail - position;
+        }
+        SizeType contiguous = mask + 1 - (position & mask);
+        count = count < filled ? count : filled;
+        count = count < contiguous ? count : contiguous;
+        available = slots + (position & mask);
+        return count;
+    }
+
+    /**
+     * Consumer only: hand count slots from Peek back to the producer. Their elements should have been moved out
+     * (or emptied) first, whatever is left in a slot lives on until the producer overwrites it.
+     */
+    void Release(SizeType count) noexcept {
+        head.store(head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    /**
+     * Producer only.
+     * @return false if full, value is left alone then.
+     */
+    bool TryPush(T &&value) {
+        T *slot;
+        if (!SpscRing::Reserve(1, slot)) {
+            return false;
+        }
+        *slot = std::move(value);
+        SpscRing::Commit(1);
+        return true;
+    }
+
+    bool TryPush(const T &value) {
+        T *slot;
+        if (!SpscRing::Reserve(1, slot)) {
+            return false;
+        }
+        *slot = value;
+        SpscRing::Commit(1);
+        return true;
+    }
+
+    /**
+     * Consumer only.
+     * @return false if empty.
+     */
+    bool TryPop(T &value) {
+        T *slot;
+        if (!SpscRing::Peek(1, slot)) {
+            return false;
+        }
+        value = std::move(*slot);
+        SpscRing::Release(1);
+        return true;
+    }
+
+    /**
+     * @return elements held at the moment, exact only for the consumer.
+     */
+    SizeType GetSize() const noexcept {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    SizeType GetCapacity() const noexcept {
+        return mask + 1;
+    }
+};
+
+#endif //ESCAPIST_SPSCRING_H
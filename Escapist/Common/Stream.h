@@ -0,0 +1,477 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_STREAM_H
+#define ESCAPIST_STREAM_H
+
+#include "../General.h"
+#include "ByteArray.h"
+#include "Message.h"
+#include "Socket.h"
+
+#ifdef ESCAPIST_OS_LINUX
+
+#include <netinet/tcp.h>
+#include <sys/uio.h>
+
+namespace EscapistPrivate {
+    /**
+     * iovecs built per writev, longer lists of segments take several calls.
+     */
+    constexpr int MaximumWriteSegments = 64;
+
+    /**
+     * Spill area of a read behind the free part of the receive buffer, so one readv takes whatever is queued
+     * even if the buffer is almost full.
+     */
+    constexpr SizeType ReadSpillSize = 64 * 1024;
+}
+
+/**
+ * TCP connection carrying MsgGO messages (MessageHeader framing), for links where UDP is not allowed.
+ * Either connected by Connect, or wrapping a socket accepted by StreamServer.\n
+ * Sends are gathered by writev from several ByteArray segments (e.g. a header and a payload) without
+ * concatenating them; on a full non-blocking socket the unsent tail is kept and resumed by Flush. Receive reads
+ * as much as queued into one large buffer and hands out every complete message in it as a slice of that buffer
+ * (see ByteArray::Slice), header and payload, with its mark at the payload, so messages are never copied.
+ * TCP has its own checksum, so the one of MessageHeader is not verified here.
+ */
+class StreamClient {
+public:
+    static constexpr SizeType DefaultBufferSize = 64 * 1024;
+
+    /**
+     * Larger payload lengths are taken as garbage rather than growing the buffer without bound.
+     */
+    static constexpr SizeType MaximumMessageSize = 64 * 1024 * 1024;
+
+private:
+    int hSock;
+    bool connected;
+    ByteArray buffer; // Size is always its capacity, bytes [begin, end) are received but not handed out yet.
+    SizeType begin = 0;
+    SizeType end = 0;
+    ByteArray message[2]; // Header and payload of Send, kept to reuse the header allocation.
+    ByteArray unsent[EscapistPrivate::MaximumWriteSegments]; // What a full socket didn't take, shared with senders.
+    int unsentCount = 0;
+    SizeType unsentSkip = 0; // Bytes of unsent[0] already written.
+
+    /**
+     * Keep segments behind the unsent tail, sharing them while slots are free, then appending to the last one.
+     * @param skip bytes of the segments already written, only if nothing is kept yet.
+     */
+    void Keep(const ByteArray *segments, int count, SizeType skip) {
+        assert(!skip || !unsentCount);
+        for (int index = 0; index < count; ++index) {
+            SizeType size = segments[index].GetSize();
+            if (skip >= size) {
+                skip -= size;
+                continue;
+            }
+            if (!unsentCount) {
+                unsentSkip = skip;
+            }
+            skip = 0;
+            if (unsentCount < EscapistPrivate::MaximumWriteSegments) {
+                unsent[unsentCount++] = segments[index];
+            } else {
+                unsent[unsentCount - 1].Append(segments[index]);
+            }
+        }
+    }
+
+    /**
+     * Make room behind end: reuse the buffer if nobody else holds it, otherwise start a new one. Either way only
+     * the incomplete message at the tail is moved.
+     * @param required bytes the buffer must hold from begin on.
+     */
+    void Compact(SizeType required) {
+        SizeType capacity = buffer.GetSize();
+        if (required < capacity) {
+            required = capacity;
+        }
+        SizeType pending = end - begin;
+        if (buffer.IsShared() || required > capacity) {
+            ByteArray fresh(required, required);
+            ::memcpy(fresh.GetData(), buffer.GetConstData() + begin, pending);
+            buffer = static_cast<ByteArray &&>(fresh);
+        } else if (begin) {
+            ::memmove(buffer.GetData(), buffer.GetConstData() + begin, pending);
+        }
+        begin = 0;
+        end = pending;
+    }
+
+    /**
+     * Hand out complete messages from [begin, end).
+     * @return count of messages, -1 if a header is garbage.
+     */
+    int Parse(MessageHeader *headers, ByteArray *messages, int count) {
+        int parsed = 0;
+        while (parsed < count) {
+            MessageHeader &header = headers[parsed];
+            if (!MessageHeader::Parse(buffer.GetConstData() + begin, end - begin, header)) {
+                break;
+            }
+            if (header.magic != MessageHeader::Magic || header.version != MessageHeader::CurrentVersion ||
+                header.payloadLength > StreamClient::MaximumMessageSize) {
+                errno = EPROTO;
+                return -1;
+            }
+            if (end - begin - MessageHeader::Size < header.payloadLength) {
+                break;
+            }
+            messages[parsed] = buffer.Slice(begin, MessageHeader::Size + header.payloadLength);
+            messages[parsed].IgnoreBytes(SizeType(MessageHeader::Size));
+            begin += MessageHeader::Size + header.payloadLength;
+            ++parsed;
+        }
+        if (begin == end) {
+            begin = end = 0;
+        }
+        return parsed;
+    }
+
+    /**
+     * @return bytes required from begin to hold the message at begin, at least its header.
+     */
+    SizeType GetRequiredSize() const noexcept {
+        MessageHeader header{};
+        if (!MessageHeader::Parse(buffer.GetConstData() + begin, end - begin, header) ||
+            header.payloadLength > StreamClient::MaximumMessageSize) {
+            return MessageHeader::Size;
+        }
+        return MessageHeader::Size + header.payloadLength;
+    }
+
+public:
+    explicit StreamClient(SizeType bufferSize = StreamClient::DefaultBufferSize)
+            : connected(false), buffer(bufferSize, bufferSize) {
+        assert(bufferSize >= MessageHeader::Size);
+        hSock = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        assert(hSock != SOCKET_ERROR);
+    }
+
+    /**
+     * Take over a connected socket, e.g. from StreamServer::Accept.
+     */
+    explicit StreamClient(int hSock, SizeType bufferSize = StreamClient::DefaultBufferSize)
+            : hSock(hSock), connected(true), buffer(bufferSize, bufferSize) {
+        assert(hSock != SOCKET_ERROR && bufferSize >= MessageHeader::Size);
+    }
+
+    StreamClient(const StreamClient &other) = delete;
+
+    ~StreamClient() {
+        if (hSock != SOCKET_ERROR) {
+            OS::CloseSocket(hSock);
+        }
+    }
+
+    int GetHandle() const noexcept {
+        return hSock;
+    }
+
+    bool IsConnected() const noexcept {
+        return connected;
+    }
+
+    StreamClient &SetNonBlocking(bool nonBlocking = true) {
+        bool changed = OS::SetNonBlocking(hSock, nonBlocking);
+        assert(changed);
+        return *this;
+    }
+
+    /**
+     * Disable Nagle, small messages leave at once instead of waiting for the ack of the previous one.
+     */
+    StreamClient &SetNoDelay(bool noDelay = true) {
+        int value = noDelay ? 1 : 0;
+        int changed = ::setsockopt(hSock, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+        assert(changed == 0);
+        return *this;
+    }
+
+    /**
+     * @return false if ipAddr is not a valid IPv4 address or connect() failed.
+     */
+    bool Connect(const char *ipAddr, int port) {
+        DatagramAddress address{};
+        if (::inet_pton(AF_INET, ipAddr, address.ipAddress) != 1) {
+            return false;
+        }
+        address.port = (unsigned short) port;
+        return StreamClient::Connect(address);
+    }
+
+    bool Connect(const DatagramAddress &address) {
+        sockaddr_in addr{};
+        EscapistPrivate::ToSocketAddress(address, addr);
+        connected = ::connect(hSock, (const sockaddr *) &addr, sizeof(sockaddr_in)) != SOCKET_ERROR;
+        return connected;
+    }
+
+    /**
+     * One writev of the segments, skipping their first skip bytes (what an earlier short write already sent).
+     * @return bytes accepted by the kernel, less than the rest on a full non-blocking socket (OS::WouldBlock()
+     * is true then), -1 on error.
+     */
+    Int64 Write(const ByteArray *segments, int count, SizeType skip = 0) {
+        iovec vectors[EscapistPrivate::MaximumWriteSegments];
+        int used = 0;
+        for (int index = 0; index < count && used < EscapistPrivate::MaximumWriteSegments; ++index) {
+            SizeType size = segments[index].GetSize();
+            if (skip >= size) {
+                skip -= size;
+                continue;
+            }
+            vectors[used].iov_base = (void *) (segments[index].GetConstData() + skip);
+            vectors[used].iov_len = size - skip;
+            skip = 0;
+            ++used;
+        }
+        if (!used) {
+            return 0;
+        }
+        ssize_t written;
+        do {
+            written = ::writev(hSock, vectors, used);
+        } while (written < 0 && errno == EINTR);
+        return written < 0 && OS::WouldBlock() ? 0 : Int64(written);
+    }
+
+    /**
+     * Write every segment completely, by as many writev as needed. If a non-blocking socket becomes full, the
+     * unsent tail is kept (sharing the segments, not copying them) until Flush, and later sends queue behind it.
+     * @return false on error.
+     */
+    bool Send(const ByteArray *segments, int count) {
+        if (!StreamClient::Flush()) {
+            return false;
+        }
+        if (unsentCount) {
+            StreamClient::Keep(segments, count, 0);
+            return true;
+        }
+        SizeType total = 0, sent = 0;
+        for (int index = 0; index < count; ++index) {
+            total += segments[index].GetSize();
+        }
+        while (sent < total) {
+            Int64 written = StreamClient::Write(segments, count, sent);
+            if (written < 0) {
+                return false;
+            }
+            if (!written) {
+                StreamClient::Keep(segments, count, sent);
+                return true;
+            }
+            sent += SizeType(written);
+        }
+        return true;
+    }
+
+    /**
+     * Resume the unsent tail, to be called when the socket becomes writable.
+     * @return false on error, true if everything was written or the socket is full again.
+     */
+    bool Flush() {
+        while (unsentCount) {
+            Int64 written = StreamClient::Write(unsent, unsentCount, unsentSkip);
+            if (written <= 0) {
+                return !written;
+            }
+            unsentSkip += SizeType(written);
+            int done = 0;
+            while (done < unsentCount && unsentSkip >= unsent[done].GetSize()) {
+                unsentSkip -= unsent[done].GetSize();
+                unsent[done++].Empty();
+            }
+            for (int index = done; index < unsentCount; ++index) {
+                unsent[index - done] = static_cast<ByteArray &&>(unsent[index]);
+            }
+            unsentCount -= done;
+        }
+        return true;
+    }
+
+    /**
+     * @return bytes kept by a send on a full socket and not written by Flush yet.
+     */
+    SizeType GetUnsentSize() const noexcept {
+        SizeType size = 0;
+        for (int index = 0; index < unsentCount; ++index) {
+            size += unsent[index].GetSize();
+        }
+        return size - unsentSkip;
+    }
+
+    /**
+     * Frame payload by a MessageHeader and send both by writev, the payload is never copied.
+     */
+    bool Send(UInt16 type, const Flag<MessageFlag> &flags, const ByteArray &payload) {
+        assert(payload.GetSize() <= StreamClient::MaximumMessageSize);
+        byte header[MessageHeader::Size];
+        MessageHeader::Store(header, type, flags, UInt32(payload.GetSize()),
+                             MessageHeader::Checksum(payload.GetConstData(), payload.GetSize()));
+        message[0].Assign(header, MessageHeader::Size);
+        message[1] = payload;
+        bool succeeded = StreamClient::Send(message, 2);
+        message[1].Empty(); // Let go of the payload.
+        return succeeded;
+    }
+
+    /**
+     * Hand out buffered messages, reading once (by readv into the buffer and a spill area) only if none is
+     * complete yet. Each message is a slice of the receive buffer, its header and header.payloadLength bytes of
+     * payload, with its mark at the payload; keeping one is fine, the next read then goes to a new buffer instead.
+     * @param messages slots to fill, emptied first. Passing the same slots again lets the buffer be reused.
+     * @return count of messages, 0 if none is complete (or nothing to read on a non-blocking socket),
+     * -1 if the peer closed the connection (errno is 0) or on error (EPROTO for garbage).
+     */
+    int Receive(MessageHeader *headers, ByteArray *messages, int count) {
+        for (int index = 0; index < count; ++index) {
+            messages[index].Empty();
+        }
+        int parsed = StreamClient::Parse(headers, messages, count);
+        if (parsed) {
+            return parsed;
+        }
+        SizeType required = StreamClient::GetRequiredSize();
+        if (begin || buffer.IsShared() || required > buffer.GetSize()) {
+            StreamClient::Compact(required);
+        }
+        byte spill[EscapistPrivate::ReadSpillSize];
+        iovec vectors[2];
+        vectors[0].iov_base = buffer.GetData() + end;
+        vectors[0].iov_len = buffer.GetSize() - end;
+        vectors[1].iov_base = spill;
+        vectors[1].iov_len = sizeof(spill);
+        ssize_t received;
+        do {
+            received = ::readv(hSock, vectors, 2);
+        } while (received < 0 && errno == EINTR);
+        if (received <= 0) {
+            if (!received) {
+                errno = 0;
+                return -1;
+            }
+            return OS::WouldBlock() ? 0 : -1;
+        }
+        SizeType inBuffer = SizeType(received) < vectors[0].iov_len ? SizeType(received) : vectors[0].iov_len;
+        end += inBuffer;
+        if (SizeType(received) > inBuffer) {
+            SizeType spilled = SizeType(received) - inBuffer;
+            StreamClient::Compact(end - begin + spilled);
+            ::memcpy(buffer.GetData() + end, spill, spilled);
+            end += spilled;
+        }
+        return StreamClient::Parse(headers, messages, count);
+    }
+
+    /**
+     * Register the socket in a loop, the handler will be notified when it becomes writable (call Flush then) or
+     * readable again.
+     */
+    StreamClient &Attach(EventLoop &loop, EventHandler *handler) {
+        StreamClient::SetNonBlocking(true);
+        bool added = loop.Add(hSock, Flag<EventType>(EventType::Readable).AddFlag(EventType::Writable), handler);
+        assert(added);
+        return *this;
+    }
+
+    StreamClient &Detach(EventLoop &loop) {
+        loop.Remove(hSock);
+        return *this;
+    }
+};
+
+/**
+ * Listening TCP socket, every accepted connection is to be wrapped by a StreamClient.
+ */
+class StreamServer {
+private:
+    int hSock;
+
+public:
+    StreamServer() {
+        hSock = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        assert(hSock != SOCKET_ERROR);
+        int reuse = 1;
+        ::setsockopt(hSock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    }
+
+    StreamServer(const StreamServer &other) = delete;
+
+    ~StreamServer() {
+        if (hSock != SOCKET_ERROR) {
+            OS::CloseSocket(hSock);
+        }
+    }
+
+    int GetHandle() const noexcept {
+        return hSock;
+    }
+
+    StreamServer &Bind(const char *ipAddr, int port) {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (ipAddr) {
+            int parsed = ::inet_pton(AF_INET, ipAddr, &addr.sin_addr);
+            assert(parsed == 1);
+        } else {
+            addr.sin_addr.s_addr = INADDR_ANY;
+        }
+        int bound = ::bind(hSock, reinterpret_cast<const sockaddr *>(&addr), sizeof(sockaddr_in));
+        assert(bound != SOCKET_ERROR);
+        return *this;
+    }
+
+    StreamServer &Listen(int backlog = SOMAXCONN) {
+        int listening = ::listen(hSock, backlog);
+        assert(listening != SOCKET_ERROR);
+        return *this;
+    }
+
+    StreamServer &SetNonBlocking(bool nonBlocking = true) {
+        bool changed = OS::SetNonBlocking(hSock, nonBlocking);
+        assert(changed);
+        return *this;
+    }
+
+    /**
+     * @param address peer of the connection, can be null.
+     * @return handle of the connection for StreamClient, SOCKET_ERROR if none is pending on a non-blocking
+     * socket (OS::WouldBlock() is true then) or on error.
+     */
+    int Accept(DatagramAddress *address = nullptr) {
+        sockaddr_in addr{};
+        socklen_t length = sizeof(sockaddr_in);
+        int accepted = ::accept(hSock, (sockaddr *) &addr, &length);
+        if (accepted != SOCKET_ERROR && address) {
+            EscapistPrivate::FromSocketAddress(addr, *address);
+        }
+        return accepted;
+    }
+
+    /**
+     * Register the socket in a loop, the handler will be notified when a connection is pending.
+     */
+    StreamServer &Attach(EventLoop &loop, EventHandler *handler) {
+        StreamServer::SetNonBlocking(true);
+        bool added = loop.Add(hSock, Flag<EventType>(EventType::Readable), handler);
+        assert(added);
+        return *this;
+    }
+
+    StreamServer &Detach(EventLoop &loop) {
+        loop.Remove(hSock);
+        return *this;
+    }
+};
+
+#endif
+
+#endif //ESCAPIST_STREAM_H
@@ -6,9 +6,14 @@
 #define ESCAPIST_STRING_H
 
 #include "../General.h"
+#include "Internal/Allocator.h"
 #include "Internal/ReferenceCount.h"
 #include <memory>
 #include <cstring>
+#include <cwchar>
+#ifndef ESCAPIST_OS_WINDOWS
+#include <strings.h>
+#endif
 
 template<typename Ch>
 class CharTrait {
@@ -148,7 +153,11 @@ public:
     }
 
     static inline int CompareNoCase(const char *left, const char *right) {
+#ifdef ESCAPIST_OS_WINDOWS
         return ::_stricmp(left, right);
+#else
+        return ::strcasecmp(left, right);
+#endif
     }
 
     static inline SizeType GetLength(const char *src) {
@@ -156,15 +165,15 @@ public:
     }
 
     static inline char *IndexOf(const char *data, const char &ch) {
-        return ::strchr(data, ch);
+        return const_cast<char *>(::strchr(data, ch));
     }
 
     static inline char *IndexOf(const char *data, const char *target) {
-        return ::strstr(data, target);
+        return const_cast<char *>(::strstr(data, target));
     }
 
     static inline char *LastIndexOf(const char *data, const char &ch) {
-        return ::strrchr(data, ch);
+        return const_cast<char *>(::strrchr(data, ch));
     }
 
     static inline char *LastIndexOf(const char *data, const char *target) {
@@ -219,7 +228,17 @@ public:
     }
 
     static void Reverse(char *data) {
+#ifdef ESCAPIST_OS_WINDOWS
         ::strrev(data);
+#else
+        if (data && *data) {
+            for (char *last = data + ::strlen(data) - 1; data < last; ++data, --last) {
+                char ch = *data;
+                *data = *last;
+                *last = ch;
+            }
+        }
+#endif
     }
 };
 
@@ -249,7 +268,11 @@ public:
     }
 
     static inline int CompareNoCase(const wchar_t *left, const wchar_t *right) {
+#ifdef ESCAPIST_OS_WINDOWS
         return ::_wcsicmp(left, right);
+#else
+        return ::wcscasecmp(left, right);
+#endif
     }
 
     static inline SizeType GetLength(const wchar_t *src) {
@@ -257,15 +280,15 @@ public:
     }
 
     static inline wchar_t *IndexOf(const wchar_t *data, const wchar_t &ch) {
-        return ::wcschr(data, ch);
+        return const_cast<wchar_t *>(::wcschr(data, ch));
     }
 
     static inline wchar_t *IndexOf(const wchar_t *data, const wchar_t *target) {
-        return ::wcsstr(data, target);
+        return const_cast<wchar_t *>(::wcsstr(data, target));
     }
 
     static inline wchar_t *LastIndexOf(const wchar_t *data, const wchar_t &ch) {
-        return ::wcsrchr(data, ch);
+        return const_cast<wchar_t *>(::wcsrchr(data, ch));
     }
 
     static inline wchar_t *LastIndexOf(const wchar_t *data, const wchar_t *target) {
@@ -320,7 +343,17 @@ public:
     }
 
     static void Reverse(wchar_t *data) {
+#ifdef ESCAPIST_OS_WINDOWS
         ::wcsrev(data);
+#else
+        if (data && *data) {
+            for (wchar_t *last = data + ::wcslen(data) - 1; data < last; ++data, --last) {
+                wchar_t ch = *data;
+                *data = *last;
+                *last = ch;
+            }
+        }
+#endif
     }
 };
 
@@ -336,6 +369,7 @@ private:
         Ch *str_;
         SizeType len_;
         SizeType capacity_;
+        EscapistPrivate::BufferOwner *owner_; // Where buf_ goes back, null for heap (see AllocatorScope).
     };
 
     static constexpr SizeType SmallStringCapacity = sizeof(GeneralBuffer) / sizeof(Ch);
@@ -384,7 +418,9 @@ private:
         }
         buf_.len_ = length; // Assignment
         buf_.capacity_ = length * (long double) 1.5; // Narrowing conversion from 'SizeType'?
-        assert(buf_.buf_ = (ReferenceCount **) ::malloc(BasicString<Ch>::TotalCapacity(buf_.capacity_)));
+        buf_.buf_ = (ReferenceCount **) EscapistPrivate::AllocateBuffer(
+                BasicString<Ch>::TotalCapacity(buf_.capacity_), buf_.owner_);
+        assert(buf_.buf_);
         *buf_.buf_ = ref; // Assign the reference count pointer.
         buf_.str_ = (Ch *) (buf_.buf_ + 1);
         if (putZero) {
@@ -452,8 +488,9 @@ private:
                             ReferenceCount **oldBuf = buf_.buf_;
                             ReferenceCount *oldRef = *buf_.buf_;
                             buf_.capacity_ = buf_.len_ * (long double) 1.5;
-                            buf_.buf_ = (ReferenceCount **) ::realloc(buf_.buf_,
-                                                                      BasicString<Ch>::TotalCapacity(buf_.capacity_));
+                            buf_.buf_ = (ReferenceCount **) EscapistPrivate::ReallocateBuffer(
+                                    buf_.buf_, BasicString<Ch>::TotalCapacity(oldLen),
+                                    BasicString<Ch>::TotalCapacity(buf_.capacity_), buf_.owner_);
                             if (buf_.buf_ != oldBuf) {
                                 // If the address changed, data pointer and reference count pointer still point to old address.
                                 *buf_.buf_ = oldRef;
@@ -521,18 +558,19 @@ private:
                             // If we realloc and move, it'll case two move.
                             // Therefore, if difference between those two capacity, it tend to allocate new data and copy it.
                             ReferenceCount **oldBuf = buf_.buf_;
+                            EscapistPrivate::BufferOwner *oldOwner = buf_.owner_;
                             SizeType oldCapacity = buf_.capacity_;
                             buf_.capacity_ = buf_.len_ * (long double) 1.5;
                             if (buf_.capacity_ - oldCapacity > oldCapacity * 2) {
                                 Ch *const oldStr = buf_.str_;
                                 BasicString<Ch>::InitEager(buf_.len_, true);
                                 CharTrait<Ch>::Copy(buf_.str_ + growthLength, oldStr, oldLen);
-                                ::free((void *) oldBuf);
+                                EscapistPrivate::ReleaseBuffer((void *) oldBuf, oldOwner);
                             } else {
                                 ReferenceCount *oldRef = *buf_.buf_;
-                                buf_.buf_ = (ReferenceCount **) ::realloc(buf_.buf_,
-                                                                          BasicString<Ch>::TotalCapacity(
-                                                                                  buf_.capacity_));
+                                buf_.buf_ = (ReferenceCount **) EscapistPrivate::ReallocateBuffer(
+                                        buf_.buf_, BasicString<Ch>::TotalCapacity(oldLen),
+                                        BasicString<Ch>::TotalCapacity(buf_.capacity_), buf_.owner_);
                                 if (buf_.buf_ != oldBuf) {
                                     *buf_.buf_ = oldRef;
                                     buf_.str_ = (Ch *) (buf_.buf_ + 1);
@@ -608,6 +646,7 @@ private:
                             // If we realloc and move, it'll case two move.
                             // Therefore, if difference between those two capacity, it tend to allocate new data and copy it.
                             ReferenceCount **oldBuf = buf_.buf_;
+                            EscapistPrivate::BufferOwner *oldOwner = buf_.owner_;
                             SizeType oldCapacity = buf_.capacity_;
                             buf_.capacity_ = buf_.len_ * (long double) 1.5;
                             if (buf_.capacity_ - oldCapacity > oldCapacity * 2) {
@@ -616,12 +655,12 @@ private:
                                 CharTrait<Ch>::Copy(buf_.str_, oldStr, growthIndex);
                                 CharTrait<Ch>::Copy(buf_.str_ + growthIndex + growthLength, oldStr + growthIndex,
                                                     oldLen - growthIndex);
-                                ::free((void *) oldBuf);
+                                EscapistPrivate::ReleaseBuffer((void *) oldBuf, oldOwner);
                             } else {
                                 ReferenceCount *oldRef = *buf_.buf_;
-                                buf_.buf_ = (ReferenceCount **) ::realloc(buf_.buf_,
-                                                                          BasicString<Ch>::TotalCapacity(
-                                                                                  buf_.capacity_));
+                                buf_.buf_ = (ReferenceCount **) EscapistPrivate::ReallocateBuffer(
+                                        buf_.buf_, BasicString<Ch>::TotalCapacity(oldLen),
+                                        BasicString<Ch>::TotalCapacity(buf_.capacity_), buf_.owner_);
                                 if (buf_.buf_ != oldBuf) {
                                     *buf_.buf_ = oldRef;
                                     buf_.str_ = (Ch *) (buf_.buf_ + 1);
@@ -726,7 +765,8 @@ public:
             if (*buf_.buf_) { // We copy it directly, but we need to increase the reference count if it has.
                 (**buf_.buf_).IncrementRef();
             } else { // If it doesn't have, we need to create and initialize it by 2
-                assert(*buf_.buf_ = (ReferenceCount *) ::malloc(sizeof(ReferenceCount)));
+                *buf_.buf_ = (ReferenceCount *) ::malloc(sizeof(ReferenceCount));
+                assert(*buf_.buf_);
                 new(*buf_.buf_)ReferenceCount(2);
             }
         }
@@ -765,7 +805,7 @@ public:
                     ::free((void *) *buf_.buf_);
                 }
             }
-            ::free((void *) buf_.buf_);
+            EscapistPrivate::ReleaseBuffer((void *) buf_.buf_, buf_.owner_);
         }
     }
 
@@ -7,18 +7,99 @@
 
 #include "../General.h"
 
+namespace EscapistPrivate {
+    /**
+     * Data written by different threads is kept this far apart, so they don't invalidate each other's cache line.
+     */
+    constexpr SizeType CacheLineSize = 64;
+}
+
+#ifdef ESCAPIST_OS_LINUX
+
+#include <pthread.h>
+#include <sched.h>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
 namespace OS {
-#ifdef ESCAPIST_OS_WINDOWS
+    /**
+     * @return count of online cores, at least 1.
+     */
+    inline int GetCoreCount() noexcept {
+        long cores = ::sysconf(_SC_NPROCESSORS_ONLN);
+        return cores > 0 ? int(cores) : 1;
+    }
 
-    Handle CreateThread() noexcept {
+    /**
+     * Pin the calling thread to cpu.
+     * @return false if cpu doesn't exist or is not allowed (e.g. outside the cpuset of the process).
+     */
+    inline bool SetCurrentThreadAffinity(int cpu) noexcept {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            return false;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return ::pthread_setaffinity_np(::pthread_self(), sizeof(cpu_set_t), &set) == 0;
+    }
 
+    /**
+     * Name the calling thread as shown by top -H and perf, at most 15 characters are kept.
+     */
+    inline bool SetCurrentThreadName(const char *name) noexcept {
+        char truncated[16];
+        SizeType length = ::strnlen(name, sizeof(truncated) - 1);
+        ::memcpy(truncated, name, length);
+        truncated[length] = '\0';
+        return ::pthread_setname_np(::pthread_self(), truncated) == 0;
     }
 
+    /**
+     * Sleep while *address still holds expected, until FutexWake on the same address.\n
+     * May return spuriously, callers check their condition again.
+     * @param timeoutMs -1 sleeps as long as it takes.
+     * @return false on timeout, or if *address didn't hold expected (errno EAGAIN).
+     */
+    inline bool FutexWait(UInt32 *address, UInt32 expected, int timeoutMs = -1) noexcept {
+        timespec timeout{time_t(timeoutMs / 1000), long(timeoutMs % 1000) * 1000000};
+        return ::syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, timeoutMs < 0 ? nullptr : &timeout,
+                         nullptr, 0) == 0;
+    }
+
+    /**
+     * Wake up to count threads sleeping in FutexWait on address.
+     * @return threads woken.
+     */
+    inline int FutexWake(UInt32 *address, int count) noexcept {
+        return int(::syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0));
+    }
+
+    /**
+     * Hint the core that the caller is spinning, so a sibling hyper-thread gets the pipeline meanwhile.
+     */
+    inline void CpuRelax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        __asm__ __volatile__("yield");
 #endif
+    }
 }
 
+#endif
+
+/**
+ * Thread running Run() of a subclass.\n
+ * On Linux it is a pthread, which may be pinned to cores, named, given a stack size and a SCHED_FIFO priority
+ * before Start. There is no way to kill it: Run() is expected to return (e.g. on a stop flag), and Wait joins it.
+ * A thread that has been waited for can be started again. A subclass must call Wait before its own members are
+ * gone, the destructor of Thread only joins what the subclass left running.
+ */
 class Thread {
 private:
+#ifdef ESCAPIST_OS_WINDOWS
     Handle hThread;
     unsigned long threadID;
     bool started = false;
@@ -30,13 +111,46 @@ private:
             thr->Run();
         }
         thr->finished = true;
+        return 0;
     }
+#else
+    pthread_t thread{};
+    bool started = false;
+    volatile bool finished = false;
+    cpu_set_t affinity;
+    bool pinned = false;
+    SizeType stackSize = 0;
+    int priority = 0; // SCHED_FIFO priority, 0 for the default policy.
+    char name[16] = {0};
+
+    static void *Start0(void *argv) {
+        Thread *thr = (Thread *) argv;
+        if (thr->name[0]) {
+            ::pthread_setname_np(::pthread_self(), thr->name);
+        }
+        thr->Run();
+        __atomic_store_n(&thr->finished, true, __ATOMIC_RELEASE);
+        return nullptr;
+    }
+#endif
 
 public:
+#ifdef ESCAPIST_OS_WINDOWS
     Thread() noexcept: hThread(nullptr), threadID(0) {}
+#else
+    Thread() noexcept {
+        CPU_ZERO(&affinity);
+    }
+#endif
 
     Thread(const Thread &other) noexcept = delete;
 
+    virtual ~Thread() {
+        Thread::Wait();
+    }
+
+#ifdef ESCAPIST_OS_WINDOWS
+
     void Start() {
         hThread = ::CreateThread(nullptr, 0, Thread::Start0, this, 0, &threadID);
         if (hThread) {
@@ -44,12 +158,6 @@ public:
         }
     }
 
-    void Terminate(int exitCode) noexcept {
-        if (hThread && ::TerminateThread(hThread, exitCode)) {
-            started = false;
-        }
-    }
-
     void Wait(DWORD ms) {
         if (hThread && started) {
             ::WaitForSingleObject(hThread, ms);
@@ -60,6 +168,147 @@ public:
         Thread::Wait(INFINITE);
     }
 
+#else
+
+    /**
+     * Name shown by top -H, perf and gdb, at most 15 characters are kept. Applies from the next Start.
+     */
+    Thread &SetName(const char *threadName) noexcept {
+        SizeType length = ::strnlen(threadName, sizeof(name) - 1);
+        ::memcpy(name, threadName, length);
+        name[length] = '\0';
+        return *this;
+    }
+
+    /**
+     * Pin to cpu, e.g. an isolated core (isolcpus/nohz_full) for a latency-critical receive loop.
+     * Called several times, the thread may run on any of the cpus. Applies from the next Start.
+     */
+    Thread &SetAffinity(int cpu) noexcept {
+        assert(cpu >= 0 && cpu < CPU_SETSIZE);
+        CPU_SET(cpu, &affinity);
+        pinned = true;
+        return *this;
+    }
+
+    Thread &ClearAffinity() noexcept {
+        CPU_ZERO(&affinity);
+        pinned = false;
+        return *this;
+    }
+
+    /**
+     * @param size bytes of stack, 0 for the default (usually 8 MB), rounded up to the page size by the system.
+     */
+    Thread &SetStackSize(SizeType size) noexcept {
+        stackSize = size;
+        return *this;
+    }
+
+    /**
+     * Run under SCHED_FIFO, which needs CAP_SYS_NICE (or an RLIMIT_RTPRIO allowing it), otherwise Start fails.
+     * @param fifoPriority 1 (lowest) to 99, 0 keeps the default policy.
+     */
+    Thread &SetRealtimePriority(int fifoPriority) noexcept {
+        assert(fifoPriority >= 0 && fifoPriority <= 99);
+        priority = fifoPriority;
+        return *this;
+    }
+
+    /**
+     * Create the thread with the attributes set before. Affinity and priority are set on creation, so Run()
+     * never executes anywhere else.
+     * @return false if the thread is running already, or the system refused an attribute (errno tells,
+     * e.g. EPERM for a priority without the right, EINVAL for a cpu outside the cpuset).
+     */
+    bool Start() {
+        if (started) {
+            errno = EBUSY;
+            return false;
+        }
+        pthread_attr_t attributes;
+        ::pthread_attr_init(&attributes);
+        int error = 0;
+        if (stackSize) {
+            error = ::pthread_attr_setstacksize(&attributes, stackSize);
+        }
+        if (!error && pinned) {
+            error = ::pthread_attr_setaffinity_np(&attributes, sizeof(cpu_set_t), &affinity);
+        }
+        if (!error && priority) {
+            sched_param parameter{};
+            parameter.sched_priority = priority;
+            error = ::pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED);
+            if (!error) {
+                error = ::pthread_attr_setschedpolicy(&attributes, SCHED_FIFO);
+            }
+            if (!error) {
+                error = ::pthread_attr_setschedparam(&attributes, &parameter);
+            }
+        }
+        finished = false;
+        if (!error) {
+            error = ::pthread_create(&thread, &attributes, Thread::Start0, this);
+        }
+        ::pthread_attr_destroy(&attributes);
+        if (error) {
+            errno = error;
+            return false;
+        }
+        started = true;
+        return true;
+    }
+
+    /**
+     * Join the thread, which can be started again afterwards. Safe to call when not started or already joined.
+     * @return false if called by the thread itself (it would never return).
+     */
+    bool Wait() {
+        if (!started) {
+            return true;
+        }
+        if (::pthread_equal(thread, ::pthread_self())) {
+            errno = EDEADLK;
+            return false;
+        }
+        ::pthread_join(thread, nullptr);
+        started = false;
+        return true;
+    }
+
+    /**
+     * Join the thread if it finishes within ms.
+     * @return false on timeout, the thread keeps running.
+     */
+    bool Wait(UInt32 ms) {
+        if (!started) {
+            return true;
+        }
+        timespec deadline{};
+        ::clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += time_t(ms / 1000);
+        deadline.tv_nsec += long(ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000;
+        }
+        if (::pthread_timedjoin_np(thread, nullptr, &deadline)) {
+            return false;
+        }
+        started = false;
+        return true;
+    }
+
+    bool IsRunning() const noexcept {
+        return started && !__atomic_load_n(&finished, __ATOMIC_ACQUIRE);
+    }
+
+    pthread_t GetHandle() const noexcept {
+        return thread;
+    }
+
+#endif
+
     virtual void Run() = 0;
 };
 
@@ -0,0 +1,382 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_THREADPOOL_H
+#define ESCAPIST_THREADPOOL_H
+
+#include "../General.h"
+#include "MpmcQueue.h"
+#include "Thread.h"
+
+#ifdef ESCAPIST_OS_LINUX
+
+#include <cstdio>
+
+class TaskHandler {
+public:
+    virtual ~TaskHandler() = default;
+
+    /**
+     * Called once on some worker of the pool, it may submit further tasks.
+     * @param context the value given to Submit.
+     */
+    virtual void OnTask(UInt64 context) = 0;
+};
+
+/**
+ * A handler and its argument, so a task is two words and submitting one never allocates.
+ */
+struct Task {
+    TaskHandler *handler;
+    UInt64 context;
+};
+
+namespace EscapistPrivate {
+    /**
+     * Chase-Lev deque of fixed capacity: its worker pushes and pops at the bottom (LIFO, the newest task is
+     * hot in cache), other workers steal the oldest task at the top. Only a steal racing for the last task
+     * needs a CAS.
+     */
+    class WorkDeque {
+    private:
+        alignas(CacheLineSize) Int64 top = 0;
+        alignas(CacheLineSize) Int64 bottom = 0;
+        alignas(CacheLineSize) Int64 mask;
+        TaskHandler **handlers;
+        UInt64 *contexts;
+
+    public:
+        /**
+         * @param capacity a power of 2.
+         */
+        explicit WorkDeque(SizeType capacity) : mask(Int64(capacity) - 1) {
+            assert(capacity && !(capacity & (capacity - 1)));
+            handlers = new TaskHandler *[capacity];
+            contexts = new UInt64[capacity];
+        }
+
+        WorkDeque(const WorkDeque &other) = delete;
+
+        ~WorkDeque() {
+            delete[] handlers;
+            delete[] contexts;
+        }
+
+        /**
+         * Owner only.
+         * @return false if full.
+         */
+        bool Push(const Task &task) noexcept {
+            Int64 b = __atomic_load_n(&bottom, __ATOMIC_RELAXED);
+            Int64 t = __atomic_load_n(&top, __ATOMIC_ACQUIRE);
+            if (b - t > mask) {
+                return false;
+            }
+            __atomic_store_n(&handlers[b & mask], task.handler, __ATOMIC_RELAXED);
+            __atomic_store_n(&contexts[b & mask], task.context, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+            __atomic_store_n(&bottom, b + 1, __ATOMIC_RELAXED);
+            return true;
+        }
+
+        /**
+         * Owner only.
+         * @return false if empty.
+         */
+        bool Pop(Task &task) noexcept {
+            Int64 b = __atomic_load_n(&bottom, __ATOMIC_RELAXED) - 1;
+            __atomic_store_n(&bottom, b, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            Int64 t = __atomic_load_n(&top, __ATOMIC_RELAXED);
+            if (t > b) {
+                __atomic_store_n(&bottom, b + 1, __ATOMIC_RELAXED);
+                return false;
+            }
+            task.handler = __atomic_load_n(&handlers[b & mask], __ATOMIC_RELAXED);
+            task.context = __atomic_load_n(&contexts[b & mask], __ATOMIC_RELAXED);
+            if (t == b) { // The last task, a thief may be taking it.
+                bool won = __atomic_compare_exchange_n(&top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+                __atomic_store_n(&bottom, b + 1, __ATOMIC_RELAXED);
+                return won;
+            }
+            return true;
+        }
+
+        /**
+         * Any thread.
+         * @return false if empty, or another thread took the task first.
+         */
+        bool Steal(Task &task) noexcept {
+            Int64 t = __atomic_load_n(&top, __ATOMIC_ACQUIRE);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            Int64 b = __atomic_load_n(&bottom, __ATOMIC_ACQUIRE);
+            if (t >= b) {
+                return false;
+            }
+            task.handler = __atomic_load_n(&handlers[t & mask], __ATOMIC_RELAXED);
+            task.context = __atomic_load_n(&contexts[t & mask], __ATOMIC_RELAXED);
+            return __atomic_compare_exchange_n(&top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+        }
+
+        bool IsEmpty() const noexcept {
+            return __atomic_load_n(&top, __ATOMIC_ACQUIRE) >= __atomic_load_n(&bottom, __ATOMIC_ACQUIRE);
+        }
+    };
+}
+
+/**
+ * Work-stealing executor: every worker runs the tasks of its own deque, then those of the shared injection
+ * queue, then steals from the others; out of work it spins a little and parks on a futex.\n
+ * A task submitted by a worker goes to its own deque, one submitted by any other thread (e.g. the receive loop of
+ * a DatagramServer handing out a batch) to the injection queue, so there is no lock on either path.
+ * Submitting only wakes a worker if one is parked.
+ */
+class ThreadPool {
+public:
+    static constexpr int SpinCount = 256; // Rounds of looking for work before parking.
+
+private:
+    struct Worker : public Thread {
+        ThreadPool *pool;
+        int index;
+        EscapistPrivate::WorkDeque deque;
+        UInt32 random; // xorshift state, picks the first victim of a steal.
+        UInt64 executedCount = 0;
+        UInt64 stolenCount = 0;
+
+        Worker(ThreadPool *pool, int index, SizeType dequeCapacity)
+                : pool(pool), index(index), deque(dequeCapacity), random(UInt32(index) * 2654435761u + 1) {}
+
+        void Run() override {
+            pool->Work(*this);
+        }
+    };
+
+    Worker **workers;
+    int workerCount;
+    MpmcQueue<Task> injection;
+    alignas(EscapistPrivate::CacheLineSize) UInt32 signal = 0; // Futex word, bumped to wake parked workers.
+    UInt32 sleeperCount = 0;
+    bool stopping = false;
+    bool started = false;
+
+    static Worker *&Current() noexcept {
+        static thread_local Worker *current = nullptr;
+        return current;
+    }
+
+    bool Find(Worker &worker, Task &task) noexcept {
+        if (worker.deque.Pop(task) || injection.TryPop(task)) {
+            return true;
+        }
+        worker.random ^= worker.random << 13;
+        worker.random ^= worker.random >> 17;
+        worker.random ^= worker.random << 5;
+        int first = int(worker.random % UInt32(workerCount));
+        for (int offset = 0; offset < workerCount; ++offset) {
+            int victim = (first + offset) % workerCount;
+            if (victim != worker.index && workers[victim]->deque.Steal(task)) {
+                __atomic_store_n(&worker.stolenCount, worker.stolenCount + 1, __ATOMIC_RELAXED);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool HasWork() const noexcept {
+        if (!injection.IsEmpty()) {
+            return true;
+        }
+        for (int index = 0; index < workerCount; ++index) {
+            if (!workers[index]->deque.IsEmpty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Park() noexcept {
+        UInt32 epoch = __atomic_load_n(&signal, __ATOMIC_ACQUIRE);
+        __atomic_fetch_add(&sleeperCount, 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST); // Pairs with the one of Notify: either sees the other.
+        if (!ThreadPool::HasWork() && !__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+            OS::FutexWait(&signal, epoch);
+        }
+        __atomic_fetch_sub(&sleeperCount, 1, __ATOMIC_RELAXED);
+    }
+
+    void Notify(int count) noexcept {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&sleeperCount, __ATOMIC_RELAXED)) {
+            __atomic_fetch_add(&signal, 1, __ATOMIC_RELEASE);
+            OS::FutexWake(&signal, count);
+        }
+    }
+
+    void Work(Worker &worker) {
+        ThreadPool::Current() = &worker;
+        Task task{};
+        int idle = 0;
+        for (;;) {
+            if (ThreadPool::Find(worker, task)) {
+                task.handler->OnTask(task.context);
+                __atomic_store_n(&worker.executedCount, worker.executedCount + 1, __ATOMIC_RELAXED);
+                idle = 0;
+            } else if (__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+                break;
+            } else if (++idle < ThreadPool::SpinCount) {
+                OS::CpuRelax();
+            } else {
+                ThreadPool::Park();
+                idle = 0;
+            }
+        }
+        ThreadPool::Current() = nullptr;
+    }
+
+    bool Push(Worker *worker, const Task &task) noexcept {
+        return (worker && worker->pool == this && worker->deque.Push(task)) || injection.TryPush(task);
+    }
+
+public:
+    /**
+     * @param dequeCapacity tasks a worker holds, a power of 2. Beyond that they go to the injection queue.
+     * @param injectionCapacity tasks from outside the pool held at once, a power of 2.
+     */
+    explicit ThreadPool(int workerCount = OS::GetCoreCount(), SizeType dequeCapacity = 4096,
+                        SizeType injectionCapacity = 4096)
+            : workerCount(workerCount), injection(injectionCapacity) {
+        assert(workerCount > 0);
+        workers = new Worker *[workerCount];
+        for (int index = 0; index < workerCount; ++index) {
+            // The deque is cache line aligned, which plain new doesn't honour before C++17.
+            void *memory = nullptr;
+            int error = ::posix_memalign(&memory, EscapistPrivate::CacheLineSize, sizeof(Worker));
+            assert(!error);
+            (void) error;
+            workers[index] = new(memory) Worker(this, index, dequeCapacity);
+            char name[16]; // Thread names hold 15 characters, workers beyond that keep the name of the process.
+            if (::snprintf(name, sizeof(name), "msggo-pool-%d", index) < int(sizeof(name))) {
+                workers[index]->SetName(name);
+            }
+        }
+    }
+
+    ThreadPool(const ThreadPool &other) = delete;
+
+    ~ThreadPool() {
+        ThreadPool::Stop();
+        for (int index = 0; index < workerCount; ++index) {
+            workers[index]->~Worker();
+            ::free(workers[index]);
+        }
+        delete[] workers;
+    }
+
+    /**
+     * @param pinCores pin worker i to core i modulo the cores, falling back to unpinned if that core is not allowed.
+     * @return false if the workers are running already, or one could not be started (errno tells).
+     */
+    bool Start(bool pinCores = false) {
+        if (started) {
+            errno = EBUSY;
+            return false;
+        }
+        stopping = false;
+        int cores = OS::GetCoreCount();
+        for (int index = 0; index < workerCount; ++index) {
+            Worker &worker = *workers[index];
+            worker.ClearAffinity();
+            if (pinCores) {
+                worker.SetAffinity(index % cores);
+            }
+            bool running = worker.Start();
+            if (!running && pinCores) {
+                running = worker.ClearAffinity().Start();
+            }
+            if (!running) {
+                int error = errno;
+                ThreadPool::Stop();
+                errno = error;
+                return false;
+            }
+            started = true;
+        }
+        return true;
+    }
+
+    /**
+     * Run every task submitted so far, and those they submit, then join the workers. The pool can be started again.
+     */
+    void Stop() {
+        if (!started) {
+            return;
+        }
+        __atomic_store_n(&stopping, true, __ATOMIC_RELEASE);
+        __atomic_fetch_add(&signal, 1, __ATOMIC_RELEASE);
+        OS::FutexWake(&signal, workerCount);
+        for (int index = 0; index < workerCount; ++index) {
+            workers[index]->Wait();
+        }
+        started = false;
+    }
+
+    /**
+     * Run handler->OnTask(context) on some worker. Any thread may submit, a worker of this pool to its own deque.
+     * @return false if there is no room, the caller runs it or tries later.
+     */
+    bool Submit(TaskHandler *handler, UInt64 context = 0) noexcept {
+        if (!ThreadPool::Push(ThreadPool::Current(), Task{handler, context})) {
+            return false;
+        }
+        ThreadPool::Notify(1);
+        return true;
+    }
+
+    /**
+     * Submit count tasks, waking as many parked workers at once.
+     * @return tasks submitted, the rest found no room.
+     */
+    SizeType Submit(const Task *tasks, SizeType count) noexcept {
+        Worker *worker = ThreadPool::Current();
+        SizeType submitted = 0;
+        while (submitted < count && ThreadPool::Push(worker, tasks[submitted])) {
+            ++submitted;
+        }
+        if (submitted) {
+            ThreadPool::Notify(submitted < SizeType(workerCount) ? int(submitted) : workerCount);
+        }
+        return submitted;
+    }
+
+    int GetWorkerCount() const noexcept {
+        return workerCount;
+    }
+
+    /**
+     * @return tasks run so far.
+     */
+    UInt64 GetExecutedCount() const noexcept {
+        UInt64 count = 0;
+        for (int index = 0; index < workerCount; ++index) {
+            count += __atomic_load_n(&workers[index]->executedCount, __ATOMIC_RELAXED);
+        }
+        return count;
+    }
+
+    /**
+     * @return tasks a worker took from the deque of another.
+     */
+    UInt64 GetStolenCount() const noexcept {
+        UInt64 count = 0;
+        for (int index = 0; index < workerCount; ++index) {
+            count += __atomic_load_n(&workers[index]->stolenCount, __ATOMIC_RELAXED);
+        }
+        return count;
+    }
+};
+
+#endif
+
+#endif //ESCAPIST_THREADPOOL_H
@@ -0,0 +1,300 @@
+//
+// Created by Escap on 10/17/2026.
+//
+
+#ifndef ESCAPIST_TIMERWHEEL_H
+#define ESCAPIST_TIMERWHEEL_H
+
+#include "../General.h"
+#include "ArrayList.h"
+#include <chrono>
+
+using TimerId = UInt64;
+
+class TimerHandler {
+public:
+    virtual ~TimerHandler() = default;
+
+    /**
+     * Called once when the timer expires, it may schedule or cancel any timer, itself included.
+     * @param context the value given to Schedule.
+     */
+    virtual void OnTimer(TimerId id, UInt64 context) = 0;
+};
+
+/**
+ * Hashed hierarchical timer wheel: Levels wheels of SlotCount slots, each level a SlotCount times coarser than
+ * the one below, so Schedule and Cancel are O(1) and a timer is moved down at most Levels - 1 times.\n
+ * Timers live in one flat ArrayList of nodes linked by index, slots are heads of those lists, and an occupancy
+ * bitmap per level lets Advance and GetTimeoutMs skip empty slots instead of visiting every tick.
+ * A TimerId carries a generation, so cancelling a timer that already fired (or was reused) does nothing.\n
+ * Not thread-safe, a wheel belongs to the thread driving its EventLoop. All times are microseconds of Now().
+ */
+class TimerWheel {
+public:
+    static constexpr int Levels = 4;
+    static constexpr int SlotBits = 8;
+    static constexpr UInt32 SlotCount = 1u << TimerWheel::SlotBits;
+    static constexpr TimerId InvalidId = 0;
+
+private:
+    static constexpr UInt32 Null = 0xFFFFFFFFu;
+    static constexpr UInt32 Free = 0xFFFFFFFFu; // Slot of a node in the free list.
+    static constexpr UInt32 SlotMask = TimerWheel::SlotCount - 1;
+    static constexpr int WordsPerLevel = TimerWheel::SlotCount / 64;
+
+    struct Node {
+        UInt64 expire; // Tick.
+        TimerHandler *handler;
+        UInt64 context;
+        UInt32 prev;
+        UInt32 next;
+        UInt32 slot; // Level * SlotCount + index, Free if unused.
+        UInt32 generation;
+    };
+
+    ArrayList<Node> nodes;
+    UInt32 freeHead = TimerWheel::Null;
+    UInt32 heads[TimerWheel::Levels * TimerWheel::SlotCount];
+    UInt64 occupied[TimerWheel::Levels][TimerWheel::WordsPerLevel] = {};
+    UInt64 tickUs;
+    UInt64 currentTick;
+    SizeType pendingCount = 0;
+
+    static TimerId MakeId(UInt32 index, UInt32 generation) noexcept {
+        return (UInt64(generation) << 32) | (UInt64(index) + 1);
+    }
+
+    Node *NodeOf(TimerId id) noexcept {
+        UInt32 index = UInt32(id) - 1;
+        if (!id || index >= nodes.GetSize()) {
+            return nullptr;
+        }
+        Node &node = nodes.GetData()[index];
+        return node.slot != TimerWheel::Free && node.generation == UInt32(id >> 32) ? &node : nullptr;
+    }
+
+    void Link(UInt32 index) noexcept {
+        Node *data = nodes.GetData();
+        Node &node = data[index];
+        UInt64 delta = node.expire - currentTick;
+        int level = 0;
+        while (level < TimerWheel::Levels - 1 && delta >= (UInt64(1) << (TimerWheel::SlotBits * (level + 1)))) {
+            ++level;
+        }
+        UInt64 limit = UInt64(1) << (TimerWheel::SlotBits * TimerWheel::Levels);
+        UInt64 expire = delta >= limit ? currentTick + limit - 1 : node.expire; // Beyond range, wait at the top.
+        UInt32 slotIndex = UInt32(expire >> (TimerWheel::SlotBits * level)) & TimerWheel::SlotMask;
+        UInt32 slot = UInt32(level) * TimerWheel::SlotCount + slotIndex;
+        node.slot = slot;
+        node.prev = TimerWheel::Null;
+        node.next = heads[slot];
+        if (node.next != TimerWheel::Null) {
+            data[node.next].prev = index;
+        }
+        heads[slot] = index;
+        occupied[level][slotIndex >> 6] |= UInt64(1) << (slotIndex & 63);
+    }
+
+    void Unlink(UInt32 index) noexcept {
+        Node *data = nodes.GetData();
+        Node &node = data[index];
+        if (node.prev != TimerWheel::Null) {
+            data[node.prev].next = node.next;
+        } else {
+            heads[node.slot] = node.next;
+            if (node.next == TimerWheel::Null) {
+                UInt32 level = node.slot / TimerWheel::SlotCount, slotIndex = node.slot & TimerWheel::SlotMask;
+                occupied[level][slotIndex >> 6] &= ~(UInt64(1) << (slotIndex & 63));
+            }
+        }
+        if (node.next != TimerWheel::Null) {
+            data[node.next].prev = node.prev;
+        }
+    }
+
+    void Release(UInt32 index) noexcept {
+        Node &node = nodes.GetData()[index];
+        node.slot = TimerWheel::Free;
+        ++node.generation;
+        node.next = freeHead;
+        freeHead = index;
+        --pendingCount;
+    }
+
+    /**
+     * Move every timer of a higher level slot down, now that its range has come.
+     */
+    void Cascade(int level, UInt32 slotIndex) noexcept {
+        UInt32 slot = UInt32(level) * TimerWheel::SlotCount + slotIndex;
+        while (heads[slot] != TimerWheel::Null) {
+            UInt32 index = heads[slot];
+            TimerWheel::Unlink(index);
+            TimerWheel::Link(index);
+        }
+    }
+
+    /**
+     * @return distance in ticks from the current one to the next occupied slot of level 0 within this
+     * revolution, SlotCount - (current index) (the next wrap) if there is none.
+     */
+    UInt64 DistanceToNextSlot() const noexcept {
+        UInt32 from = UInt32(currentTick + 1) & TimerWheel::SlotMask;
+        if (!from) {
+            return 1; // The next tick wraps and cascades.
+        }
+        for (UInt32 index = from; index < TimerWheel::SlotCount;) {
+            UInt64 word = occupied[0][index >> 6] >> (index & 63);
+            if (word) {
+                return index + UInt32(__builtin_ctzll(word)) - (UInt32(currentTick) & TimerWheel::SlotMask);
+            }
+            index = (index | 63) + 1;
+        }
+        return TimerWheel::SlotCount - (UInt32(currentTick) & TimerWheel::SlotMask);
+    }
+
+    /**
+     * Move to tick, cascading higher levels on wrap, and fire every timer in its slot.
+     * @return count of fired timers.
+     */
+    SizeType Step(UInt64 tick) {
+        UInt64 previous = currentTick;
+        currentTick = tick;
+        int top = 0;
+        while (top < TimerWheel::Levels - 1 &&
+               (previous >> (TimerWheel::SlotBits * (top + 1))) != (tick >> (TimerWheel::SlotBits * (top + 1)))) {
+            ++top;
+        }
+        for (int level = top; level > 0; --level) { // From the top, a cascaded timer may land in a lower slot due now.
+            TimerWheel::Cascade(level, UInt32(tick >> (TimerWheel::SlotBits * level)) & TimerWheel::SlotMask);
+        }
+        SizeType fired = 0;
+        UInt32 slot = UInt32(tick) & TimerWheel::SlotMask;
+        while (heads[slot] != TimerWheel::Null) {
+            UInt32 index = heads[slot];
+            Node &node = nodes.GetData()[index];
+            TimerHandler *handler = node.handler;
+            UInt64 context = node.context;
+            TimerId id = TimerWheel::MakeId(index, node.generation);
+            TimerWheel::Unlink(index);
+            TimerWheel::Release(index);
+            ++fired;
+            handler->OnTimer(id, context); // Might append to nodes, so node is not used any more.
+        }
+        return fired;
+    }
+
+public:
+    static UInt64 Now() noexcept {
+        return (UInt64) std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * @param tickUs resolution, a timer fires on the first tick at or after its deadline.
+     * @param capacity pending timers to allocate nodes for at once.
+     */
+    explicit TimerWheel(UInt64 tickUs = 1000, SizeType capacity = 0, UInt64 now = TimerWheel::Now())
+            : tickUs(tickUs), currentTick(now / tickUs) {
+        assert(tickUs);
+        for (UInt32 &head: heads) {
+            head = TimerWheel::Null;
+        }
+        nodes.EnsureCapacity(capacity);
+    }
+
+    TimerWheel(const TimerWheel &other) = delete;
+
+    /**
+     * O(1), no allocation while a freed node is available.
+     * @param handler must stay valid until the timer fires or is cancelled.
+     * @return id for Cancel, never InvalidId.
+     */
+    TimerId ScheduleAt(UInt64 deadline, TimerHandler *handler, UInt64 context = 0) {
+        assert(handler);
+        UInt64 expire = (deadline + tickUs - 1) / tickUs;
+        if (expire <= currentTick) {
+            expire = currentTick + 1;
+        }
+        UInt32 index = freeHead;
+        if (index != TimerWheel::Null) {
+            freeHead = nodes.GetData()[index].next;
+        } else {
+            index = UInt32(nodes.GetSize());
+            assert(index != TimerWheel::Null);
+            nodes.Append(Node{0, nullptr, 0, TimerWheel::Null, TimerWheel::Null, TimerWheel::Free, 0});
+        }
+        Node &node = nodes.GetData()[index];
+        node.expire = expire;
+        node.handler = handler;
+        node.context = context;
+        TimerWheel::Link(index);
+        ++pendingCount;
+        return TimerWheel::MakeId(index, node.generation);
+    }
+
+    TimerId Schedule(UInt64 delay, TimerHandler *handler, UInt64 context = 0, UInt64 now = TimerWheel::Now()) {
+        return TimerWheel::ScheduleAt(now + delay, handler, context);
+    }
+
+    /**
+     * O(1).
+     * @return false if the timer already fired or was cancelled.
+     */
+    bool Cancel(TimerId id) noexcept {
+        Node *node = TimerWheel::NodeOf(id);
+        if (!node) {
+            return false;
+        }
+        UInt32 index = UInt32(id) - 1;
+        TimerWheel::Unlink(index);
+        TimerWheel::Release(index);
+        return true;
+    }
+
+    /**
+     * Fire every timer whose deadline is at or before now, skipping empty slots.
+     * @return count of fired timers.
+     */
+    SizeType Advance(UInt64 now = TimerWheel::Now()) {
+        UInt64 target = now / tickUs;
+        SizeType fired = 0;
+        while (currentTick < target) {
+            if (!pendingCount) {
+                currentTick = target;
+                break;
+            }
+            UInt64 distance = TimerWheel::DistanceToNextSlot();
+            UInt64 tick = currentTick + distance;
+            if (tick > target) {
+                // Nothing fires before target and no wrap on the way, so no cascade is skipped either.
+                currentTick = target;
+                break;
+            }
+            fired += TimerWheel::Step(tick);
+        }
+        return fired;
+    }
+
+    /**
+     * @return milliseconds until Advance has something to do, -1 if no timer is pending, for EventLoop::RunOnce.
+     * It can be earlier than the next deadline when a higher level has to be cascaded first.
+     */
+    int GetTimeoutMs(UInt64 now = TimerWheel::Now()) const noexcept {
+        if (!pendingCount) {
+            return -1;
+        }
+        UInt64 deadline = (currentTick + TimerWheel::DistanceToNextSlot()) * tickUs;
+        return deadline <= now ? 0 : int((deadline - now + 999) / 1000);
+    }
+
+    SizeType GetPendingCount() const noexcept {
+        return pendingCount;
+    }
+
+    UInt64 GetTickUs() const noexcept {
+        return tickUs;
+    }
+};
+
+#endif //ESCAPIST_TIMERWHEEL_H
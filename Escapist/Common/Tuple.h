@@ -49,27 +49,27 @@ namespace EscapistPrivate {
     template<typename This, typename ...Types>
     struct TupleElementFinder<0, Tuple<This, Types...>> {
         using Value = This;
-        using Tuple = Tuple<This, Types...>;
+        using Type = Tuple<This, Types...>;
     };
 
     template<SizeType index, typename This, typename ...Next>
     struct TupleElementFinder<index, Tuple<This, Next...>> {
         using Value = typename TupleElementFinder<index - 1, Tuple<Next...>>::Value;
-        using Tuple = typename TupleElementFinder<index - 1, Tuple<Next...>>::Tuple;
+        using Type = typename TupleElementFinder<index - 1, Tuple<Next...>>::Type;
     };
 
     template<>
     struct TupleElementFinder<0, Tuple<>> {
         using Value = Tuple<>;
-        using Tuple = Tuple<>;
+        using Type = Tuple<>;
     };
 }
 
 template<SizeType index, typename ...Types>
 typename EscapistPrivate::TupleElementFinder<index, Tuple<Types...>>::Value&
 GetTupleValue(const Tuple<Types...> &tuple) {
-    using Tuple = typename EscapistPrivate::TupleElementFinder<index, Tuple<Types...>>::Tuple;
-    return ((Tuple *) &tuple)->GetValueRef();
+    using Type = typename EscapistPrivate::TupleElementFinder<index, Tuple<Types...>>::Type;
+    return ((Type *) &tuple)->GetValueRef();
 }
 
 #endif //ESCAPIST_TUPLE_H
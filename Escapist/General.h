@@ -50,6 +50,35 @@ using SizeType = unsigned int;
 #include <windows.h>
 #include <cassert>
 
+#elif defined(ESCAPIST_OS_LINUX) | defined(ESCAPIST_OS_UNIX)
+
+#include <cstddef>
+#include <cstdint>
+
+using Int8 = char;
+using UInt8 = unsigned char;
+using Int16 = short;
+using UInt16 = unsigned short;
+using Int32 = int;
+using UInt32 = unsigned int;
+using Int64 = long long;
+using UInt64 = unsigned long long;
+
+using Handle = void *;
+using Char = char;
+using SizeType = std::size_t;
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <cassert>
+
 #endif
 
 #endif //ESCAPIST_GENERAL_H